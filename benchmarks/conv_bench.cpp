@@ -0,0 +1,119 @@
+// GFLOP/s of conv2d (src/Convolution.cpp, im2col onto gemm) against a
+// direct seven-deep loop, on ResNet-style layer shapes, in f64 and f32,
+// and the time of a 2x2 max pool.
+//
+//   g++ -std=c++17 -O2 -pthread benchmarks/conv_bench.cpp src/Convolution.cpp src/Gemm.cpp src/ThreadPool.cpp -o conv_bench
+//   ./conv_bench                  # batch of 8, all cores
+//   TROLL_NUM_THREADS=1 ./conv_bench
+//
+// The direct loop is run once per layer; it is slow enough as it is.
+
+#include "../include/Convolution.h"
+#include "../include/Gemm.h"
+#include "../include/ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+struct Layer {
+    const char* name;
+    size_t channels, size, filters, kernel, stride, padding;
+};
+
+static void referenceConv2d(const Conv2dShape& s, const double* input, const double* kernel, double* out) {
+    size_t outHeight = s.outHeight();
+    size_t outWidth = s.outWidth();
+    for (size_t n = 0; n < s.batch; ++n) {
+        for (size_t f = 0; f < s.filters; ++f) {
+            for (size_t oh = 0; oh < outHeight; ++oh) {
+                for (size_t ow = 0; ow < outWidth; ++ow) {
+                    double sum = 0.0;
+                    for (size_t c = 0; c < s.channels; ++c) {
+                        for (size_t kh = 0; kh < s.kernelHeight; ++kh) {
+                            for (size_t kw = 0; kw < s.kernelWidth; ++kw) {
+                                ptrdiff_t ih = static_cast<ptrdiff_t>(oh * s.stride + kh) - static_cast<ptrdiff_t>(s.padding);
+                                ptrdiff_t iw = static_cast<ptrdiff_t>(ow * s.stride + kw) - static_cast<ptrdiff_t>(s.padding);
+                                if (ih < 0 || iw < 0 || ih >= static_cast<ptrdiff_t>(s.height) ||
+                                    iw >= static_cast<ptrdiff_t>(s.width)) {
+                                    continue;
+                                }
+                                sum += input[((n * s.channels + c) * s.height + ih) * s.width + iw] *
+                                       kernel[((f * s.channels + c) * s.kernelHeight + kh) * s.kernelWidth + kw];
+                            }
+                        }
+                    }
+                    out[((n * s.filters + f) * outHeight + oh) * outWidth + ow] = sum;
+                }
+            }
+        }
+    }
+}
+
+// Best of a few runs, enough to cover at least ~0.2s per layer
+template <typename F>
+static double bestSeconds(F run) {
+    double best = 1e30;
+    double total = 0.0;
+    for (int rep = 0; rep < 10 && (rep < 2 || total < 0.2); ++rep) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::min(best, seconds);
+        total += seconds;
+    }
+    return best;
+}
+
+int main() {
+    const size_t batch = 8;
+    const Layer layers[] = {
+        {"stem 7x7/2", 3, 224, 64, 7, 2, 3},
+        {"64 3x3", 64, 56, 64, 3, 1, 1},
+        {"128 3x3", 128, 28, 128, 3, 1, 1},
+        {"256 3x3", 256, 14, 256, 3, 1, 1},
+        {"256>1024 1x1", 256, 14, 1024, 1, 1, 0},
+        {"512 3x3", 512, 7, 512, 3, 1, 1},
+    };
+    std::printf("kernel: %s, threads: %zu, batch: %zu\n", gemmKernelName(), ThreadPool::get().threadCount(), batch);
+    std::printf("%-14s %12s %12s %12s %9s %10s\n", "layer", "conv GF/s", "f32 GF/s", "direct GF/s", "speedup",
+                "max error");
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    for (const Layer& layer : layers) {
+        Conv2dShape shape{batch, layer.channels, layer.size, layer.size, layer.filters,
+                          layer.kernel, layer.kernel, layer.stride, layer.padding};
+        std::vector<double> input(batch * layer.channels * layer.size * layer.size);
+        std::vector<double> kernel(layer.filters * layer.channels * layer.kernel * layer.kernel);
+        for (auto& x : input) x = uniform(rng);
+        for (auto& x : kernel) x = uniform(rng);
+        std::vector<float> input32(input.begin(), input.end()), kernel32(kernel.begin(), kernel.end());
+        size_t outputs = batch * layer.filters * shape.outHeight() * shape.outWidth();
+        std::vector<double> out(outputs), reference(outputs);
+        std::vector<float> out32(outputs);
+
+        double flops = 2.0 * outputs * layer.channels * layer.kernel * layer.kernel;
+        double fast = bestSeconds([&] { conv2d(shape, input.data(), kernel.data(), out.data()); });
+        double single = bestSeconds([&] { conv2d(shape, input32.data(), kernel32.data(), out32.data()); });
+        auto start = std::chrono::steady_clock::now();
+        referenceConv2d(shape, input.data(), kernel.data(), reference.data());
+        double direct = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double error = 0.0;
+        for (size_t i = 0; i < outputs; ++i) error = std::max(error, std::fabs(out[i] - reference[i]));
+        std::printf("%-14s %12.2f %12.2f %12.2f %8.1fx %10.1e\n", layer.name, flops / fast * 1e-9,
+                    flops / single * 1e-9, flops / direct * 1e-9, direct / fast, error);
+    }
+
+    // 2x2/2 max pool after the stem
+    Conv2dShape pool{batch, 64, 112, 112, 64, 2, 2, 2, 0};
+    std::vector<double> input(batch * 64 * 112 * 112), out(batch * 64 * 56 * 56);
+    for (auto& x : input) x = uniform(rng);
+    double seconds = bestSeconds([&] { pool2d(Pooling::Max, pool, input.data(), out.data()); });
+    std::printf("maxpool 2x2/2 on 64x112x112: %.2f ms, %.2f GB/s read\n", seconds * 1e3,
+                input.size() * sizeof(double) / seconds * 1e-9);
+    return 0;
+}
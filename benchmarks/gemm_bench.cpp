@@ -0,0 +1,85 @@
+// GFLOP/s of the `@` kernel (src/Gemm.cpp) against the plain triple loop it
+// replaced, for square matrices, and of its f32 kernels on the same data.
+//
+//   g++ -std=c++17 -O2 -pthread benchmarks/gemm_bench.cpp src/Gemm.cpp src/ThreadPool.cpp -o gemm_bench
+//   ./gemm_bench                  # kernel chosen by CPUID, all cores
+//   TROLL_GEMM=avx2 ./gemm_bench  # or avx512 / scalar
+//   TROLL_NUM_THREADS=1 ./gemm_bench
+//
+// The reference loop is only timed up to 1024; beyond that it takes minutes.
+
+#include "../include/Gemm.h"
+#include "../include/ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static void referenceMatmul(const double* a, const double* b, double* c, size_t n) {
+    std::fill(c, c + n * n, 0.0);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t p = 0; p < n; ++p) {
+            double aip = a[i * n + p];
+            for (size_t j = 0; j < n; ++j) {
+                c[i * n + j] += aip * b[p * n + j];
+            }
+        }
+    }
+}
+
+// Best of a few runs, enough to cover at least ~0.2s per size
+template <typename F>
+static double bestSeconds(F run) {
+    double best = 1e30;
+    double total = 0.0;
+    for (int rep = 0; rep < 10 && (rep < 2 || total < 0.2); ++rep) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::min(best, seconds);
+        total += seconds;
+    }
+    return best;
+}
+
+int main() {
+    std::printf("kernel: %s, threads: %zu\n", gemmKernelName(), ThreadPool::get().threadCount());
+    std::printf("%6s %12s %12s %12s %9s %10s\n", "n", "gemm GF/s", "f32 GF/s", "naive GF/s", "speedup",
+                "max error");
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+    for (size_t n : {64, 128, 256, 512, 1024, 2048}) {
+        std::vector<double> a(n * n), b(n * n), c(n * n), reference(n * n);
+        for (auto& x : a) x = uniform(rng);
+        for (auto& x : b) x = uniform(rng);
+        std::vector<float> a32(a.begin(), a.end()), b32(b.begin(), b.end()), c32(n * n);
+
+        double flops = 2.0 * n * n * n;
+        double fast = bestSeconds([&] {
+            gemm(n, n, n, MatrixView{a.data(), static_cast<ptrdiff_t>(n), 1},
+                 MatrixView{b.data(), static_cast<ptrdiff_t>(n), 1}, c.data(), n);
+        });
+        double single = bestSeconds([&] {
+            gemm(n, n, n, StridedMatrix<float>{a32.data(), static_cast<ptrdiff_t>(n), 1},
+                 StridedMatrix<float>{b32.data(), static_cast<ptrdiff_t>(n), 1}, c32.data(), n);
+        });
+
+        if (n > 1024) {
+            std::printf("%6zu %12.2f %12.2f %12s %9s %10s\n", n, flops / fast * 1e-9, flops / single * 1e-9, "-",
+                        "-", "-");
+            continue;
+        }
+        double naive = bestSeconds([&] { referenceMatmul(a.data(), b.data(), reference.data(), n); });
+        double error = 0.0;
+        for (size_t i = 0; i < n * n; ++i) {
+            error = std::max(error, std::fabs(c[i] - reference[i]));
+        }
+        std::printf("%6zu %12.2f %12.2f %12.2f %8.1fx %10.1e\n", n, flops / fast * 1e-9, flops / single * 1e-9,
+                    flops / naive * 1e-9, naive / fast, error);
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+// Time of sparse @ dense (src/SparseTensor.cpp) on random graph adjacency
+// matrices times 64-wide feature matrices, against gemm on the same
+// matrix stored dense, and the memory each form takes.
+//
+//   g++ -std=c++17 -O2 -pthread benchmarks/spmm_bench.cpp src/SparseTensor.cpp src/TrollTensor.cpp src/TensorAllocator.cpp src/Heap.cpp src/Lazy.cpp src/TensorOps.cpp src/Gemm.cpp src/ThreadPool.cpp -o spmm_bench
+//   ./spmm_bench                  # all cores
+//   TROLL_NUM_THREADS=1 ./spmm_bench
+//
+// Half the nonzeros sit in the first 1% of rows, as hubs do in power-law
+// graphs. The dense product is only timed up to 8192 nodes.
+
+#include "../include/Gemm.h"
+#include "../include/SparseTensor.h"
+#include "../include/ThreadPool.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+struct Graph {
+    size_t nodes;
+    double density;
+};
+
+template <typename F>
+static double seconds(F&& f) {
+    f(); // Warm up
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+    const size_t features = 64;
+    const Graph graphs[] = {{2048, 0.01}, {8192, 0.005}, {8192, 0.001}, {65536, 0.0005}, {262144, 0.0001}};
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> value(-1.0, 1.0);
+
+    std::printf("threads: %zu, features: %zu\n", ThreadPool::get().threadCount(), features);
+    std::printf("%8s %9s %10s %11s %11s %10s %11s %9s\n", "nodes", "density", "nonzeros", "sparse ms", "dense ms",
+                "speedup", "sparse MB", "dense MB");
+    for (const Graph& graph : graphs) {
+        size_t n = graph.nodes;
+        size_t count = static_cast<size_t>(static_cast<double>(n) * static_cast<double>(n) * graph.density);
+        size_t hubs = std::max<size_t>(1, n / 100);
+        std::uniform_int_distribution<size_t> anyNode(0, n - 1);
+        std::uniform_int_distribution<size_t> hub(0, hubs - 1);
+        std::vector<size_t> rows(count), cols(count);
+        std::vector<double> values(count);
+        for (size_t e = 0; e < count; ++e) {
+            rows[e] = e % 2 == 0 ? hub(rng) : anyNode(rng);
+            cols[e] = anyNode(rng);
+            values[e] = value(rng);
+        }
+        Ref<SparseTensor> a = SparseTensor::fromTriplets(n, n, rows, cols, values);
+        auto x = makeRef<TrollTensor>(std::vector<size_t>{n, features});
+        for (size_t i = 0; i < n * features; ++i) x->data()[i] = value(rng);
+
+        double sparse = seconds([&] { sparseDenseMatmul(*a, *x); });
+        double denseBytes = static_cast<double>(n) * static_cast<double>(n) * sizeof(double);
+        double dense = 0.0;
+        if (n <= 8192) {
+            Ref<TrollTensor> full = a->toDense();
+            std::vector<double> out(n * features);
+            dense = seconds([&] {
+                gemm(n, features, n, MatrixView{full->data(), static_cast<ptrdiff_t>(n), 1},
+                     MatrixView{x->data(), static_cast<ptrdiff_t>(features), 1}, out.data(), features);
+            });
+        }
+        std::printf("%8zu %9.4f %10zu %11.2f ", n, graph.density, a->nonzeros(), sparse * 1e3);
+        if (dense > 0.0) {
+            std::printf("%11.2f %9.1fx", dense * 1e3, dense / sparse);
+        } else {
+            std::printf("%11s %10s", "-", "-");
+        }
+        std::printf(" %11.1f %9.1f\n", static_cast<double>(a->byteSize()) / 1e6, denseBytes / 1e6);
+    }
+    return 0;
+}
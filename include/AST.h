@@ -2,10 +2,13 @@
 #define AST_H
 
 #include "Token.h"
+#include "Shape.h"
+#include "RuntimeValue.h"
 #include <vector>
 #include <memory>
 #include <optional>
 #include <any>
+#include <unordered_map>
 
 // Forward declarations
 struct BinaryExpr;
@@ -18,6 +21,7 @@ struct AssignmentExpr;
 struct LogicalExpr;
 struct ArrayLiteralExpr;
 struct IndexExpr;
+struct SliceExpr;
 struct ArrayAssignmentExpr;
 
 struct BlockStmt;
@@ -45,6 +49,7 @@ public:
     virtual std::any visitLogicalExpr(std::shared_ptr<LogicalExpr> expr) = 0;
     virtual std::any visitArrayLiteralExpr(std::shared_ptr<ArrayLiteralExpr> expr) = 0;
     virtual std::any visitIndexExpr(std::shared_ptr<IndexExpr> expr) = 0;
+    virtual std::any visitSliceExpr(std::shared_ptr<SliceExpr> expr) = 0;
     virtual std::any visitArrayAssignmentExpr(std::shared_ptr<ArrayAssignmentExpr> expr) = 0;
 
     // Statements
@@ -98,6 +103,7 @@ struct UnaryExpr : public Expr, public std::enable_shared_from_this<UnaryExpr> {
 
 struct LiteralExpr : public Expr, public std::enable_shared_from_this<LiteralExpr> {
     std::variant<std::monostate, int, double, std::string, bool> value;
+    RuntimeValue constant; // value, boxed once by the Optimizer
 
     LiteralExpr(std::variant<std::monostate, int, double, std::string, bool> value)
         : value(std::move(value)) {}
@@ -107,8 +113,25 @@ struct LiteralExpr : public Expr, public std::enable_shared_from_this<LiteralExp
     }
 };
 
+// A local binding: hops up the environment chain and the slot in that frame
+struct SlotRef {
+    int depth;
+    int slot;
+};
+
 struct VariableExpr : public Expr, public std::enable_shared_from_this<VariableExpr> {
     Token name;
+    // Filled in by the Resolver: hops up the environment chain and the slot in
+    // that frame. depth == -1 means the name is a global, looked up by name.
+    int depth = -1;
+    int slot = -1;
+    bool method = false; // Names a method slot of a model; reads bind the receiver
+    // Set when a function body refers to a let declared after the function.
+    // Until that let runs, the enclosing bindings of the name are tried in
+    // turn (innermost first), then the global if none of them was declared
+    // ahead of the function either.
+    std::vector<SlotRef> fallbacks;
+    bool globalFallback = false;
 
     VariableExpr(Token name) : name(std::move(name)) {}
 
@@ -121,6 +144,8 @@ struct CallExpr : public Expr, public std::enable_shared_from_this<CallExpr> {
     std::shared_ptr<Expr> callee;
     Token paren; // For error reporting
     std::vector<std::shared_ptr<Expr>> arguments;
+    bool hasReceiver = false; // Callee is obj.name or a sibling method (set by Resolver)
+    bool tail = false; // Returned directly from a function body (set by Optimizer)
 
     CallExpr(std::shared_ptr<Expr> callee, Token paren, std::vector<std::shared_ptr<Expr>> arguments)
         : callee(std::move(callee)), paren(std::move(paren)), arguments(std::move(arguments)) {}
@@ -133,6 +158,7 @@ struct CallExpr : public Expr, public std::enable_shared_from_this<CallExpr> {
 struct GetExpr : public Expr, public std::enable_shared_from_this<GetExpr> {
     std::shared_ptr<Expr> object;
     Token name;
+    PropertyCache cache; // Filled in by the Interpreter on first access
 
     GetExpr(std::shared_ptr<Expr> object, Token name)
         : object(std::move(object)), name(std::move(name)) {}
@@ -145,6 +171,10 @@ struct GetExpr : public Expr, public std::enable_shared_from_this<GetExpr> {
 struct AssignmentExpr : public Expr, public std::enable_shared_from_this<AssignmentExpr> {
     Token name;
     std::shared_ptr<Expr> value;
+    int depth = -1; // See VariableExpr
+    int slot = -1;
+    std::vector<SlotRef> fallbacks;
+    bool globalFallback = false;
 
     AssignmentExpr(Token name, std::shared_ptr<Expr> value)
         : name(std::move(name)), value(std::move(value)) {}
@@ -182,6 +212,8 @@ struct ArrayLiteralExpr : public Expr, public std::enable_shared_from_this<Array
 
 struct BlockStmt : public Stmt, public std::enable_shared_from_this<BlockStmt> {
     std::vector<std::shared_ptr<Stmt>> statements;
+    int localCount = 0; // Slots needed by the block's environment (set by Resolver)
+    bool captured = false; // A closure declared inside may outlive the block
 
     BlockStmt(std::vector<std::shared_ptr<Stmt>> statements)
         : statements(std::move(statements)) {}
@@ -194,6 +226,7 @@ struct BlockStmt : public Stmt, public std::enable_shared_from_this<BlockStmt> {
 struct LetStmt : public Stmt, public std::enable_shared_from_this<LetStmt> {
     Token name;
     std::shared_ptr<Expr> initializer; // Can be null
+    int slot = -1; // -1 for globals
 
     LetStmt(Token name, std::shared_ptr<Expr> initializer)
         : name(std::move(name)), initializer(std::move(initializer)) {}
@@ -266,6 +299,9 @@ struct FunctionStmt : public Stmt, public std::enable_shared_from_this<FunctionS
     Token name;
     std::vector<Token> params;
     std::vector<std::shared_ptr<Stmt>> body; 
+    int slot = -1;       // Where the function is bound, -1 for globals
+    int localCount = 0;  // Params first, then body locals
+    bool captured = false; // A closure declared in the body may outlive the call
 
     FunctionStmt(Token name, std::vector<Token> params, std::vector<std::shared_ptr<Stmt>> body)
         : name(std::move(name)), params(std::move(params)), body(std::move(body)) {}
@@ -278,6 +314,9 @@ struct FunctionStmt : public Stmt, public std::enable_shared_from_this<FunctionS
 struct ModelStmt : public Stmt, public std::enable_shared_from_this<ModelStmt> {
     Token name;
     std::vector<std::shared_ptr<Stmt>> methods;
+    int slot = -1;
+    int localCount = 0;
+    std::unordered_map<std::string, int> fieldSlots; // Property name -> instance slot
 
     ModelStmt(Token name, std::vector<std::shared_ptr<Stmt>> methods)
         : name(std::move(name)), methods(std::move(methods)) {}
@@ -300,6 +339,21 @@ struct IndexExpr : public Expr, public std::enable_shared_from_this<IndexExpr> {
     }
 };
 
+// object[start:end]; either bound may be left out (null)
+struct SliceExpr : public Expr, public std::enable_shared_from_this<SliceExpr> {
+    std::shared_ptr<Expr> object;
+    std::shared_ptr<Expr> start;
+    std::shared_ptr<Expr> end;
+    Token bracket;
+
+    SliceExpr(std::shared_ptr<Expr> object, std::shared_ptr<Expr> start, std::shared_ptr<Expr> end, Token bracket)
+    : object(object), start(start), end(end), bracket(bracket) {}
+
+    std::any accept(Visitor* visitor) override {
+        return visitor->visitSliceExpr(shared_from_this());
+    }
+};
+
 struct ArrayAssignmentExpr : public Expr, public std::enable_shared_from_this<ArrayAssignmentExpr> {
     std::shared_ptr<Expr> object;
     std::shared_ptr<Expr> index;
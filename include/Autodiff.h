@@ -0,0 +1,109 @@
+#ifndef AUTODIFF_H
+#define AUTODIFF_H
+
+#include "Callable.h"
+#include "Convolution.h"
+#include "TensorOps.h"
+#include "Token.h"
+
+// Reverse-mode differentiation behind grad(). While a gradient function
+// runs, its numeric arguments are TapeValues. Every + - * / @, index,
+// slice, .T, reshape, reduction, convolution, pooling and elementwise
+// function applied to one is recorded as a node on the active tape and
+// yields another TapeValue; a single backward sweep over the tape then
+// gives the gradient with respect to every argument.
+class TapeValue : public Object {
+public:
+    RuntimeValue value; // Number or tensor
+    uint64_t tape;      // Serial of the tape it was recorded on
+    size_t node;
+
+    TapeValue(RuntimeValue value, uint64_t tape, size_t node)
+        : Object(ObjectType::TapeValue), value(std::move(value)), tape(tape), node(node) {}
+
+    void trace(GcVisitor& visitor) override {
+        ::trace(visitor, value);
+    }
+
+    void clearReferences() override {
+        value = RuntimeValue();
+    }
+
+    size_t byteSize() const override {
+        return sizeof(TapeValue);
+    }
+};
+
+inline TapeValue* RuntimeValue::asTapeValue() const {
+    return static_cast<TapeValue*>(asObject());
+}
+
+// A TapeValue's number or tensor; any other value as it is
+RuntimeValue untracked(const RuntimeValue& value);
+// A TapeValue of the active tape, whose uses are recorded
+bool isTracked(const RuntimeValue& value);
+
+// Results of operators with a TapeValue operand, recorded when it belongs
+// to the active tape. TapeValues that outlive their grad() call (stored
+// in a global, say) count as constants.
+RuntimeValue recordBinary(const Token& op, const RuntimeValue& left, const RuntimeValue& right);
+RuntimeValue recordUnary(const Token& op, const RuntimeValue& right);
+RuntimeValue recordIndex(const Token& bracket, const RuntimeValue& object, const RuntimeValue& index);
+RuntimeValue recordSlice(const Token& bracket, const RuntimeValue& object, const RuntimeValue& start,
+                         const RuntimeValue& end);
+RuntimeValue recordProperty(const Token& name, const RuntimeValue& object);
+
+// exp/log/tanh/relu of a number, tensor or numeric array, recorded like an
+// operator. Throws NativeError for anything else.
+RuntimeValue applyFunction(ElementFunction function, const RuntimeValue& x);
+
+// reshape() of a tensor to a shape with as many elements, recorded like
+// an operator
+RuntimeValue applyReshape(const RuntimeValue& x, std::vector<size_t> shape);
+
+// sum/mean/max/argmax/norm of a tensor or numeric array: of all its
+// elements, giving a number, when axis is nil, else along that axis
+// (negative counts from the last), giving a tensor. Recorded like an
+// operator, except argmax, which has no gradient.
+RuntimeValue applyReduction(Reduction reduction, const RuntimeValue& x, const RuntimeValue& axis);
+
+// conv2d() of an NCHW input and an (F, C, KH, KW) kernel, and
+// maxpool2d()/avgpool2d() over size x size windows, recorded like
+// operators. Throw NativeError for mismatched shapes.
+RuntimeValue applyConv2d(const RuntimeValue& input, const RuntimeValue& kernel, size_t stride, size_t padding);
+RuntimeValue applyPool2d(Pooling pooling, const RuntimeValue& input, size_t size, size_t stride);
+
+// grad(f). Calling it runs f on the same arguments and returns the
+// gradient of f's result (of its sum, for a tensor) with respect to each
+// numeric argument: the gradient itself for a one-parameter f, otherwise
+// an array with nil for arguments that are not numeric.
+class GradFunction : public Callable {
+public:
+    RuntimeValue function;
+
+    explicit GradFunction(RuntimeValue function) : function(std::move(function)) {}
+
+    int arity() override {
+        return function.asCallable()->arity();
+    }
+
+    RuntimeValue call(Interpreter* interpreter, const std::vector<RuntimeValue>& arguments) override;
+
+    void trace(GcVisitor& visitor) override {
+        ::trace(visitor, function);
+    }
+
+    void clearReferences() override {
+        function = RuntimeValue();
+    }
+
+    size_t byteSize() const override {
+        return sizeof(GradFunction);
+    }
+
+    std::string toString() override {
+        return "<grad " + function.asCallable()->toString() + ">";
+    }
+};
+
+#endif // AUTODIFF_H
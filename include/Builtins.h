@@ -0,0 +1,13 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include "RuntimeValue.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+// Native functions every script can call by name. The Interpreter and the
+// VM define them as globals before running a script.
+std::vector<std::pair<std::string, RuntimeValue>> builtins();
+
+#endif // BUILTINS_H
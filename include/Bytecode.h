@@ -0,0 +1,100 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "AST.h"
+#include "RuntimeValue.h"
+#include "Shape.h"
+#include "Token.h"
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <memory>
+
+// Register bytecode executed by the VM. Each instruction has up to three
+// operands. Operands marked RK name either a register or, with RK_CONSTANT
+// set, an entry in the constant table.
+enum class OpCode : uint8_t {
+    LOADK,      // R[a] = K[b]
+    LOADNIL,    // R[a] = nil
+    MOVE,       // R[a] = R[b]
+
+    GETGLOBAL,  // R[a] = G[b]
+    SETGLOBAL,  // G[b] = R[a] (must exist)
+    DEFGLOBAL,  // G[b] = R[a]
+    GETENV,     // R[a] = env(b hops).slots[c]
+    GETMETHOD,  // R[a] = env(b hops).slots[c], binding an unbound method to that env
+    SETENV,     // env(b hops).slots[c] = R[a]
+    GETLATE,    // R[a] = first defined binding of lateBindings[b], else its global
+    SETLATE,    // first defined binding of lateBindings[b], else its global = R[a]
+    PUSHENV,    // env = new Environment(env, a slots)
+    POPENV,     // env = env.enclosing
+
+    ADD, SUB, MUL, DIV, MOD, MATMUL, // R[a] = RK[b] op RK[c]
+    LT, LE, GT, GE, EQ, NE,
+    NEG, NOT,   // R[a] = op R[b]
+
+    JMP,        // pc = a
+    JMPIF,      // if truthy(R[a]) pc = b
+    JMPIFNOT,   // if !truthy(R[a]) pc = b
+    JNLT, JNLE, JNGT, JNGE, // if !(RK[b] op RK[c]) pc = a
+
+    CALL,       // R[a] = R[a](R[a+1] .. R[a+b]); c > 0: callee came from a method slot c-1 env hops up
+    INVOKE,     // R[a] = R[a].name(R[a+1] .. R[a+b]), name cached in propertyCaches[c]
+    TAILCALL,   // CALL that replaces the current frame when the callee is compiled
+    TAILINVOKE, // INVOKE that replaces the current frame when the callee is compiled
+    RETURN,     // return R[a]
+    RETURNNIL,
+
+    CLOSURE,    // R[a] = closure(protos[b], env)
+    MODEL,      // R[a] = model(models[b], env)
+
+    NEWARRAY,   // R[a] = [R[b] .. R[b+c-1]]
+    GETINDEX,   // R[a] = RK[b][RK[c]]
+    GETSLICE,   // R[a] = R[b][R[c]:R[c+1]]
+    SETINDEX,   // R[a][RK[b]] = RK[c]
+    GETPROP,    // R[a] = R[b].name, cached in propertyCaches[c]
+
+    PRINT,      // print R[a]
+};
+
+struct Instruction {
+    OpCode op;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+};
+
+constexpr uint32_t RK_CONSTANT = 0x80000000u;
+
+struct FunctionProto;
+
+struct ModelProto {
+    std::shared_ptr<ModelStmt> declaration;
+    std::shared_ptr<FunctionProto> constructor; // Field initializers, run in the instance Environment
+    std::vector<std::pair<int, std::shared_ptr<FunctionProto>>> methods; // Field slot -> method body
+};
+
+// A reference from a function body to a let declared after the function.
+// Until that let runs, the enclosing bindings of the name apply; see
+// VariableExpr::fallbacks.
+struct LateBinding {
+    std::vector<SlotRef> bindings; // Innermost first
+    int global; // Global index tried last, -1 if the last binding was declared ahead of the function
+};
+
+struct FunctionProto {
+    std::string name;
+    int arity = 0;
+    int maxRegisters = 0;
+
+    std::vector<Instruction> code;
+    std::vector<int> tokenAt; // Index into tokens for each instruction (-1 if none), for errors
+    std::vector<Token> tokens;
+    std::vector<RuntimeValue> constants;
+    std::vector<std::shared_ptr<FunctionProto>> protos; // Nested functions
+    std::vector<ModelProto> models;
+    std::vector<PropertyCache> propertyCaches; // One per GETPROP
+    std::vector<LateBinding> lateBindings; // One per GETLATE/SETLATE
+};
+
+#endif // BYTECODE_H
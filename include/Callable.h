@@ -6,15 +6,47 @@
 #include <memory>
 // Forward declare RuntimeValue
 #include "RuntimeValue.h"
+#include "Environment.h"
 
 class Interpreter;
 
-class Callable {
+class Callable : public Object {
 public:
+    Callable() : Object(ObjectType::Callable) {}
     virtual ~Callable() = default;
     virtual int arity() = 0;
+    // Fewest arguments a call may pass; arity() is the most
+    virtual int minArity() { return arity(); }
     virtual RuntimeValue call(Interpreter* interpreter, const std::vector<RuntimeValue>& arguments) = 0;
     virtual std::string toString() = 0;
+
+    // Methods exist once per model and sit unbound in every instance's field
+    // slot. A call straight off the receiver runs them in the receiver's
+    // Environment; reading one as a value binds a copy to that Environment.
+    bool isMethod = false;
+    virtual RuntimeValue bind(Ref<Environment> receiver) {
+        return RuntimeValue(this);
+    }
 };
 
+// The arity error for a call passing `count` arguments, empty if it fits
+inline std::string arityMismatch(Callable* function, size_t count) {
+    int most = function->arity();
+    int least = function->minArity();
+    if (count >= static_cast<size_t>(least) && count <= static_cast<size_t>(most)) return "";
+    std::string expected = least == most ? std::to_string(most) : std::to_string(least) + " to " + std::to_string(most);
+    return "Expected " + expected + " arguments but got " + std::to_string(count) + ".";
+}
+
+inline Callable* RuntimeValue::asCallable() const {
+    return static_cast<Callable*>(asObject());
+}
+
+inline RuntimeValue bindMethod(RuntimeValue value, Environment* receiver) {
+    if (value.isCallable() && value.asCallable()->isMethod) {
+        return value.asCallable()->bind(Ref<Environment>(receiver));
+    }
+    return value;
+}
+
 #endif // CALLABLE_H
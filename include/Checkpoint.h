@@ -0,0 +1,31 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "TrollInstance.h"
+#include <string>
+
+// Binary checkpoints of a model instance's numeric fields: numbers,
+// tensors and flat numeric arrays, found through the instance's fields
+// and, recursively, through the instances and arrays they hold (a field
+// `layers` holding two instances gives `layers.0.w` and `layers.1.w`).
+//
+// The file (little-endian) is an index followed by the payloads:
+//   "TROLLCKP", u32 version, u32 entry count
+//   per entry: u32 length of the rest of the entry, u16 name length,
+//              name, u8 kind, u8 dtype, u16 rank, u64 shape[rank], then
+//              the f64 value of a number or the u64 file offset of the
+//              elements of a tensor or array
+//   the elements of each tensor and array, row-major, 64-byte aligned
+// Numbers keep every bit, and tensors keep their dtype.
+
+// Writes the checkpoint with one writev of the index and every payload in
+// place, to a temporary file renamed over path once complete. Throws
+// NativeError if it cannot be written.
+void saveCheckpoint(TrollInstance& instance, const std::string& path);
+
+// Maps the checkpoint and copies each entry into the field of `instance`
+// it names, replacing the field's value. Throws NativeError if the file is
+// malformed or names a field the instance does not have.
+void loadCheckpoint(TrollInstance& instance, const std::string& path);
+
+#endif // CHECKPOINT_H
@@ -3,6 +3,7 @@
 
 #include "AST.h"
 #include <map>
+#include <set>
 #include <string>
 #include <memory>
 #include <vector>
@@ -33,6 +34,7 @@ public:
     std::any visitLogicalExpr(std::shared_ptr<LogicalExpr> expr) override;
     std::any visitArrayLiteralExpr(std::shared_ptr<ArrayLiteralExpr> expr) override;
     std::any visitIndexExpr(std::shared_ptr<IndexExpr> expr) override;
+    std::any visitSliceExpr(std::shared_ptr<SliceExpr> expr) override;
     std::any visitArrayAssignmentExpr(std::shared_ptr<ArrayAssignmentExpr> expr) override;
 
     std::any visitBlockStmt(std::shared_ptr<BlockStmt> stmt) override;
@@ -52,6 +54,16 @@ private:
 
     std::map<std::string, llvm::AllocaInst*> namedValues;
 
+    // Static array types (inferArrayTypes); everything else is a number
+    std::set<std::string> arrayVariables;
+    std::set<std::string> arrayFunctions;
+    std::map<std::string, FunctionStmt*> functionDecls;
+    void inferArrayTypes(const std::vector<std::shared_ptr<Stmt>>& statements);
+    void collectArrayTypes(const std::shared_ptr<Stmt>& stmt, FunctionStmt* function);
+    void collectArrayTypes(const std::shared_ptr<Expr>& expr);
+    bool mayBeArray(const std::shared_ptr<Expr>& expr) const;
+    void declareFunctions(); // Prototypes of every function in functionDecls
+
     llvm::Value* evaluate(std::shared_ptr<Expr> expr);
     
     // Type Support
@@ -60,15 +72,28 @@ private:
     llvm::Value* createNumberFromValue(llvm::Value* val);
     llvm::Value* createBool(bool val);
     llvm::Value* createArray(llvm::Value* ptr); // ptr is i8*
-    
-    // Helpers
-    llvm::Value* unpackNumber(llvm::Value* trollVal);
-    
+
     enum ValueType {
         TYPE_NUMBER = 0,
         TYPE_ARRAY = 1,
         TYPE_BOOL = 2
     };
+    // num or ptr may be null to leave the field zero
+    llvm::Value* makeValue(ValueType type, llvm::Value* num, llvm::Value* ptr);
+
+    // Helpers
+    llvm::Value* unpackNumber(llvm::Value* trollVal);
+    // + - * / result: `scalar` for two numbers, else troll_array_binary. The
+    // runtime type check is only emitted when an operand may be an array.
+    llvm::Value* arithmetic(int arrayOp, llvm::Value* left, llvm::Value* right, llvm::Value* scalar, bool array);
+
+    // Op codes of troll_array_binary, matching LLVMRuntime.cpp
+    enum ArrayOp {
+        ARRAY_ADD = 0,
+        ARRAY_SUB = 1,
+        ARRAY_MUL = 2,
+        ARRAY_DIV = 3
+    };
 };
 
 #endif // CODE_GENERATOR_H
@@ -0,0 +1,115 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "AST.h"
+#include "Bytecode.h"
+#include <vector>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+class VM;
+
+// Compiles the resolved Stmt/Expr tree into register bytecode for the VM.
+//
+// Locals live in registers unless their scope lexically contains a function
+// or model declaration. Such scopes keep their variables in a heap
+// Environment (slots numbered by the Resolver) so closures can capture them.
+class Compiler : public Visitor {
+public:
+    Compiler(VM& vm) : vm(vm) {}
+    std::shared_ptr<FunctionProto> compile(const std::vector<std::shared_ptr<Stmt>>& statements);
+
+    // Expression Visitors
+    std::any visitLiteralExpr(std::shared_ptr<LiteralExpr> expr) override;
+    std::any visitVariableExpr(std::shared_ptr<VariableExpr> expr) override;
+    std::any visitBinaryExpr(std::shared_ptr<BinaryExpr> expr) override;
+    std::any visitUnaryExpr(std::shared_ptr<UnaryExpr> expr) override;
+    std::any visitAssignmentExpr(std::shared_ptr<AssignmentExpr> expr) override;
+    std::any visitLogicalExpr(std::shared_ptr<LogicalExpr> expr) override;
+    std::any visitCallExpr(std::shared_ptr<CallExpr> expr) override;
+    std::any visitGetExpr(std::shared_ptr<GetExpr> expr) override;
+    std::any visitArrayLiteralExpr(std::shared_ptr<ArrayLiteralExpr> expr) override;
+    std::any visitIndexExpr(std::shared_ptr<IndexExpr> expr) override;
+    std::any visitSliceExpr(std::shared_ptr<SliceExpr> expr) override;
+    std::any visitArrayAssignmentExpr(std::shared_ptr<ArrayAssignmentExpr> expr) override;
+
+    // Statement Visitors
+    std::any visitExprStmt(std::shared_ptr<ExprStmt> stmt) override;
+    std::any visitPrintStmt(std::shared_ptr<PrintStmt> stmt) override;
+    std::any visitLetStmt(std::shared_ptr<LetStmt> stmt) override;
+    std::any visitBlockStmt(std::shared_ptr<BlockStmt> stmt) override;
+    std::any visitIfStmt(std::shared_ptr<IfStmt> stmt) override;
+    std::any visitWhileStmt(std::shared_ptr<WhileStmt> stmt) override;
+    std::any visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt) override;
+    std::any visitReturnStmt(std::shared_ptr<ReturnStmt> stmt) override;
+    std::any visitModelStmt(std::shared_ptr<ModelStmt> stmt) override;
+
+private:
+    struct Local {
+        std::string name;
+        int index; // Register, or slot in the scope's Environment
+    };
+
+    struct Scope {
+        bool isEnv;
+        int firstRegister;
+        std::vector<Local> locals;
+        // Environment scopes: lets not yet reached, which the bodies of
+        // functions declared in the scope can already see
+        std::vector<Local> later;
+    };
+
+    struct FunctionState {
+        std::shared_ptr<FunctionProto> proto;
+        FunctionState* enclosing = nullptr;
+        std::vector<Scope> scopes;
+        int freeRegister = 0;
+        std::unordered_map<double, int> numberConstants;
+        std::unordered_map<std::string, int> stringConstants;
+    };
+
+    enum class VarKind { Register, Env, Global, Late };
+    struct VarRef {
+        VarKind kind;
+        int index; // Register, env slot or global index
+        int depth; // Env hops for VarKind::Env
+        LateBinding late = {}; // VarKind::Late
+    };
+
+    VM& vm;
+    FunctionState* fs = nullptr;
+    int dest = 0;            // Target register for the expression being compiled
+    bool discard = false;    // Result of the current expression statement is unused
+
+    // Expressions
+    void compileExpr(const std::shared_ptr<Expr>& expr, int target);
+    int exprToAnyRegister(const std::shared_ptr<Expr>& expr);
+    int exprToOperand(const std::shared_ptr<Expr>& expr); // RK operand
+    void compileCondition(const std::shared_ptr<Expr>& condition, std::vector<size_t>& falseJumps);
+
+    // Statements
+    void compileStatement(const std::shared_ptr<Stmt>& stmt);
+    void compileFunction(const std::shared_ptr<FunctionStmt>& stmt, int target);
+    std::shared_ptr<FunctionProto> compileFunctionProto(const std::shared_ptr<FunctionStmt>& stmt);
+    void compileModel(const std::shared_ptr<ModelStmt>& stmt, int target);
+    void bindDeclaration(const std::string& name, int slot, int reg, const Token& token);
+
+    // Scopes and variables
+    void beginScope(bool isEnv);
+    void endScope();
+    void declareHoisted(const std::vector<std::shared_ptr<Stmt>>& statements);
+    VarRef resolve(const std::string& name);
+    int addLateBinding(LateBinding late);
+    bool atGlobalScope() const;
+
+    // Emission helpers
+    int allocRegister();
+    size_t emit(OpCode op, int a = 0, int b = 0, int c = 0, const Token* token = nullptr);
+    void patchJump(size_t at);
+    int addConstant(RuntimeValue value);
+    int addToken(const Token& token);
+    int currentOffset() const;
+};
+
+#endif // COMPILER_H
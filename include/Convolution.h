@@ -0,0 +1,60 @@
+#ifndef CONVOLUTION_H
+#define CONVOLUTION_H
+
+#include "DType.h"
+#include <cstddef>
+
+// 2-D convolution and pooling over NCHW data: batch, channels, height,
+// width, each image's planes contiguous and row-major.
+//
+// conv2d lowers each image onto gemm through im2col: the input windows
+// are unrolled into a (C*KH*KW) x (OH*OW) matrix, which the kernel, read
+// in place as an F x (C*KH*KW) matrix, multiplies into the image's F
+// output planes. Images with small outputs are unrolled side by side
+// into one wider product. A 1x1 kernel with stride 1 and no padding
+// multiplies the image itself. The backward passes are the transposed
+// products, with col2im adding each window's gradient back into the image.
+//
+// The kernels are instantiated for double, float and BFloat16; bf16 is
+// computed in f32 and rounded once per output.
+struct Conv2dShape {
+    size_t batch;
+    size_t channels;
+    size_t height;
+    size_t width;
+    size_t filters;      // Output channels; pooling keeps the input's
+    size_t kernelHeight; // Or the pooling window
+    size_t kernelWidth;
+    size_t stride;
+    size_t padding;      // Zeros on every side
+
+    size_t outHeight() const { return (height + 2 * padding - kernelHeight) / stride + 1; }
+    size_t outWidth() const { return (width + 2 * padding - kernelWidth) / stride + 1; }
+};
+
+// out (N, F, OH, OW) = input (N, C, H, W) convolved with kernel (F, C, KH, KW)
+template <typename T>
+void conv2d(const Conv2dShape& shape, const T* input, const T* kernel, T* out);
+
+// Gradients of conv2d's input and kernel given the gradient of its
+// output; either target may be null when it is not wanted
+template <typename T>
+void conv2dBackward(const Conv2dShape& shape, const T* input, const T* kernel, const T* gradient,
+                    T* inputGradient, T* kernelGradient);
+
+enum class Pooling {
+    Max,
+    Average,
+};
+
+// out (N, C, OH, OW): the maximum or mean of each window
+template <typename T>
+void pool2d(Pooling pooling, const Conv2dShape& shape, const T* input, T* out);
+
+// The gradient of pool2d's input: each window's gradient goes to its
+// first maximum, or is shared evenly over it for Average
+template <typename T>
+void pool2dBackward(Pooling pooling, const Conv2dShape& shape, const T* input, const T* gradient,
+                    T* inputGradient);
+
+#endif // CONVOLUTION_H
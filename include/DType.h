@@ -0,0 +1,93 @@
+#ifndef DTYPE_H
+#define DTYPE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Element type of a tensor. f64 is the default and what numbers and array
+// literals become; f32 and bf16 halve and quarter the memory traffic.
+enum class DType : uint8_t {
+    F64,
+    F32,
+    BF16, // Stored as bfloat16, computed in f32
+};
+
+// The upper half of an IEEE single: f32's range with an 8-bit mantissa
+struct BFloat16 {
+    uint16_t bits;
+
+    BFloat16() = default;
+    // Rounds to nearest even; NaNs stay (quiet) NaNs
+    explicit BFloat16(float value) {
+        uint32_t word;
+        std::memcpy(&word, &value, sizeof(word));
+        word = value != value ? 0x7FC00000u : word + 0x7FFFu + ((word >> 16) & 1u);
+        bits = static_cast<uint16_t>(word >> 16);
+    }
+
+    operator float() const {
+        uint32_t word = static_cast<uint32_t>(bits) << 16;
+        float value;
+        std::memcpy(&value, &word, sizeof(value));
+        return value;
+    }
+};
+
+// The type a storage type is computed in
+template <typename T>
+struct ComputeType {
+    using type = T;
+};
+template <>
+struct ComputeType<BFloat16> {
+    using type = float;
+};
+
+inline size_t dtypeSize(DType dtype) {
+    switch (dtype) {
+        case DType::F64: return sizeof(double);
+        case DType::F32: return sizeof(float);
+        case DType::BF16: return sizeof(BFloat16);
+    }
+    return sizeof(double);
+}
+
+inline const char* dtypeName(DType dtype) {
+    switch (dtype) {
+        case DType::F64: return "f64";
+        case DType::F32: return "f32";
+        case DType::BF16: return "bf16";
+    }
+    return "f64";
+}
+
+// False for a name that is not a dtype
+inline bool parseDType(const std::string& name, DType& out) {
+    if (name == "f64") out = DType::F64;
+    else if (name == "f32") out = DType::F32;
+    else if (name == "bf16") out = DType::BF16;
+    else return false;
+    return true;
+}
+
+// The dtype of an op on tensors of both: the wider one. Numbers do not
+// take part, so f32 * 0.5 stays f32.
+inline DType promoteTypes(DType a, DType b) {
+    if (a == DType::F64 || b == DType::F64) return DType::F64;
+    if (a == DType::F32 || b == DType::F32) return DType::F32;
+    return DType::BF16;
+}
+
+// Calls f with a value of the storage type of dtype (double, float or
+// BFloat16), so kernels can be written once as generic lambdas
+template <typename F>
+decltype(auto) dispatchDType(DType dtype, F&& f) {
+    switch (dtype) {
+        case DType::F32: return f(float{});
+        case DType::BF16: return f(BFloat16{});
+        default: return f(double{});
+    }
+}
+
+#endif // DTYPE_H
@@ -1,9 +1,11 @@
 #ifndef ENVIRONMENT_H
 #define ENVIRONMENT_H
 
+#include "AST.h"
 #include "RuntimeValue.h"
 #include "Token.h"
 #include <unordered_map>
+#include <vector>
 #include <string>
 #include <memory>
 #include <stdexcept>
@@ -11,54 +13,127 @@
 class RuntimeError : public std::runtime_error {
 public:
     Token token;
-    RuntimeError(Token token, std::string message) 
+    RuntimeError(Token token, std::string message)
         : std::runtime_error(message), token(token) {}
 };
 
-class Environment {
+// Locals live in a flat slot array addressed by (depth, slot) from the Resolver.
+// The name map is only used for globals (and ad-hoc instance fields).
+//
+// Heap environments own their slots and keep the enclosing chain alive; they
+// are used for anything a closure can capture. Frame environments borrow their
+// slots from the Interpreter's FrameArena, live on the C++ stack untracked by
+// the Heap and only hold a raw parent pointer, since their parent always
+// outlives them.
+//
+// Slots of block and function environments start out undefined rather than
+// nil, so a function reading a let declared after it can tell whether that
+// let has run yet (see VariableExpr::fallbacks).
+class Environment : public Object {
 public:
-    Environment() : enclosing(nullptr) {}
-    Environment(std::shared_ptr<Environment> enclosing) : enclosing(enclosing) {}
+    Environment() : Object(ObjectType::Environment) {}
+    Environment(Ref<Environment> enclosing, size_t slotCount = 0, const RuntimeValue& initial = RuntimeValue())
+        : Object(ObjectType::Environment), parent(enclosing.get()), enclosing(std::move(enclosing)), storage(slotCount, initial) {
+        slots = storage.data();
+    }
+    Environment(Environment* parent, RuntimeValue* slots)
+        : Object(ObjectType::Environment, Untracked{}), parent(parent), slots(slots) {}
+
+    Environment(const Environment&) = delete;
+    Environment& operator=(const Environment&) = delete;
 
     void define(const std::string& name, RuntimeValue value) {
-        values[name] = value;
+        values[name] = std::move(value);
     }
 
-    RuntimeValue get(Token name) {
-        if (values.count(name.lexeme)) {
-            return values[name.lexeme];
+    RuntimeValue get(const Token& name) {
+        auto it = values.find(name.lexeme);
+        if (it != values.end()) {
+            return it->second;
         }
 
-        if (enclosing != nullptr) {
-            return enclosing->get(name);
+        if (parent != nullptr) {
+            return parent->get(name);
         }
 
         throw RuntimeError(name, "Undefined variable '" + name.lexeme + "'.");
     }
 
     RuntimeValue getAt(const std::string& name) {
-        if (values.count(name)) {
-            return values[name];
+        auto it = values.find(name);
+        if (it != values.end()) {
+            return it->second;
         }
-        return RuntimeValue(std::monostate{}); 
+        return RuntimeValue(std::monostate{});
     }
 
-    void assign(Token name, RuntimeValue value) {
-        if (values.count(name.lexeme)) {
-            values[name.lexeme] = value;
+    void assign(const Token& name, RuntimeValue value) {
+        auto it = values.find(name.lexeme);
+        if (it != values.end()) {
+            it->second = std::move(value);
             return;
         }
 
-        if (enclosing != nullptr) {
-            enclosing->assign(name, value);
+        if (parent != nullptr) {
+            parent->assign(name, std::move(value));
             return;
         }
 
         throw RuntimeError(name, "Undefined variable '" + name.lexeme + "'.");
     }
 
-    std::shared_ptr<Environment> enclosing;
+    // Slot access
+    void defineAt(int slot, RuntimeValue value) {
+        slots[slot] = std::move(value);
+    }
+
+    const RuntimeValue& getAt(int depth, int slot) {
+        return ancestor(depth)->slots[slot];
+    }
+
+    void assignAt(int depth, int slot, RuntimeValue value) {
+        ancestor(depth)->slots[slot] = std::move(value);
+    }
+
+    // The first of the bindings whose let has run, or null if none has
+    RuntimeValue* firstDefined(const std::vector<SlotRef>& bindings) {
+        for (const SlotRef& ref : bindings) {
+            RuntimeValue& value = ancestor(ref.depth)->slots[ref.slot];
+            if (!value.isUndefined()) return &value;
+        }
+        return nullptr;
+    }
+
+    Environment* ancestor(int depth) {
+        Environment* env = this;
+        for (int i = 0; i < depth; ++i) {
+            env = env->parent;
+        }
+        return env;
+    }
+
+    void trace(GcVisitor& visitor) override {
+        if (enclosing) visitor.visit(enclosing.get());
+        for (const auto& value : storage) ::trace(visitor, value);
+        for (const auto& entry : values) ::trace(visitor, entry.second);
+    }
+
+    void clearReferences() override {
+        enclosing.reset();
+        for (auto& value : storage) value = RuntimeValue();
+        values.clear();
+    }
+
+    size_t byteSize() const override {
+        return sizeof(Environment) + storage.capacity() * sizeof(RuntimeValue) +
+               values.size() * (sizeof(std::string) + sizeof(RuntimeValue));
+    }
+
+    Environment* parent = nullptr;
+    Ref<Environment> enclosing; // Owning link, heap environments only
+    RuntimeValue* slots = nullptr;
 private:
+    std::vector<RuntimeValue> storage;
     std::unordered_map<std::string, RuntimeValue> values;
 };
 
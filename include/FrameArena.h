@@ -0,0 +1,99 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include "RuntimeValue.h"
+#include <memory>
+#include <vector>
+
+// LIFO slot storage for call frames and block scopes that no closure can
+// capture (see Resolver). Chunks are kept once allocated, so after warm-up
+// entering a scope is a pointer bump and never touches malloc.
+class FrameArena {
+public:
+    struct Mark {
+        size_t chunk;
+        size_t top;
+    };
+
+    FrameArena() {
+        chunks.push_back(Chunk{std::make_unique<RuntimeValue[]>(CHUNK_SIZE), CHUNK_SIZE});
+    }
+
+    Mark mark() const {
+        return Mark{current, top};
+    }
+
+    // Slots are handed out nil; whoever allocated them must reset them to nil
+    // before releasing (ArenaFrame does).
+    RuntimeValue* allocate(size_t count) {
+        Chunk& chunk = chunks[current];
+        if (top + count <= chunk.size) {
+            RuntimeValue* slots = chunk.data.get() + top;
+            top += count;
+            return slots;
+        }
+        return allocateInNextChunk(count);
+    }
+
+    void release(Mark mark) {
+        current = mark.chunk;
+        top = mark.top;
+    }
+
+private:
+    struct Chunk {
+        std::unique_ptr<RuntimeValue[]> data;
+        size_t size;
+    };
+
+    static constexpr size_t CHUNK_SIZE = 1 << 16;
+
+    std::vector<Chunk> chunks;
+    size_t current = 0;
+    size_t top = 0;
+
+    RuntimeValue* allocateInNextChunk(size_t count) {
+        size_t next = current + 1;
+        if (next == chunks.size() || chunks[next].size < count) {
+            size_t size = count > CHUNK_SIZE ? count : CHUNK_SIZE;
+            Chunk chunk{std::make_unique<RuntimeValue[]>(size), size};
+            if (next == chunks.size()) {
+                chunks.push_back(std::move(chunk));
+            } else {
+                chunks[next] = std::move(chunk); // Everything past current is unused
+            }
+        }
+        current = next;
+        top = count;
+        return chunks[current].data.get();
+    }
+};
+
+// Slots borrowed from a FrameArena for the lifetime of a C++ scope.
+class ArenaFrame {
+public:
+    ArenaFrame(FrameArena& arena, size_t count)
+        : arena(arena), mark(arena.mark()), slots(arena.allocate(count)), count(count) {}
+
+    ~ArenaFrame() {
+        for (size_t i = 0; i < count; ++i) {
+            slots[i] = RuntimeValue();
+        }
+        arena.release(mark);
+    }
+
+    ArenaFrame(const ArenaFrame&) = delete;
+    ArenaFrame& operator=(const ArenaFrame&) = delete;
+
+    RuntimeValue* data() const {
+        return slots;
+    }
+
+private:
+    FrameArena& arena;
+    FrameArena::Mark mark;
+    RuntimeValue* slots;
+    size_t count;
+};
+
+#endif // FRAME_ARENA_H
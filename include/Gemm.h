@@ -0,0 +1,49 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include "DType.h"
+#include <cstddef>
+
+// Strided view of a matrix: element (i, j) is at
+// data[i * rowStride + j * colStride]. A transposed matrix is the same
+// memory with the strides swapped.
+template <typename T>
+struct StridedMatrix {
+    const T* data;
+    ptrdiff_t rowStride;
+    ptrdiff_t colStride;
+};
+
+using MatrixView = StridedMatrix<double>;
+
+// C (m x n, rows ldc apart) = A (m x k) * B (k x n).
+//
+// Blocked the usual way for caches (a KC x NC panel of B, an MC x KC block
+// of A, both packed into contiguous micro-panels), with an MR x NR register
+// tile micro-kernel. The micro-kernel is picked once at startup from CPUID:
+// AVX-512, AVX2+FMA, or portable scalar code. TROLL_GEMM=avx512|avx2|scalar
+// forces one, for benchmarking. Each dtype has its own set of kernels;
+// the f32 ones hold twice as many columns per register.
+void gemm(size_t m, size_t n, size_t k, MatrixView a, MatrixView b, double* c, size_t ldc);
+void gemm(size_t m, size_t n, size_t k, StridedMatrix<float> a, StridedMatrix<float> b, float* c, size_t ldc);
+// bf16 inputs are widened to f32 as they are packed, and accumulated in f32
+void gemm(size_t m, size_t n, size_t k, StridedMatrix<BFloat16> a, StridedMatrix<BFloat16> b, float* c,
+          size_t ldc);
+
+// `batch` products C_s = A_s * B_s in one call, for s < batch: A_s is a
+// offset by s * aBatch elements, B_s and C_s likewise (C_s at
+// c + s * cBatch). A batch stride of 0 uses the same matrix for every
+// sample. A B shared by the batch is packed once per panel and reused by
+// every sample, whose row blocks are tiled together over the pool; with a
+// B per sample the samples themselves are spread over the pool.
+void batchedGemm(size_t batch, size_t m, size_t n, size_t k, MatrixView a, ptrdiff_t aBatch, MatrixView b,
+                 ptrdiff_t bBatch, double* c, size_t ldc, size_t cBatch);
+void batchedGemm(size_t batch, size_t m, size_t n, size_t k, StridedMatrix<float> a, ptrdiff_t aBatch,
+                 StridedMatrix<float> b, ptrdiff_t bBatch, float* c, size_t ldc, size_t cBatch);
+void batchedGemm(size_t batch, size_t m, size_t n, size_t k, StridedMatrix<BFloat16> a, ptrdiff_t aBatch,
+                 StridedMatrix<BFloat16> b, ptrdiff_t bBatch, float* c, size_t ldc, size_t cBatch);
+
+// Name of the selected micro-kernel
+const char* gemmKernelName();
+
+#endif // GEMM_H
@@ -0,0 +1,64 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+class Object;
+
+// Registry of every runtime Object, with a cycle-collecting mark-sweep pass.
+//
+// Objects are still freed by reference counting the moment their last Ref
+// goes away. What refcounting cannot free are cycles: a closure stored in the
+// scope it closes over, a bound method kept in its own instance. collect()
+// finds those precisely:
+//
+//   1. every tracked object starts with its refcount,
+//   2. references held by other tracked objects (Object::trace) are subtracted,
+//   3. whatever is left comes from outside the heap - the Interpreter's C++
+//      stack and frame arena, VM registers, globals - and is the root set,
+//   4. everything not reachable from the roots is garbage; its references
+//      are cleared (Object::clearReferences), which frees it.
+//
+// Collection only happens at safe points (statement boundaries, VM calls and
+// back jumps), where every live object is owned by some Ref.
+class Heap {
+public:
+    static Heap& get() {
+        static Heap* heap = new Heap(); // Never destroyed: objects may outlive static teardown
+        return *heap;
+    }
+
+    void track(Object* object);
+    void untrack(Object* object);
+
+    void maybeCollect() {
+        if (allocatedSinceCollect >= threshold) collect();
+    }
+    void collect();
+
+    void printStats(std::ostream& out) const;
+
+private:
+    struct SubtractInternal;
+    struct Mark;
+
+    static constexpr size_t MIN_THRESHOLD = 10000;
+
+    std::vector<Object*> objects;
+    size_t allocatedSinceCollect = 0;
+    size_t threshold = MIN_THRESHOLD;
+
+    // Statistics for --gc-stats
+    size_t totalAllocated = 0;
+    size_t totalFreedByCollector = 0;
+    size_t peakObjects = 0;
+    size_t collections = 0;
+    std::chrono::nanoseconds totalPause{0};
+    std::chrono::nanoseconds maxPause{0};
+};
+
+#endif // HEAP_H
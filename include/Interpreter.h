@@ -4,9 +4,12 @@
 #include "AST.h"
 #include "RuntimeValue.h"
 #include "Environment.h"
+#include "FrameArena.h"
 #include <vector>
 #include <memory>
 
+class TrollFunction;
+
 class Interpreter : public Visitor {
 public:
     Interpreter();
@@ -23,6 +26,7 @@ public:
     std::any visitGetExpr(std::shared_ptr<GetExpr> expr) override;
     std::any visitArrayLiteralExpr(std::shared_ptr<ArrayLiteralExpr> expr) override;
     std::any visitIndexExpr(std::shared_ptr<IndexExpr> expr) override;
+    std::any visitSliceExpr(std::shared_ptr<SliceExpr> expr) override;
     std::any visitArrayAssignmentExpr(std::shared_ptr<ArrayAssignmentExpr> expr) override;
 
     // Statement Visitors
@@ -36,18 +40,37 @@ public:
     std::any visitReturnStmt(std::shared_ptr<ReturnStmt> stmt) override;
     std::any visitModelStmt(std::shared_ptr<ModelStmt> stmt) override;
 
-    void executeBlock(const std::vector<std::shared_ptr<Stmt>>& statements, std::shared_ptr<Environment> environment);
+    void executeBlock(const std::vector<std::shared_ptr<Stmt>>& statements, Environment* environment);
+    RuntimeValue callFunction(TrollFunction* function, const std::vector<RuntimeValue>& arguments);
+
+    // Pending-return slot. A return statement stores its value here and raises
+    // the flag; blocks and loops stop executing until the callee clears it.
+    bool returning = false;
+    RuntimeValue returnValue;
+
+    RuntimeValue takeReturnValue();
 
 private:
-    std::shared_ptr<Environment> environment;
+    Ref<Environment> globals;
+    Environment* environment;
+    FrameArena arena;
+
+    // Pending tail call. `return f(args);` in a function body stores the call
+    // here and returns; the enclosing invoke() runs it in place of the frame.
+    bool tailCalling = false;
+    RuntimeValue tailCallee;
+    Ref<Environment> tailParent;
+    std::vector<RuntimeValue> tailArguments;
 
     RuntimeValue evaluate(std::shared_ptr<Expr> expr);
     void execute(std::shared_ptr<Stmt> stmt);
-
-    bool isTruthy(const RuntimeValue& value);
-    bool isEqual(const RuntimeValue& a, const RuntimeValue& b);
-    void checkNumberOperand(const Token& operatorToken, const RuntimeValue& operand);
-    void checkNumberOperands(const Token& operatorToken, const RuntimeValue& left, const RuntimeValue& right);
+    void define(int slot, const std::string& name, RuntimeValue value); // Slot -1 defines by name
+    RuntimeValue callFunction(TrollFunction* function, Environment* parent, const std::vector<std::shared_ptr<Expr>>& arguments);
+    void prepareTailCall(RuntimeValue callee, Environment* parent, const std::vector<std::shared_ptr<Expr>>& arguments);
+    template <typename ArgumentAt>
+    void runFrame(TrollFunction* function, Environment* parent, size_t argumentCount, ArgumentAt argumentAt);
+    template <typename ArgumentAt>
+    RuntimeValue invoke(TrollFunction* function, Environment* parent, size_t argumentCount, ArgumentAt argumentAt);
 };
 
 #endif // INTERPRETER_H
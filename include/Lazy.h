@@ -0,0 +1,67 @@
+#ifndef LAZY_H
+#define LAZY_H
+
+#include "TensorOps.h"
+#include "TrollTensor.h"
+#include <memory>
+#include <vector>
+
+// Opt-in deferred tensor evaluation (--lazy). Elementwise operators, the
+// elementwise builtins and `@` then return tensors whose buffer holds an
+// expression instead of numbers. The first read of the buffer (print,
+// indexing, eval(), or any kernel taking it as input) evaluates it, fusing
+// each run of elementwise and broadcast ops into one pass that writes a
+// single output buffer. Products are computed into their own buffer first.
+void setLazyTensors(bool enabled);
+bool lazyTensors();
+
+struct LazyExpr {
+    enum class Kind {
+        Leaf,        // Elements of an existing buffer
+        Number,
+        Elementwise, // left op right
+        Function,    // function(left)
+        MatMul,      // left @ right, both leaves
+    };
+
+    Kind kind;
+    std::vector<size_t> shape;
+    ElementOp op = ElementOp::Add;
+    ElementFunction function = ElementFunction::Exp;
+    std::shared_ptr<LazyExpr> left;
+    std::shared_ptr<LazyExpr> right;
+    double number = 0.0;
+    size_t nodes = 1; // In this expression, counting shared ones each time
+
+    // Leaf storage; counted in the buffer's lazyReaders while held
+    std::shared_ptr<TensorBuffer> buffer;
+    size_t offset = 0;
+    std::vector<ptrdiff_t> strides;
+
+    ~LazyExpr();
+
+    static std::shared_ptr<LazyExpr> leaf(std::shared_ptr<TensorBuffer> buffer, size_t offset,
+                                          std::vector<size_t> shape, std::vector<ptrdiff_t> strides);
+    static std::shared_ptr<LazyExpr> constant(double value);
+    static std::shared_ptr<LazyExpr> elementwise(ElementOp op, std::shared_ptr<LazyExpr> left,
+                                                 std::shared_ptr<LazyExpr> right, std::vector<size_t> shape);
+    static std::shared_ptr<LazyExpr> map(ElementFunction function, std::shared_ptr<LazyExpr> operand);
+
+    // Turns this node into a leaf on its computed buffer, so every other
+    // expression sharing it reads the result instead of recomputing it
+    void becomeLeaf(std::shared_ptr<TensorBuffer> result);
+};
+
+// `tensor` as an operand: the expression of a pending buffer it spans
+// exactly, so the two fuse, otherwise a leaf on its elements
+std::shared_ptr<LazyExpr> lazyOperand(const TrollTensor& tensor);
+
+// A new contiguous tensor to be filled from `expression`
+Ref<TrollTensor> lazyTensor(std::shared_ptr<LazyExpr> expression);
+Ref<TrollTensor> lazyMatmul(const TrollTensor& left, const TrollTensor& right, std::vector<size_t> shape);
+
+// Evaluates every pending buffer; run before writing into a buffer that
+// deferred expressions still read
+void forcePendingTensors();
+
+#endif // LAZY_H
@@ -0,0 +1,113 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+// A whole file mapped read-only. Tensors loaded from it keep it alive
+// through their buffer and read it in place; pages are brought in as the
+// elements are first touched.
+class MappedFile {
+public:
+    // Throws std::runtime_error naming the path if it cannot be mapped
+    static std::shared_ptr<MappedFile> open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) throw std::runtime_error("Cannot open '" + path + "': " + std::strerror(errno) + ".");
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            int error = errno;
+            ::close(fd);
+            throw std::runtime_error("Cannot read '" + path + "': " + std::strerror(error) + ".");
+        }
+        size_t size = static_cast<size_t>(info.st_size);
+        void* data = nullptr;
+        if (size > 0) {
+            data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                int error = errno;
+                ::close(fd);
+                throw std::runtime_error("Cannot map '" + path + "': " + std::strerror(error) + ".");
+            }
+        }
+        ::close(fd); // The mapping holds its own reference
+        return std::shared_ptr<MappedFile>(new MappedFile(static_cast<const char*>(data), size));
+    }
+
+    ~MappedFile() {
+        if (bytes) ::munmap(const_cast<char*>(bytes), length);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    MappedFile(const char* bytes, size_t length) : bytes(bytes), length(length) {}
+
+    const char* bytes;
+    size_t length;
+};
+
+// Writes the parts one after another to a new file at path, replacing
+// any old one, in as few writev calls as the kernel allows. Throws
+// std::runtime_error naming the path if it cannot be written.
+inline void writeFile(const std::string& path, std::vector<iovec> parts) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) throw std::runtime_error("Cannot write '" + path + "': " + std::strerror(errno) + ".");
+    // Large writes may be split; resume where the last one stopped
+    iovec* part = parts.data();
+    size_t remaining = parts.size();
+    while (remaining > 0) {
+        int batch = static_cast<int>(remaining < IOV_MAX ? remaining : IOV_MAX);
+        ssize_t written = ::writev(fd, part, batch);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            int error = errno;
+            ::close(fd);
+            throw std::runtime_error("Cannot write '" + path + "': " + std::strerror(error) + ".");
+        }
+        size_t done = static_cast<size_t>(written);
+        while (remaining > 0 && done >= part->iov_len) {
+            done -= part->iov_len;
+            ++part;
+            --remaining;
+        }
+        if (remaining > 0) {
+            part->iov_base = static_cast<char*>(part->iov_base) + done;
+            part->iov_len -= done;
+        }
+    }
+    if (::close(fd) != 0) throw std::runtime_error("Cannot write '" + path + "': " + std::strerror(errno) + ".");
+}
+
+// writeFile to path + ".partial", then renamed over path. An interrupted
+// write leaves any old file at path intact, and a MappedFile still open on
+// the old file keeps reading its old contents.
+inline void replaceFile(const std::string& path, std::vector<iovec> parts) {
+    std::string partial = path + ".partial";
+    try {
+        writeFile(partial, std::move(parts));
+    } catch (const std::runtime_error&) {
+        ::unlink(partial.c_str());
+        throw;
+    }
+    if (::rename(partial.c_str(), path.c_str()) != 0) {
+        int error = errno;
+        ::unlink(partial.c_str());
+        throw std::runtime_error("Cannot write '" + path + "': " + std::strerror(error) + ".");
+    }
+}
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,51 @@
+#ifndef NATIVE_FUNCTION_H
+#define NATIVE_FUNCTION_H
+
+#include "Callable.h"
+#include <functional>
+#include <stdexcept>
+
+// Thrown by native callables, which have no call-site token. The
+// Interpreter and the VM report it as a RuntimeError at the call.
+class NativeError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// A builtin implemented in C++. The Interpreter is null under the VM. The
+// last `optional` parameters may be left out of a call.
+class NativeFunction : public Callable {
+public:
+    using Body = std::function<RuntimeValue(Interpreter*, const std::vector<RuntimeValue>&)>;
+
+    NativeFunction(std::string name, int parameters, Body body, int optional = 0)
+        : name(std::move(name)), parameters(parameters), optional(optional), body(std::move(body)) {}
+
+    int arity() override {
+        return parameters;
+    }
+
+    int minArity() override {
+        return parameters - optional;
+    }
+
+    RuntimeValue call(Interpreter* interpreter, const std::vector<RuntimeValue>& arguments) override {
+        return body(interpreter, arguments);
+    }
+
+    size_t byteSize() const override {
+        return sizeof(NativeFunction);
+    }
+
+    std::string toString() override {
+        return "<native fn " + name + ">";
+    }
+
+private:
+    std::string name;
+    int parameters;
+    int optional;
+    Body body;
+};
+
+#endif // NATIVE_FUNCTION_H
@@ -0,0 +1,22 @@
+#ifndef NUMPY_FILE_H
+#define NUMPY_FILE_H
+
+#include "TrollTensor.h"
+#include <string>
+
+// NumPy's .npy format (versions 1 to 3): a magic string, a Python dict
+// literal giving dtype, order and shape, then the raw elements.
+
+// The array in the file: a tensor reading the mapped file in place
+// (read-only, no copy), or a number for a 0-d array. Little-endian f8 and
+// f4 data in C or Fortran order. Throws NativeError if the file cannot
+// be read or its header is malformed, or the data does not fit.
+RuntimeValue loadNpy(const std::string& path);
+
+// Writes the tensor as a version 1.0 file in C order, header and elements
+// in one writev, to a temporary file renamed over path so tensors still
+// mapping an old file there are left alone. bf16 is saved as f4, which
+// NumPy can read. Throws NativeError if the file cannot be written.
+void saveNpy(TrollTensor& tensor, const std::string& path);
+
+#endif // NUMPY_FILE_H
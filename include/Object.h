@@ -0,0 +1,151 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include "Heap.h"
+#include <cstdint>
+#include <string>
+#include <utility>
+
+// Every heap value a RuntimeValue can point to. The type doubles as the
+// pointer tag inside a NaN-boxed RuntimeValue, so it must fit in 3 bits.
+enum class ObjectType : uint8_t {
+    String = 0,
+    Callable = 1,
+    Array = 2,
+    Instance = 3,
+    Environment = 4, // Never stored in a RuntimeValue
+    Tensor = 5,
+    TapeValue = 6, // A number or tensor recorded for grad()
+    Sparse = 7,    // A SparseTensor
+};
+
+class Object;
+
+// Receives the references an Object holds, see Object::trace.
+class GcVisitor {
+public:
+    virtual ~GcVisitor() = default;
+    virtual void visit(Object* object) = 0;
+};
+
+// Intrusively reference-counted heap object. Counts are not atomic: the
+// interpreter owns all runtime objects on a single thread.
+//
+// Objects register with the Heap so cycles can be collected. An untracked
+// object (a frame Environment living on the C++ stack) starts with one
+// reference owned by its scope and is never deleted through release().
+class Object {
+public:
+    struct Untracked {};
+
+    const ObjectType type;
+    uint32_t refCount = 0;
+
+    explicit Object(ObjectType type) : type(type) {
+        Heap::get().track(this);
+    }
+    Object(ObjectType type, Untracked) : type(type), refCount(1) {}
+    Object(const Object& other) : type(other.type) { // Copies start unowned
+        Heap::get().track(this);
+    }
+    virtual ~Object() {
+        if (tracked()) Heap::get().untrack(this);
+    }
+
+    void retain() { ++refCount; }
+    void release() {
+        if (--refCount == 0) delete this;
+    }
+
+    bool tracked() const { return heapIndex != UNTRACKED; }
+
+    // Reports every Object this one holds a reference to
+    virtual void trace(GcVisitor& visitor) {}
+    // Drops those references; only called on unreachable objects
+    virtual void clearReferences() {}
+    // Approximate footprint, for --gc-stats
+    virtual size_t byteSize() const { return sizeof(Object); }
+
+private:
+    friend class Heap;
+    static constexpr uint32_t UNTRACKED = UINT32_MAX;
+
+    uint32_t heapIndex = UNTRACKED;
+    int32_t gcRefs = 0;
+    bool gcMarked = false;
+};
+
+inline void Heap::track(Object* object) {
+    object->heapIndex = static_cast<uint32_t>(objects.size());
+    objects.push_back(object);
+    ++allocatedSinceCollect;
+    ++totalAllocated;
+    if (objects.size() > peakObjects) peakObjects = objects.size();
+}
+
+inline void Heap::untrack(Object* object) {
+    Object* last = objects.back();
+    objects[object->heapIndex] = last;
+    last->heapIndex = object->heapIndex;
+    objects.pop_back();
+    object->heapIndex = Object::UNTRACKED;
+}
+
+// Owning handle to an Object subclass, the intrusive counterpart of shared_ptr.
+template <typename T>
+class Ref {
+public:
+    Ref() = default;
+    Ref(std::nullptr_t) {}
+    Ref(T* ptr) : ptr(ptr) {
+        if (ptr) ptr->retain();
+    }
+    Ref(const Ref& other) : Ref(other.ptr) {}
+    Ref(Ref&& other) noexcept : ptr(other.ptr) {
+        other.ptr = nullptr;
+    }
+    template <typename U>
+    Ref(const Ref<U>& other) : Ref(static_cast<T*>(other.get())) {}
+    ~Ref() {
+        if (ptr) ptr->release();
+    }
+
+    Ref& operator=(Ref other) noexcept {
+        std::swap(ptr, other.ptr);
+        return *this;
+    }
+
+    void reset() {
+        T* old = ptr;
+        ptr = nullptr;
+        if (old) old->release();
+    }
+
+    T* get() const { return ptr; }
+    T* operator->() const { return ptr; }
+    T& operator*() const { return *ptr; }
+    explicit operator bool() const { return ptr != nullptr; }
+    bool operator==(const Ref& other) const { return ptr == other.ptr; }
+    bool operator!=(const Ref& other) const { return ptr != other.ptr; }
+
+private:
+    T* ptr = nullptr;
+};
+
+template <typename T, typename... Args>
+Ref<T> makeRef(Args&&... args) {
+    return Ref<T>(new T(std::forward<Args>(args)...));
+}
+
+class TrollString : public Object {
+public:
+    std::string value;
+
+    explicit TrollString(std::string value) : Object(ObjectType::String), value(std::move(value)) {}
+
+    size_t byteSize() const override {
+        return sizeof(TrollString) + value.capacity();
+    }
+};
+
+#endif // OBJECT_H
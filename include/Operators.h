@@ -0,0 +1,28 @@
+#ifndef OPERATORS_H
+#define OPERATORS_H
+
+#include "RuntimeValue.h"
+#include "Token.h"
+
+// Operator semantics shared by the tree-walking Interpreter and the VM, so
+// both back ends agree on results and error messages.
+
+bool isTruthy(const RuntimeValue& value);
+bool isEqual(const RuntimeValue& a, const RuntimeValue& b);
+
+RuntimeValue binaryOp(const Token& op, const RuntimeValue& left, const RuntimeValue& right);
+RuntimeValue unaryOp(const Token& op, const RuntimeValue& right);
+
+RuntimeValue indexGet(const Token& bracket, const RuntimeValue& object, const RuntimeValue& index);
+void indexSet(const Token& bracket, const RuntimeValue& object, const RuntimeValue& index, const RuntimeValue& value);
+// object[start:end] over the first dimension; nil bounds stand for the
+// start and the end. Tensors give a view on the same buffer, arrays a copy.
+RuntimeValue sliceGet(const Token& bracket, const RuntimeValue& object, const RuntimeValue& start, const RuntimeValue& end);
+// object.name for anything but an instance: tensor.T, the transposed view
+RuntimeValue propertyGet(const Token& name, const RuntimeValue& object);
+
+// Value of an array literal: a TrollTensor when the elements are uniformly
+// numeric, otherwise a TrollArray
+RuntimeValue arrayLiteral(std::vector<RuntimeValue> elements);
+
+#endif // OPERATORS_H
@@ -0,0 +1,52 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "AST.h"
+#include <vector>
+#include <memory>
+
+// Rewrites the tree between Parser::parse() and the back ends: folds
+// operators whose operands are literals, drops branches and loops whose
+// condition is a constant, and pre-boxes every literal's RuntimeValue.
+// Calls returned straight from a function body are marked as tail calls.
+// Each visit returns the replacement node (std::shared_ptr<Expr> or
+// std::shared_ptr<Stmt>); a null statement means it was removed.
+class Optimizer : public Visitor {
+public:
+    std::vector<std::shared_ptr<Stmt>> optimize(const std::vector<std::shared_ptr<Stmt>>& statements);
+
+    // Expression Visitors
+    std::any visitLiteralExpr(std::shared_ptr<LiteralExpr> expr) override;
+    std::any visitVariableExpr(std::shared_ptr<VariableExpr> expr) override;
+    std::any visitBinaryExpr(std::shared_ptr<BinaryExpr> expr) override;
+    std::any visitUnaryExpr(std::shared_ptr<UnaryExpr> expr) override;
+    std::any visitAssignmentExpr(std::shared_ptr<AssignmentExpr> expr) override;
+    std::any visitLogicalExpr(std::shared_ptr<LogicalExpr> expr) override;
+    std::any visitCallExpr(std::shared_ptr<CallExpr> expr) override;
+    std::any visitGetExpr(std::shared_ptr<GetExpr> expr) override;
+    std::any visitArrayLiteralExpr(std::shared_ptr<ArrayLiteralExpr> expr) override;
+    std::any visitIndexExpr(std::shared_ptr<IndexExpr> expr) override;
+    std::any visitSliceExpr(std::shared_ptr<SliceExpr> expr) override;
+    std::any visitArrayAssignmentExpr(std::shared_ptr<ArrayAssignmentExpr> expr) override;
+
+    // Statement Visitors
+    std::any visitExprStmt(std::shared_ptr<ExprStmt> stmt) override;
+    std::any visitPrintStmt(std::shared_ptr<PrintStmt> stmt) override;
+    std::any visitLetStmt(std::shared_ptr<LetStmt> stmt) override;
+    std::any visitBlockStmt(std::shared_ptr<BlockStmt> stmt) override;
+    std::any visitIfStmt(std::shared_ptr<IfStmt> stmt) override;
+    std::any visitWhileStmt(std::shared_ptr<WhileStmt> stmt) override;
+    std::any visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt) override;
+    std::any visitReturnStmt(std::shared_ptr<ReturnStmt> stmt) override;
+    std::any visitModelStmt(std::shared_ptr<ModelStmt> stmt) override;
+
+private:
+    int functionDepth = 0;
+
+    std::shared_ptr<Expr> optimize(const std::shared_ptr<Expr>& expr);
+    std::shared_ptr<Stmt> optimize(const std::shared_ptr<Stmt>& stmt);
+    std::shared_ptr<Stmt> optimizeBranch(const std::shared_ptr<Stmt>& stmt);
+    void optimizeStatements(std::vector<std::shared_ptr<Stmt>>& statements);
+};
+
+#endif // OPTIMIZER_H
@@ -0,0 +1,73 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "AST.h"
+#include <vector>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// Static pass run between Parser::parse() and Interpreter::interpret().
+// Gives every local a fixed slot in its scope's Environment and records how
+// many scopes up each variable reference has to hop. Anything not found in an
+// enclosing local scope is left as a global (depth -1) and looked up by name.
+class Resolver : public Visitor {
+public:
+    void resolve(const std::vector<std::shared_ptr<Stmt>>& statements);
+
+    // Expression Visitors
+    std::any visitLiteralExpr(std::shared_ptr<LiteralExpr> expr) override;
+    std::any visitVariableExpr(std::shared_ptr<VariableExpr> expr) override;
+    std::any visitBinaryExpr(std::shared_ptr<BinaryExpr> expr) override;
+    std::any visitUnaryExpr(std::shared_ptr<UnaryExpr> expr) override;
+    std::any visitAssignmentExpr(std::shared_ptr<AssignmentExpr> expr) override;
+    std::any visitLogicalExpr(std::shared_ptr<LogicalExpr> expr) override;
+    std::any visitCallExpr(std::shared_ptr<CallExpr> expr) override;
+    std::any visitGetExpr(std::shared_ptr<GetExpr> expr) override;
+    std::any visitArrayLiteralExpr(std::shared_ptr<ArrayLiteralExpr> expr) override;
+    std::any visitIndexExpr(std::shared_ptr<IndexExpr> expr) override;
+    std::any visitSliceExpr(std::shared_ptr<SliceExpr> expr) override;
+    std::any visitArrayAssignmentExpr(std::shared_ptr<ArrayAssignmentExpr> expr) override;
+
+    // Statement Visitors
+    std::any visitExprStmt(std::shared_ptr<ExprStmt> stmt) override;
+    std::any visitPrintStmt(std::shared_ptr<PrintStmt> stmt) override;
+    std::any visitLetStmt(std::shared_ptr<LetStmt> stmt) override;
+    std::any visitBlockStmt(std::shared_ptr<BlockStmt> stmt) override;
+    std::any visitIfStmt(std::shared_ptr<IfStmt> stmt) override;
+    std::any visitWhileStmt(std::shared_ptr<WhileStmt> stmt) override;
+    std::any visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt) override;
+    std::any visitReturnStmt(std::shared_ptr<ReturnStmt> stmt) override;
+    std::any visitModelStmt(std::shared_ptr<ModelStmt> stmt) override;
+
+private:
+    struct Deferred {
+        std::shared_ptr<FunctionStmt> function;
+        std::vector<int> visible; // Per enclosing scope, the slots declared ahead of the function
+    };
+
+    // One entry per runtime Environment
+    struct Scope {
+        std::unordered_map<std::string, int> slots;
+        std::unordered_set<std::string> methods; // Model scopes only
+        bool captured = false;
+        std::vector<Deferred> deferred; // Bodies resolved at the end of the scope
+        int visible = -1; // While resolving a deferred body: slots declared ahead of it, -1 for all
+    };
+    std::vector<Scope> scopes;
+
+    void resolve(const std::shared_ptr<Stmt>& stmt);
+    void resolve(const std::shared_ptr<Expr>& expr);
+    void resolveStatements(const std::vector<std::shared_ptr<Stmt>>& statements);
+    void resolveFunction(const std::shared_ptr<FunctionStmt>& function);
+    void resolveLocal(const Token& name, int& depth, int& slot, std::vector<SlotRef>& fallbacks, bool& globalFallback);
+
+    void beginScope();
+    int endScope(); // Returns the number of slots the scope used
+    int declare(const std::string& name); // -1 at global scope
+    void markCaptured();
+    void hoistDeclarations(const std::vector<std::shared_ptr<Stmt>>& statements);
+};
+
+#endif // RESOLVER_H
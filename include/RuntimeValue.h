@@ -1,24 +1,150 @@
 #ifndef RUNTIME_VALUE_H
 #define RUNTIME_VALUE_H
 
-#include <variant>
+#include "Object.h"
+#include <cstdint>
+#include <cstring>
+#include <cmath>
 #include <string>
+#include <variant>
 #include <vector>
 #include <iostream>
-
-// Forward declaration for recursive types (like Arrays of RuntimeValues) if needed later
-// For now, simple types.
+#include <memory>
 
 // Forward declare Callable and TrollArray and TrollInstance
 class Callable;
 class TrollArray;
 class TrollInstance;
+class TrollTensor;
+class TapeValue;
+class SparseTensor;
 
-using RuntimeValue = std::variant<std::monostate, double, bool, std::string, std::shared_ptr<Callable>, std::shared_ptr<TrollArray>, std::shared_ptr<TrollInstance>>;
+// NaN-boxed 8-byte value.
+//
+//   number   any double that is not one of the patterns below (NaNs are canonicalized)
+//   nil/bool QNAN | 1..3
+//   undefined QNAN | 4, a local slot whose let has not run yet
+//   object   SIGN | QNAN | pointer | ObjectType in the low 3 bits
+//
+// Objects are reference counted through Object::retain/release.
+class RuntimeValue {
+public:
+    RuntimeValue() : bits(NIL_BITS) {}
+    RuntimeValue(std::monostate) : bits(NIL_BITS) {}
+    RuntimeValue(double number) {
+        if (std::isnan(number)) {
+            bits = CANONICAL_NAN;
+        } else {
+            std::memcpy(&bits, &number, sizeof(double));
+        }
+    }
+    RuntimeValue(int number) : RuntimeValue(static_cast<double>(number)) {}
+    RuntimeValue(bool boolean) : bits(boolean ? TRUE_BITS : FALSE_BITS) {}
+    RuntimeValue(const std::string& string) : RuntimeValue(new TrollString(string)) {}
+    RuntimeValue(std::string&& string) : RuntimeValue(new TrollString(std::move(string))) {}
+    RuntimeValue(const char* string) : RuntimeValue(new TrollString(string)) {}
+    RuntimeValue(Object* object) {
+        object->retain();
+        bits = SIGN_BIT | QNAN | reinterpret_cast<uintptr_t>(object) | static_cast<uint64_t>(object->type);
+    }
+    template <typename T>
+    RuntimeValue(const Ref<T>& ref) : RuntimeValue(static_cast<Object*>(ref.get())) {}
 
-std::string to_string(const RuntimeValue& value);
+    // Fills heap environment slots until their let runs; see Resolver::resolveLocal
+    static RuntimeValue undefined() {
+        RuntimeValue value;
+        value.bits = UNDEFINED_BITS;
+        return value;
+    }
+
+    RuntimeValue(const RuntimeValue& other) : bits(other.bits) {
+        if (isObject()) asObject()->retain();
+    }
+    RuntimeValue(RuntimeValue&& other) noexcept : bits(other.bits) {
+        other.bits = NIL_BITS;
+    }
+    ~RuntimeValue() {
+        if (isObject()) asObject()->release();
+    }
+
+    RuntimeValue& operator=(const RuntimeValue& other) {
+        if (other.isObject()) other.asObject()->retain();
+        if (isObject()) asObject()->release();
+        bits = other.bits;
+        return *this;
+    }
+    RuntimeValue& operator=(RuntimeValue&& other) noexcept {
+        if (this != &other) {
+            if (isObject()) asObject()->release();
+            bits = other.bits;
+            other.bits = NIL_BITS;
+        }
+        return *this;
+    }
+
+    bool isNil() const { return bits == NIL_BITS; }
+    bool isUndefined() const { return bits == UNDEFINED_BITS; }
+    bool isBool() const { return (bits | 1) == TRUE_BITS; }
+    bool isNumber() const { return (bits & QNAN) != QNAN; }
+    bool isObject() const { return (bits & (SIGN_BIT | QNAN)) == (SIGN_BIT | QNAN); }
+    bool isObjectType(ObjectType type) const {
+        return (bits & (SIGN_BIT | QNAN | TAG_MASK)) == (SIGN_BIT | QNAN | static_cast<uint64_t>(type));
+    }
+    bool isString() const { return isObjectType(ObjectType::String); }
+    bool isCallable() const { return isObjectType(ObjectType::Callable); }
+    bool isArray() const { return isObjectType(ObjectType::Array); }
+    bool isInstance() const { return isObjectType(ObjectType::Instance); }
+    bool isTensor() const { return isObjectType(ObjectType::Tensor); }
+    bool isTapeValue() const { return isObjectType(ObjectType::TapeValue); }
+    bool isSparse() const { return isObjectType(ObjectType::Sparse); }
+
+    double asNumber() const {
+        double number;
+        std::memcpy(&number, &bits, sizeof(double));
+        return number;
+    }
+    bool asBool() const { return bits == TRUE_BITS; }
+    Object* asObject() const {
+        return reinterpret_cast<Object*>(static_cast<uintptr_t>(bits & POINTER_MASK));
+    }
+    const std::string& asString() const { return static_cast<TrollString*>(asObject())->value; }
+    Callable* asCallable() const;
+    TrollArray* asArray() const;
+    TrollInstance* asInstance() const;
+    TrollTensor* asTensor() const;
+    TapeValue* asTapeValue() const;
+    SparseTensor* asSparse() const;
+
+    // Tag of the value for "same kind" comparisons: one per immediate kind or object type
+    uint64_t typeTag() const {
+        if (isNumber()) return 0;
+        if (isObject()) return bits & (SIGN_BIT | QNAN | TAG_MASK);
+        if (isBool()) return TRUE_BITS;
+        return bits;
+    }
+
+    uint64_t rawBits() const { return bits; }
+
+private:
+    static constexpr uint64_t SIGN_BIT = 0x8000000000000000ull;
+    static constexpr uint64_t QNAN = 0x7ffc000000000000ull;
+    static constexpr uint64_t CANONICAL_NAN = 0x7ff8000000000000ull;
+    static constexpr uint64_t NIL_BITS = QNAN | 1;
+    static constexpr uint64_t FALSE_BITS = QNAN | 2;
+    static constexpr uint64_t TRUE_BITS = QNAN | 3;
+    static constexpr uint64_t UNDEFINED_BITS = QNAN | 4;
+    static constexpr uint64_t TAG_MASK = 7;
+    static constexpr uint64_t POINTER_MASK = 0x0000fffffffffff8ull;
+
+    uint64_t bits;
+};
+
+static_assert(sizeof(RuntimeValue) == 8, "RuntimeValue must stay NaN-boxed");
 
 std::string to_string(const RuntimeValue& value);
 
+inline void trace(GcVisitor& visitor, const RuntimeValue& value) {
+    if (value.isObject()) visitor.visit(value.asObject());
+}
 
 #endif // RUNTIME_VALUE_H
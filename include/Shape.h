@@ -0,0 +1,32 @@
+#ifndef SHAPE_H
+#define SHAPE_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// Hidden class of a model's instances: maps every field and method name to
+// its slot in the instance's flat field array. All instances of a TrollModel
+// point at the model's Shape, so two instances agree on layout iff their
+// shape pointers are equal.
+class Shape {
+public:
+    explicit Shape(std::unordered_map<std::string, int> slots) : slots(std::move(slots)) {}
+
+    int slotOf(const std::string& name) const {
+        auto it = slots.find(name);
+        return it != slots.end() ? it->second : -1;
+    }
+
+private:
+    std::unordered_map<std::string, int> slots;
+};
+
+// Monomorphic inline cache for one property access site. Holding a reference
+// keeps the cached shape alive, so a pointer match can never be a reused address.
+struct PropertyCache {
+    std::shared_ptr<const Shape> shape;
+    int slot = -1;
+};
+
+#endif // SHAPE_H
@@ -0,0 +1,63 @@
+#ifndef SPARSE_TENSOR_H
+#define SPARSE_TENSOR_H
+
+#include "TrollTensor.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// f64 matrix in compressed sparse row form: the nonzeros of row i are
+// values[rowStart[i] .. rowStart[i + 1]), in increasing column order, at
+// the matching entries of `columns`. Memory and `@` both scale with the
+// number of nonzeros rather than rows x cols.
+class SparseTensor : public Object {
+public:
+    size_t rows;
+    size_t cols;
+    std::vector<size_t> rowStart; // rows + 1 offsets into columns and values
+    std::vector<uint32_t> columns;
+    std::vector<double> values;
+
+    // Largest extent of either dimension; columns are stored in 32 bits
+    static constexpr size_t MAX_EXTENT = UINT32_MAX;
+
+    // No nonzeros
+    SparseTensor(size_t rows, size_t cols);
+
+    // values[e] at (rowIndex[e], columnIndex[e]) for every e, in any order;
+    // entries at the same position are summed. Indices must be in range.
+    static Ref<SparseTensor> fromTriplets(size_t rows, size_t cols, const std::vector<size_t>& rowIndex,
+                                          const std::vector<size_t>& columnIndex, const std::vector<double>& values);
+    // The nonzero elements of a matrix of any dtype
+    static Ref<SparseTensor> fromDense(const TrollTensor& matrix);
+
+    size_t nonzeros() const { return values.size(); }
+    // A new contiguous f64 tensor with the zeros filled in
+    Ref<TrollTensor> toDense() const;
+    // Rows and columns swapped, still in CSR form
+    Ref<SparseTensor> transpose() const;
+
+    std::string toString() const;
+
+    size_t byteSize() const override {
+        return sizeof(SparseTensor) + rowStart.capacity() * sizeof(size_t) +
+               columns.capacity() * sizeof(uint32_t) + values.capacity() * sizeof(double);
+    }
+};
+
+inline SparseTensor* RuntimeValue::asSparse() const {
+    return static_cast<SparseTensor*>(asObject());
+}
+
+// a (m x k) @ b (k x n, f64, contiguous): a new m x n f64 tensor. Each
+// output row adds up the rows of b its nonzeros pick out; rows are split
+// across the ThreadPool in chunks of about equal nonzeros, so a few dense
+// rows (hubs of a power-law graph) do not hold up the rest.
+Ref<TrollTensor> sparseDenseMatmul(const SparseTensor& a, const TrollTensor& b);
+
+// a (m x k, f64, any strides) @ b (k x n): a new m x n f64 tensor. Each
+// nonzero of a row of a scatters a scaled row of b into the output row;
+// rows of a are split across the ThreadPool.
+Ref<TrollTensor> denseSparseMatmul(const TrollTensor& a, const SparseTensor& b);
+
+#endif // SPARSE_TENSOR_H
@@ -0,0 +1,33 @@
+#ifndef TENSOR_ALLOCATOR_H
+#define TENSOR_ALLOCATOR_H
+
+#include <cstddef>
+#include <ostream>
+
+// Caching allocator for tensor element storage. Loops that build tensors
+// of the same shapes over and over (a training step) would otherwise pay
+// for malloc, and the page faults of large blocks, on every result.
+//
+// Requests are rounded up to size classes, four per power of two, and a
+// freed block goes onto its class's free list in the freeing thread
+// instead of back to the system; the next request of that class takes it.
+// Blocks above MAX_CACHED_BYTES, and frees that would take a thread's
+// cache past MAX_THREAD_CACHE_BYTES, bypass the cache. Blocks are 64-byte
+// aligned for the SIMD kernels.
+class TensorAllocator {
+public:
+    static constexpr size_t MAX_CACHED_BYTES = size_t(1) << 28;
+    static constexpr size_t MAX_THREAD_CACHE_BYTES = size_t(1) << 30;
+
+    // Uninitialized storage of the given size
+    static void* allocate(size_t bytes);
+    static void deallocate(void* data, size_t bytes);
+
+    // Returns the calling thread's cached blocks to the system; the number
+    // of bytes freed
+    static size_t release();
+
+    static void printStats(std::ostream& out);
+};
+
+#endif // TENSOR_ALLOCATOR_H
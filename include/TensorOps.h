@@ -0,0 +1,92 @@
+#ifndef TENSOR_OPS_H
+#define TENSOR_OPS_H
+
+#include "TrollTensor.h"
+#include <vector>
+
+enum class ElementOp {
+    Add,
+    Subtract,
+    Multiply,
+    Divide,
+};
+
+// NumPy broadcasting: shapes are aligned at their last dimension and each
+// pair of extents must match or be 1. False if a and b are incompatible.
+bool broadcastShapes(const std::vector<size_t>& a, const std::vector<size_t>& b, std::vector<size_t>& out);
+
+// One side of an elementwise op, laid over the result shape: strides are 0
+// along broadcast dimensions. A number is an Operand without data and with
+// all strides 0.
+struct Operand {
+    const void* data;
+    std::vector<ptrdiff_t> strides;
+    double number = 0.0;
+
+    static Operand of(const TrollTensor& tensor, const std::vector<size_t>& shape);
+    static Operand of(const void* data, const std::vector<size_t>& from, const std::vector<ptrdiff_t>& strides,
+                      const std::vector<size_t>& shape);
+    static Operand of(double number, const std::vector<size_t>& shape);
+};
+
+// out = a op b over out's shape, as vectorized row loops; large outputs are
+// split across the ThreadPool. out must be contiguous, and tensor operands
+// of out's dtype. bf16 is computed in f32.
+void elementwise(ElementOp op, const Operand& a, const Operand& b, TrollTensor& out);
+
+// One run of that loop in f64: out[i] = a[i * sa] op b[i * sb] for i < n
+void elementwiseRun(ElementOp op, const double* a, ptrdiff_t sa, const double* b, ptrdiff_t sb, double* out, size_t n);
+
+enum class ElementFunction {
+    Exp,
+    Log,
+    Tanh,
+    Relu,
+    Step, // 1 where x > 0, else 0: the derivative of Relu
+};
+
+double apply(ElementFunction function, double x);
+void mapRun(ElementFunction function, const double* x, ptrdiff_t stride, double* out, size_t n);
+
+// out = function(in) elementwise; out has in's shape and dtype and must
+// be contiguous
+void map(ElementFunction function, const TrollTensor& in, TrollTensor& out);
+
+// left @ right for tensors of rank 1 or 2 with matching inner extents and
+// the same dtype, into out (that dtype, contiguous, rows of left x columns
+// of right)
+void matmul(const TrollTensor& left, const TrollTensor& right, void* out);
+
+// left @ right where either has rank 3, a leading batch dimension: the
+// product of each sample's matrices, with a 2-D operand (or a batch of
+// one) taking part in every product, as one batchedGemm call. Same dtype,
+// into out (contiguous, batch x rows of left x columns of right, without
+// the dimension of a vector operand).
+void batchedMatmul(const TrollTensor& left, const TrollTensor& right, size_t batch, void* out);
+
+// Undoes broadcasting for gradients: sums `in` over every dimension that
+// broadcasting `shape` up to in.shape would have stretched or added. The
+// result has in's dtype.
+Ref<TrollTensor> sumTo(const TrollTensor& in, const std::vector<size_t>& shape);
+
+enum class Reduction {
+    Sum,
+    Mean,
+    Max,
+    ArgMax, // Index of the first maximum
+    Norm,   // Euclidean: the square root of the sum of squares
+};
+
+// Sums are pairwise over blocks of SIMD accumulators; large inputs are
+// split across the ThreadPool in fixed chunks, so results do not depend on
+// the thread count. Max and ArgMax of nothing are not defined: callers
+// check for empty inputs.
+
+// The reduction of all of in's elements, computed in in's compute type
+double reduceAll(Reduction reduction, const TrollTensor& in);
+
+// The reduction along one axis: in's shape without it, in in's dtype (f64
+// indices for ArgMax)
+Ref<TrollTensor> reduceAxis(Reduction reduction, const TrollTensor& in, size_t axis);
+
+#endif // TENSOR_OPS_H
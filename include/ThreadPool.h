@@ -0,0 +1,67 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Process-wide work-stealing pool for numeric kernels. Each thread owns a
+// deque: it pushes and pops its own work at the back, idle threads steal
+// from the front of the others. A thread waiting on a parallelFor keeps
+// running tasks meanwhile, so kernels may nest parallel loops.
+//
+// Tasks must only touch raw buffers: Objects, RuntimeValues and the Heap
+// are single-threaded.
+class ThreadPool {
+public:
+    // Total threads including the caller; set before the first get(). The
+    // default is TROLL_NUM_THREADS, else the hardware concurrency.
+    static void setThreadCount(size_t count);
+    static ThreadPool& get();
+
+    size_t threadCount() const { return queues.size(); }
+
+    // Calls body(begin, end) on chunks of at most `grain` indices covering
+    // [0, count), spread over the pool, and returns once all have run. The
+    // first exception thrown by a chunk is rethrown here.
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+    // Loops over fewer elements (or multiply-adds) than this run on the
+    // calling thread; larger ones are split into chunks of about GRAIN
+    static constexpr size_t PARALLEL_ELEMENTS = 1 << 16;
+    static constexpr size_t GRAIN = 1 << 14;
+
+    // body(begin, end) over [0, count) items of `unit` elements each:
+    // directly below PARALLEL_ELEMENTS elements in all, else by parallelFor
+    // in chunks of about GRAIN elements
+    static void forEach(size_t count, size_t unit, const std::function<void(size_t, size_t)>& body);
+
+    ~ThreadPool();
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    explicit ThreadPool(size_t count);
+
+    std::vector<std::unique_ptr<Queue>> queues; // queues[0] belongs to the main thread
+    std::vector<std::thread> workers;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<size_t> queued{0};
+    bool stopping = false;
+
+    void push(size_t queue, std::function<void()> task);
+    bool runOne(size_t queue); // Own work first, then steal
+    void workerLoop(size_t queue);
+};
+
+#endif // THREAD_POOL_H
@@ -4,7 +4,7 @@
 enum class TokenType {
     LEFT_PAREN, RIGHT_PAREN, LEFT_BRACE, RIGHT_BRACE,
     LEFT_BRACKET, RIGHT_BRACKET,
-    COMMA, SEMICOLON, MINUS, PLUS, SLASH, STAR, PERCENT, AT, DOT,
+    COMMA, SEMICOLON, MINUS, PLUS, SLASH, STAR, PERCENT, AT, DOT, COLON,
 
     BANG, BANG_EQUAL,
     EQUAL, EQUAL_EQUAL,
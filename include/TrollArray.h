@@ -5,15 +5,31 @@
 #include <string>
 #include "RuntimeValue.h"
 
-class TrollArray {
+class TrollArray : public Object {
 public:
     std::vector<RuntimeValue> elements;
 
-    TrollArray() {}
-    TrollArray(std::vector<RuntimeValue> elements) : elements(std::move(elements)) {}
+    TrollArray() : Object(ObjectType::Array) {}
+    TrollArray(std::vector<RuntimeValue> elements) : Object(ObjectType::Array), elements(std::move(elements)) {}
+
+    void trace(GcVisitor& visitor) override {
+        for (const auto& element : elements) ::trace(visitor, element);
+    }
+
+    void clearReferences() override {
+        elements.clear();
+    }
+
+    size_t byteSize() const override {
+        return sizeof(TrollArray) + elements.capacity() * sizeof(RuntimeValue);
+    }
 
     // Helper to check if it's a matrix (2D)
     // For now, we assume simple arrays
 };
 
+inline TrollArray* RuntimeValue::asArray() const {
+    return static_cast<TrollArray*>(asObject());
+}
+
 #endif // TROLL_ARRAY_H
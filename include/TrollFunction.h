@@ -5,14 +5,13 @@
 #include "AST.h"
 #include "Environment.h"
 #include "Interpreter.h"
-#include "Return.h"
 
 class TrollFunction : public Callable {
 public:
     std::shared_ptr<FunctionStmt> declaration;
-    std::shared_ptr<Environment> closure;
+    Ref<Environment> closure;
 
-    TrollFunction(std::shared_ptr<FunctionStmt> declaration, std::shared_ptr<Environment> closure)
+    TrollFunction(std::shared_ptr<FunctionStmt> declaration, Ref<Environment> closure)
         : declaration(std::move(declaration)), closure(std::move(closure)) {}
 
     int arity() override {
@@ -20,20 +19,24 @@ public:
     }
 
     RuntimeValue call(Interpreter* interpreter, const std::vector<RuntimeValue>& arguments) override {
-        // Create a new environment for the function scope
-        std::shared_ptr<Environment> environment = std::make_shared<Environment>(closure);
+        // Params occupy the first slots (see Resolver::resolveFunction)
+        return interpreter->callFunction(this, arguments);
+    }
 
-        for (size_t i = 0; i < declaration->params.size(); ++i) {
-            environment->define(declaration->params[i].lexeme, arguments[i]);
-        }
+    RuntimeValue bind(Ref<Environment> receiver) override {
+        return RuntimeValue(makeRef<TrollFunction>(declaration, std::move(receiver)));
+    }
 
-        try {
-            interpreter->executeBlock(declaration->body, environment);
-        } catch (const Return& returnValue) {
-            return returnValue.value;
-        }
+    void trace(GcVisitor& visitor) override {
+        if (closure) visitor.visit(closure.get());
+    }
+
+    void clearReferences() override {
+        closure.reset();
+    }
 
-        return RuntimeValue(std::monostate{}); // Default return nil
+    size_t byteSize() const override {
+        return sizeof(TrollFunction);
     }
 
     std::string toString() override {
@@ -6,20 +6,46 @@
 #include <unordered_map>
 #include "RuntimeValue.h"
 #include "Environment.h"
+#include "Shape.h"
 #include "Token.h"
 
 // Forward declare TrollModel
 class TrollModel;
 
-class TrollInstance {
+class TrollInstance : public Object {
 public:
-    std::shared_ptr<TrollModel> model;
-    std::shared_ptr<Environment> env;
+    Ref<TrollModel> model;
+    const Shape* shape;     // Layout of fields, shared with every instance of the model
+    RuntimeValue* fields = nullptr; // env->slots; methods reach the same slots through their closure
+    Ref<Environment> env;
 
-    TrollInstance(std::shared_ptr<TrollModel> model); // Defined in CPP to avoid circular dep
+    TrollInstance(Ref<TrollModel> model); // Defined in CPP to avoid circular dep
+    ~TrollInstance() override;
+
+    void setEnvironment(Ref<Environment> environment);
+
+    void trace(GcVisitor& visitor) override;
+    void clearReferences() override;
+    size_t byteSize() const override { return sizeof(TrollInstance); }
 
     RuntimeValue get(Token name);
     void set(Token name, RuntimeValue value);
+
+    // Inline-cached property read: a shape compare and an indexed load when the
+    // site has seen this model before.
+    RuntimeValue get(const Token& name, PropertyCache& cache) {
+        if (cache.shape.get() == shape) {
+            return fields[cache.slot];
+        }
+        return getUncached(name, cache);
+    }
+
+private:
+    RuntimeValue getUncached(const Token& name, PropertyCache& cache);
 };
 
+inline TrollInstance* RuntimeValue::asInstance() const {
+    return static_cast<TrollInstance*>(asObject());
+}
+
 #endif // TROLL_INSTANCE_H
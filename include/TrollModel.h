@@ -12,10 +12,12 @@ class TrollModel : public Callable {
 public:
     std::string name;
     std::shared_ptr<ModelStmt> declaration;
-    std::shared_ptr<Environment> closure;
+    Ref<Environment> closure;
+    std::shared_ptr<const Shape> shape; // Field layout of every instance
+    std::vector<std::pair<int, RuntimeValue>> methods; // Field slot -> unbound method, shared by all instances
+    std::vector<std::shared_ptr<Stmt>> initializers;   // The model body minus its methods
 
-    TrollModel(std::shared_ptr<ModelStmt> declaration, std::shared_ptr<Environment> closure)
-        : name(declaration->name.lexeme), declaration(std::move(declaration)), closure(std::move(closure)) {}
+    TrollModel(std::shared_ptr<ModelStmt> declaration, Ref<Environment> closure);
 
     int arity() override {
         return 0; // Default constructor 0 args for now
@@ -26,6 +28,13 @@ public:
     std::string toString() override {
         return name;
     }
+
+    void trace(GcVisitor& visitor) override;
+    void clearReferences() override;
+    size_t byteSize() const override { return sizeof(TrollModel); }
+
+    // A new instance with its methods in place and its fields still nil
+    Ref<TrollInstance> instantiate();
 };
 
 #endif // TROLL_MODEL_H
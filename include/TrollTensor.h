@@ -0,0 +1,134 @@
+#ifndef TROLL_TENSOR_H
+#define TROLL_TENSOR_H
+
+#include "DType.h"
+#include "RuntimeValue.h"
+#include "TensorAllocator.h"
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct LazyExpr;
+
+// Element storage shared by a tensor and every view of it.
+class TensorBuffer : public std::enable_shared_from_this<TensorBuffer> {
+public:
+    // Zero-filled
+    explicit TensorBuffer(size_t count, DType dtype = DType::F64)
+        : values(TensorAllocator::allocate(count * dtypeSize(dtype))), count(count), type(dtype) {
+        std::memset(values, 0, bytes());
+    }
+    // Filled from `expression` by the first data() call (see Lazy.h); f64
+    TensorBuffer(size_t count, std::shared_ptr<LazyExpr> expression)
+        : count(count), expression(std::move(expression)) {}
+    // Elements in memory kept alive by `owner` (a mapped file, say); they
+    // are never written
+    TensorBuffer(const void* values, size_t count, DType dtype, std::shared_ptr<const void> owner)
+        : values(const_cast<void*>(values)), count(count), type(dtype), owner(std::move(owner)) {}
+    ~TensorBuffer() {
+        if (!owner) TensorAllocator::deallocate(values, bytes());
+    }
+
+    TensorBuffer(const TensorBuffer&) = delete;
+    TensorBuffer& operator=(const TensorBuffer&) = delete;
+
+    void* raw() const {
+        if (expression) materialize();
+        return values;
+    }
+    // Elements of an f64 buffer
+    double* data() const { return static_cast<double*>(raw()); }
+    size_t size() const { return count; }
+    DType dtype() const { return type; }
+    size_t bytes() const { return count * dtypeSize(type); }
+    const std::shared_ptr<LazyExpr>& pending() const { return expression; }
+    bool readOnly() const { return owner != nullptr; }
+
+    size_t lazyReaders = 0; // Deferred expressions that read this buffer
+
+private:
+    mutable void* values = nullptr;
+    size_t count;
+    DType type = DType::F64;
+    mutable std::shared_ptr<LazyExpr> expression;
+    std::shared_ptr<const void> owner;
+
+    void materialize() const;
+};
+
+// Dense n-dimensional array of numbers. Element (i0, i1, ...) lives at
+// data()[i0 * strides[0] + i1 * strides[1] + ...]. A new tensor is
+// contiguous and row-major; views (a row of a matrix) share the buffer of
+// the tensor they came from. Elements are stored as the buffer's dtype.
+class TrollTensor : public Object {
+public:
+    std::shared_ptr<TensorBuffer> buffer;
+    size_t offset = 0;
+    std::vector<size_t> shape;
+    std::vector<ptrdiff_t> strides; // In elements
+
+    // Zero-filled and contiguous
+    explicit TrollTensor(std::vector<size_t> shape, DType dtype = DType::F64);
+    TrollTensor(std::shared_ptr<TensorBuffer> buffer, size_t offset,
+                std::vector<size_t> shape, std::vector<ptrdiff_t> strides);
+
+    size_t rank() const { return shape.size(); }
+    size_t size() const; // Number of elements
+    bool isContiguous() const;
+    DType dtype() const { return buffer->dtype(); }
+    void* raw() const { return static_cast<char*>(buffer->raw()) + offset * dtypeSize(dtype()); }
+    template <typename T>
+    T* elements() const { return static_cast<T*>(raw()); }
+    // Elements of an f64 tensor
+    double* data() const { return elements<double>(); }
+    // Element at raw() + index elements, in any dtype
+    double get(ptrdiff_t index) const;
+    void set(ptrdiff_t index, double value);
+
+    // Sub-tensor at index i of the first dimension, sharing this buffer
+    Ref<TrollTensor> row(size_t i);
+    // Indices [start, end) of the first dimension, sharing this buffer
+    Ref<TrollTensor> slice(size_t start, size_t end);
+    // This tensor if already contiguous, otherwise a contiguous copy
+    Ref<TrollTensor> contiguous();
+    // The same elements under another shape with as many; a view unless
+    // the strides cannot express it (a transposed matrix flattened, say),
+    // in which case this tensor is made contiguous first
+    Ref<TrollTensor> reshape(std::vector<size_t> newShape);
+    // Dimensions in reverse order (rows and columns swapped, for a
+    // matrix), sharing this buffer
+    Ref<TrollTensor> transpose();
+    // This tensor if it already has that dtype, otherwise a converted copy
+    Ref<TrollTensor> astype(DType dtype);
+    // Writes the elements in row-major order
+    void copyTo(double* out) const;
+    // Reads size() elements in row-major order
+    void copyFrom(const double* in);
+    // Copies the elements of an equally sized tensor, converting them
+    void copyFrom(const TrollTensor& source);
+
+    std::string toString() const;
+
+    size_t byteSize() const override {
+        // A shared buffer is split evenly among the tensors viewing it
+        return sizeof(TrollTensor) + buffer->bytes() / buffer.use_count();
+    }
+};
+
+inline TrollTensor* RuntimeValue::asTensor() const {
+    return static_cast<TrollTensor*>(asObject());
+}
+
+// The value as a tensor: tensors as they are, arrays copied if their
+// elements are uniformly numeric (numbers, or equally shaped numeric rows).
+// Null for anything else.
+Ref<TrollTensor> toTensor(const RuntimeValue& value);
+
+// Packs the elements of a nested array literal, stacking equally shaped
+// numeric rows along a new leading dimension. Flat literals are left to be
+// TrollArrays, which scripts also use as general-purpose containers.
+Ref<TrollTensor> packTensor(const std::vector<RuntimeValue>& elements);
+
+#endif // TROLL_TENSOR_H
@@ -0,0 +1,108 @@
+#ifndef VM_H
+#define VM_H
+
+#include "AST.h"
+#include "Bytecode.h"
+#include "Callable.h"
+#include "Environment.h"
+#include "TrollModel.h"
+#include <vector>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+class VM;
+
+// A compiled function plus the Environment it closes over.
+class VMFunction : public Callable {
+public:
+    std::shared_ptr<FunctionProto> proto;
+    Ref<Environment> closure;
+    VM* vm;
+
+    VMFunction(std::shared_ptr<FunctionProto> proto, Ref<Environment> closure, VM* vm)
+        : proto(std::move(proto)), closure(std::move(closure)), vm(vm) {}
+
+    int arity() override {
+        return proto->arity;
+    }
+
+    RuntimeValue call(Interpreter* interpreter, const std::vector<RuntimeValue>& arguments) override;
+
+    RuntimeValue bind(Ref<Environment> receiver) override {
+        return RuntimeValue(makeRef<VMFunction>(proto, std::move(receiver), vm));
+    }
+
+    void trace(GcVisitor& visitor) override {
+        if (closure) visitor.visit(closure.get());
+    }
+
+    void clearReferences() override {
+        closure.reset();
+    }
+
+    size_t byteSize() const override {
+        return sizeof(VMFunction);
+    }
+
+    std::string toString() override {
+        return "<fn " + proto->name + ">";
+    }
+};
+
+// A model whose body was compiled into a constructor proto. Instances are
+// ordinary TrollInstances, so property access is shared with the Interpreter.
+class VMModel : public TrollModel {
+public:
+    std::shared_ptr<FunctionProto> constructor;
+    VM* vm;
+
+    VMModel(std::shared_ptr<ModelStmt> declaration, Ref<Environment> closure,
+            std::shared_ptr<FunctionProto> constructor, VM* vm)
+        : TrollModel(std::move(declaration), std::move(closure)), constructor(std::move(constructor)), vm(vm) {}
+
+    RuntimeValue call(Interpreter* interpreter, const std::vector<RuntimeValue>& arguments) override;
+};
+
+// Register-based bytecode VM, selected with --vm. Runs the output of
+// Compiler with a single dispatch loop; calls between compiled functions
+// push a frame instead of recursing on the C++ stack.
+class VM {
+public:
+    VM();
+    void interpret(const std::vector<std::shared_ptr<Stmt>>& statements);
+
+    // Re-entry points for callables invoked from native code
+    RuntimeValue callFunction(VMFunction* function, const std::vector<RuntimeValue>& arguments);
+    RuntimeValue construct(VMModel* model);
+
+    int globalSlot(const std::string& name);
+
+private:
+    struct CallFrame {
+        FunctionProto* proto;
+        const Instruction* pc;
+        RuntimeValue* base; // R[0]; base[-1] holds the callee and receives the result
+        Ref<Environment> env;
+    };
+
+    static constexpr size_t STACK_SIZE = 1 << 18;
+    static constexpr size_t MAX_FRAMES = 1 << 14;
+
+    std::vector<RuntimeValue> stack;
+    std::vector<CallFrame> frames;
+    size_t frameCount = 0;
+
+    std::vector<RuntimeValue> globals;
+    std::vector<bool> globalDefined;
+    std::vector<std::string> globalNames;
+    std::unordered_map<std::string, int> globalIndex;
+
+    RuntimeValue* stackTop();
+    void pushFrame(FunctionProto* proto, RuntimeValue* base, Ref<Environment> env, const Token* callToken);
+    RuntimeValue runFrom(FunctionProto* proto, RuntimeValue* base, Ref<Environment> env);
+    void run(size_t baseFrame);
+    const Token& tokenAt(const CallFrame& frame, const Instruction* pc);
+};
+
+#endif // VM_H
@@ -0,0 +1,684 @@
+#include "../include/Autodiff.h"
+#include "../include/Lazy.h"
+#include "../include/NativeFunction.h"
+#include "../include/Operators.h"
+#include "../include/SparseTensor.h"
+#include "../include/TrollArray.h"
+#include "../include/TrollTensor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+enum class TapeOp {
+    Leaf,
+    Add,
+    Subtract,
+    Multiply,
+    Divide,
+    Negate,
+    MatMul,
+    Index,
+    Slice,
+    Transpose,
+    Reshape,
+    Sum,
+    Mean,
+    Max,
+    Norm,
+    Conv2d,
+    MaxPool,
+    AvgPool,
+    Exp,
+    Log,
+    Tanh,
+    Relu,
+};
+
+struct Node {
+    TapeOp op;
+    int left = -1;  // Parent nodes, -1 for constants
+    int right = -1;
+    RuntimeValue leftValue; // Forward operands as numbers or tensors
+    RuntimeValue rightValue;
+    RuntimeValue value;     // Forward result
+    size_t index = 0;       // Row or element taken by Index, first row taken by Slice, axis of a reduction,
+                            // pooling window
+    size_t stride = 1;      // Of a convolution or pooling
+    size_t padding = 0;
+};
+
+constexpr size_t ALL_AXES = SIZE_MAX; // A reduction over every element
+
+struct Tape {
+    uint64_t serial;
+    std::vector<Node> nodes;
+};
+
+Tape* activeTape = nullptr;
+uint64_t nextSerial = 1;
+
+// Makes a tape the active one for the duration of a grad() call
+struct ActiveTape {
+    explicit ActiveTape(Tape* tape) { activeTape = tape; }
+    ~ActiveTape() { activeTape = nullptr; }
+};
+
+// Node of a value recorded on the active tape, else -1
+int liveNode(const RuntimeValue& value) {
+    if (!value.isTapeValue() || !activeTape) return -1;
+    TapeValue* tracked = value.asTapeValue();
+    return tracked->tape == activeTape->serial ? static_cast<int>(tracked->node) : -1;
+}
+
+// Operands are kept as numbers or tensors so gradients can take their shape
+RuntimeValue numeric(const RuntimeValue& value) {
+    if (value.isArray()) {
+        if (Ref<TrollTensor> tensor = toTensor(value)) return RuntimeValue(tensor);
+    }
+    return value;
+}
+
+RuntimeValue push(Node node) {
+    size_t index = activeTape->nodes.size();
+    RuntimeValue value = node.value;
+    activeTape->nodes.push_back(std::move(node));
+    return RuntimeValue(makeRef<TapeValue>(std::move(value), activeTape->serial, index));
+}
+
+// Gradient arithmetic goes through the script operators
+const Token& token(TokenType type) {
+    static const Token plus(TokenType::PLUS, "+", std::monostate{}, 0);
+    static const Token minus(TokenType::MINUS, "-", std::monostate{}, 0);
+    static const Token star(TokenType::STAR, "*", std::monostate{}, 0);
+    static const Token slash(TokenType::SLASH, "/", std::monostate{}, 0);
+    static const Token at(TokenType::AT, "@", std::monostate{}, 0);
+    switch (type) {
+        case TokenType::PLUS: return plus;
+        case TokenType::MINUS: return minus;
+        case TokenType::STAR: return star;
+        case TokenType::SLASH: return slash;
+        default: return at;
+    }
+}
+
+RuntimeValue apply(TokenType type, const RuntimeValue& left, const RuntimeValue& right) {
+    return binaryOp(token(type), left, right);
+}
+
+RuntimeValue zerosLike(const RuntimeValue& value) {
+    if (value.isTensor()) return RuntimeValue(makeRef<TrollTensor>(value.asTensor()->shape, value.asTensor()->dtype()));
+    return RuntimeValue(0.0);
+}
+
+RuntimeValue onesLike(const RuntimeValue& value) {
+    return apply(TokenType::PLUS, zerosLike(value), RuntimeValue(1.0));
+}
+
+// The gradient of a broadcast operand: g summed back down to its shape
+RuntimeValue reduceTo(const RuntimeValue& gradient, const RuntimeValue& operand) {
+    if (!gradient.isTensor()) {
+        return operand.isTensor() ? apply(TokenType::PLUS, zerosLike(operand), gradient) : gradient;
+    }
+    TrollTensor* g = gradient.asTensor();
+    if (!operand.isTensor()) return RuntimeValue(sumTo(*g, {})->get(0));
+    const std::vector<size_t>& shape = operand.asTensor()->shape;
+    if (g->shape == shape) return gradient;
+    return RuntimeValue(sumTo(*g, shape));
+}
+
+// Vectors as the row (left) or column (right) matrices `@` treats them as
+Ref<TrollTensor> asMatrix(TrollTensor* tensor, bool left) {
+    if (tensor->rank() == 2) return Ref<TrollTensor>(tensor);
+    size_t k = tensor->shape[0];
+    return tensor->reshape(left ? std::vector<size_t>{1, k} : std::vector<size_t>{k, 1});
+}
+
+// A matmul operand as a matrix or a batch of them; sparse operands are
+// matrices already
+RuntimeValue matrixOperand(const RuntimeValue& value, bool left) {
+    if (value.isSparse() || value.asTensor()->rank() >= 2) return value;
+    return RuntimeValue(asMatrix(value.asTensor(), left));
+}
+
+// Rows (fromEnd 2) or columns (fromEnd 1) of a matrix operand
+size_t matrixExtent(const RuntimeValue& matrix, size_t fromEnd) {
+    if (matrix.isSparse()) return fromEnd == 2 ? matrix.asSparse()->rows : matrix.asSparse()->cols;
+    const std::vector<size_t>& shape = matrix.asTensor()->shape;
+    return shape[shape.size() - fromEnd];
+}
+
+bool isBatch(const RuntimeValue& matrix) {
+    return matrix.isTensor() && matrix.asTensor()->rank() == 3;
+}
+
+// Every matrix of the operand transposed
+RuntimeValue transposed(const RuntimeValue& matrix) {
+    if (matrix.isSparse()) return RuntimeValue(matrix.asSparse()->transpose());
+    TrollTensor* tensor = matrix.asTensor();
+    if (tensor->rank() == 2) return RuntimeValue(tensor->transpose());
+    std::vector<size_t> shape{tensor->shape[0], tensor->shape[2], tensor->shape[1]};
+    std::vector<ptrdiff_t> strides{tensor->strides[0], tensor->strides[2], tensor->strides[1]};
+    return RuntimeValue(makeRef<TrollTensor>(tensor->buffer, tensor->offset, std::move(shape), std::move(strides)));
+}
+
+// The gradient of a matmul operand, summed over the samples it was
+// broadcast across
+RuntimeValue operandGradient(const RuntimeValue& product, const RuntimeValue& matrix, const RuntimeValue& operand) {
+    Ref<TrollTensor> d(product.asTensor());
+    const std::vector<size_t>& shape = matrix.asTensor()->shape;
+    if (d->shape != shape) d = sumTo(*d, shape);
+    return RuntimeValue(d->reshape(operand.asTensor()->shape));
+}
+
+// Sparse operands are never grad() arguments, so only dense ones get a
+// gradient; the products with a sparse one stay sparse-dense
+void matmulGradients(const Node& node, const RuntimeValue& gradient, RuntimeValue& leftGradient,
+                     RuntimeValue& rightGradient) {
+    RuntimeValue a2 = matrixOperand(node.leftValue, true);
+    RuntimeValue b2 = matrixOperand(node.rightValue, false);
+    std::vector<size_t> outShape;
+    if (isBatch(a2) || isBatch(b2)) {
+        size_t leftBatch = isBatch(a2) ? a2.asTensor()->shape[0] : 1;
+        size_t rightBatch = isBatch(b2) ? b2.asTensor()->shape[0] : 1;
+        outShape.push_back(std::max(leftBatch, rightBatch));
+    }
+    outShape.push_back(matrixExtent(a2, 2));
+    outShape.push_back(matrixExtent(b2, 1));
+    Ref<TrollTensor> g2;
+    if (gradient.isTensor()) {
+        g2 = gradient.asTensor()->reshape(outShape);
+    } else {
+        g2 = makeRef<TrollTensor>(outShape);
+        *g2->data() = gradient.asNumber();
+    }
+    // dA = G B^T, dB = A^T G, per sample
+    if (node.left >= 0) {
+        RuntimeValue d = apply(TokenType::AT, RuntimeValue(g2), transposed(b2));
+        leftGradient = operandGradient(d, a2, node.leftValue);
+    }
+    if (node.right >= 0) {
+        RuntimeValue d = apply(TokenType::AT, transposed(a2), RuntimeValue(g2));
+        rightGradient = operandGradient(d, b2, node.rightValue);
+    }
+}
+
+RuntimeValue indexGradient(const Node& node, const RuntimeValue& gradient) {
+    TrollTensor* source = node.leftValue.asTensor();
+    auto result = makeRef<TrollTensor>(source->shape, source->dtype());
+    if (source->rank() == 1) {
+        result->set(node.index, gradient.asNumber());
+    } else {
+        Ref<TrollTensor> row = result->row(node.index);
+        row->copyFrom(*gradient.asTensor());
+    }
+    return RuntimeValue(result);
+}
+
+// g in the rows a Slice took, zero elsewhere
+RuntimeValue sliceGradient(const Node& node, const RuntimeValue& gradient) {
+    TrollTensor* source = node.leftValue.asTensor();
+    auto result = makeRef<TrollTensor>(source->shape, source->dtype());
+    Ref<TrollTensor> g = toTensor(gradient);
+    result->slice(node.index, node.index + g->shape[0])->copyFrom(*g);
+    return RuntimeValue(result);
+}
+
+// A reduction's gradient or result laid over its operand's shape: a
+// number for a full reduction, otherwise with the axis put back as 1
+RuntimeValue spread(const Node& node, const RuntimeValue& value) {
+    if (node.index == ALL_AXES) return value;
+    std::vector<size_t> shape = node.leftValue.asTensor()->shape;
+    shape[node.index] = 1;
+    return RuntimeValue(toTensor(value)->reshape(std::move(shape)));
+}
+
+// g at the maxima a Max took, zero elsewhere
+RuntimeValue maxGradient(const Node& node, const RuntimeValue& gradient) {
+    TrollTensor* source = node.leftValue.asTensor();
+    auto mask = makeRef<TrollTensor>(source->shape, source->dtype());
+    if (node.index == ALL_AXES) {
+        mask->set(static_cast<ptrdiff_t>(reduceAll(Reduction::ArgMax, *source)), 1.0);
+    } else {
+        Ref<TrollTensor> positions = reduceAxis(Reduction::ArgMax, *source, node.index);
+        size_t extent = source->shape[node.index];
+        size_t inner = 1;
+        for (size_t d = node.index + 1; d < source->rank(); ++d) inner *= source->shape[d];
+        for (size_t i = 0; i < positions->size(); ++i) {
+            size_t outer = i / inner;
+            size_t k = static_cast<size_t>(positions->data()[i]);
+            mask->set(static_cast<ptrdiff_t>((outer * extent + k) * inner + i % inner), 1.0);
+        }
+    }
+    return apply(TokenType::STAR, RuntimeValue(mask), spread(node, gradient));
+}
+
+// A tensor operand of conv2d() or pooling
+Ref<TrollTensor> imageOperand(const RuntimeValue& value, const char* function, const char* what) {
+    Ref<TrollTensor> tensor = toTensor(value);
+    if (!tensor || tensor->rank() != 4) {
+        throw NativeError(std::string(function) + "() expects " + what + " of rank 4.");
+    }
+    return tensor;
+}
+
+Conv2dShape convolutionShape(const TrollTensor& input, const TrollTensor& kernel, size_t stride, size_t padding) {
+    return Conv2dShape{input.shape[0], input.shape[1], input.shape[2], input.shape[3], kernel.shape[0],
+                       kernel.shape[2], kernel.shape[3], stride, padding};
+}
+
+Conv2dShape poolingShape(const TrollTensor& input, size_t size, size_t stride) {
+    return Conv2dShape{input.shape[0], input.shape[1], input.shape[2], input.shape[3], input.shape[1],
+                       size, size, stride, 0};
+}
+
+// The gradient of a node's result as a contiguous tensor of its dtype
+Ref<TrollTensor> resultGradient(const Node& node, const RuntimeValue& gradient) {
+    return toTensor(gradient)->astype(node.value.asTensor()->dtype())->contiguous();
+}
+
+void convolutionGradients(const Node& node, const RuntimeValue& gradient, RuntimeValue& inputGradient,
+                          RuntimeValue& kernelGradient) {
+    TrollTensor* input = node.leftValue.asTensor();
+    TrollTensor* kernel = node.rightValue.asTensor();
+    Ref<TrollTensor> g = resultGradient(node, gradient);
+    Ref<TrollTensor> dInput = node.left >= 0 ? makeRef<TrollTensor>(input->shape, input->dtype()) : nullptr;
+    Ref<TrollTensor> dKernel = node.right >= 0 ? makeRef<TrollTensor>(kernel->shape, kernel->dtype()) : nullptr;
+    Conv2dShape shape = convolutionShape(*input, *kernel, node.stride, node.padding);
+    dispatchDType(input->dtype(), [&](auto type) {
+        using T = decltype(type);
+        conv2dBackward(shape, input->elements<T>(), kernel->elements<T>(), g->elements<T>(),
+                       dInput ? dInput->elements<T>() : nullptr, dKernel ? dKernel->elements<T>() : nullptr);
+    });
+    if (dInput) inputGradient = RuntimeValue(dInput);
+    if (dKernel) kernelGradient = RuntimeValue(dKernel);
+}
+
+RuntimeValue poolingGradient(const Node& node, Pooling pooling, const RuntimeValue& gradient) {
+    TrollTensor* input = node.leftValue.asTensor();
+    Ref<TrollTensor> g = resultGradient(node, gradient);
+    auto result = makeRef<TrollTensor>(input->shape, input->dtype());
+    Conv2dShape shape = poolingShape(*input, node.index, node.stride);
+    dispatchDType(input->dtype(), [&](auto type) {
+        using T = decltype(type);
+        pool2dBackward(pooling, shape, input->elements<T>(), g->elements<T>(), result->elements<T>());
+    });
+    return RuntimeValue(result);
+}
+
+// Gradients of the output node with respect to every node, nil for zero
+std::vector<RuntimeValue> backward(const Tape& tape, int output) {
+    std::vector<RuntimeValue> gradients(tape.nodes.size());
+    gradients[output] = onesLike(tape.nodes[output].value);
+
+    auto accumulate = [&](int node, RuntimeValue gradient) {
+        if (node < 0) return;
+        if (gradients[node].isNil()) {
+            gradients[node] = std::move(gradient);
+        } else {
+            gradients[node] = apply(TokenType::PLUS, gradients[node], gradient);
+        }
+    };
+
+    for (int i = output; i >= 0; --i) {
+        if (gradients[i].isNil()) continue;
+        const Node& node = tape.nodes[i];
+        RuntimeValue g = gradients[i];
+        const RuntimeValue& a = node.leftValue;
+        const RuntimeValue& b = node.rightValue;
+        switch (node.op) {
+            case TapeOp::Leaf:
+                break;
+            case TapeOp::Add:
+                if (node.left >= 0) accumulate(node.left, reduceTo(g, a));
+                if (node.right >= 0) accumulate(node.right, reduceTo(g, b));
+                break;
+            case TapeOp::Subtract:
+                if (node.left >= 0) accumulate(node.left, reduceTo(g, a));
+                if (node.right >= 0) accumulate(node.right, reduceTo(apply(TokenType::STAR, g, RuntimeValue(-1.0)), b));
+                break;
+            case TapeOp::Multiply:
+                if (node.left >= 0) accumulate(node.left, reduceTo(apply(TokenType::STAR, g, b), a));
+                if (node.right >= 0) accumulate(node.right, reduceTo(apply(TokenType::STAR, g, a), b));
+                break;
+            case TapeOp::Divide:
+                // d(a/b) = da / b - db * a / b^2
+                if (node.left >= 0) accumulate(node.left, reduceTo(apply(TokenType::SLASH, g, b), a));
+                if (node.right >= 0) {
+                    RuntimeValue quotient = apply(TokenType::SLASH, node.value, b);
+                    accumulate(node.right, reduceTo(apply(TokenType::STAR, g, apply(TokenType::STAR, quotient, RuntimeValue(-1.0))), b));
+                }
+                break;
+            case TapeOp::Negate:
+                accumulate(node.left, apply(TokenType::STAR, g, RuntimeValue(-1.0)));
+                break;
+            case TapeOp::MatMul: {
+                RuntimeValue leftGradient, rightGradient;
+                matmulGradients(node, g, leftGradient, rightGradient);
+                accumulate(node.left, std::move(leftGradient));
+                accumulate(node.right, std::move(rightGradient));
+                break;
+            }
+            case TapeOp::Index:
+                accumulate(node.left, indexGradient(node, g));
+                break;
+            case TapeOp::Slice:
+                accumulate(node.left, sliceGradient(node, g));
+                break;
+            case TapeOp::Transpose:
+                accumulate(node.left, g.isTensor() ? RuntimeValue(g.asTensor()->transpose()) : g);
+                break;
+            case TapeOp::Reshape:
+                accumulate(node.left, RuntimeValue(toTensor(g)->reshape(a.asTensor()->shape)));
+                break;
+            case TapeOp::Sum:
+                accumulate(node.left, apply(TokenType::PLUS, zerosLike(a), spread(node, g)));
+                break;
+            case TapeOp::Mean: {
+                TrollTensor* source = a.asTensor();
+                size_t count = node.index == ALL_AXES ? source->size() : source->shape[node.index];
+                RuntimeValue share = apply(TokenType::SLASH, spread(node, g), RuntimeValue(static_cast<double>(count)));
+                accumulate(node.left, apply(TokenType::PLUS, zerosLike(a), share));
+                break;
+            }
+            case TapeOp::Max:
+                accumulate(node.left, maxGradient(node, g));
+                break;
+            case TapeOp::Norm:
+                // x / |x|
+                accumulate(node.left, apply(TokenType::STAR, a, apply(TokenType::SLASH, spread(node, g), spread(node, node.value))));
+                break;
+            case TapeOp::Conv2d: {
+                RuntimeValue inputGradient, kernelGradient;
+                convolutionGradients(node, g, inputGradient, kernelGradient);
+                accumulate(node.left, std::move(inputGradient));
+                accumulate(node.right, std::move(kernelGradient));
+                break;
+            }
+            case TapeOp::MaxPool:
+                accumulate(node.left, poolingGradient(node, Pooling::Max, g));
+                break;
+            case TapeOp::AvgPool:
+                accumulate(node.left, poolingGradient(node, Pooling::Average, g));
+                break;
+            case TapeOp::Exp:
+                accumulate(node.left, apply(TokenType::STAR, g, node.value));
+                break;
+            case TapeOp::Log:
+                accumulate(node.left, apply(TokenType::SLASH, g, a));
+                break;
+            case TapeOp::Relu:
+                accumulate(node.left, apply(TokenType::STAR, g, applyFunction(ElementFunction::Step, a)));
+                break;
+            case TapeOp::Tanh: {
+                // 1 - tanh^2
+                RuntimeValue square = apply(TokenType::STAR, node.value, node.value);
+                accumulate(node.left, apply(TokenType::STAR, g, apply(TokenType::MINUS, RuntimeValue(1.0), square)));
+                break;
+            }
+        }
+    }
+    return gradients;
+}
+
+} // namespace
+
+RuntimeValue untracked(const RuntimeValue& value) {
+    return value.isTapeValue() ? value.asTapeValue()->value : value;
+}
+
+bool isTracked(const RuntimeValue& value) {
+    return liveNode(value) >= 0;
+}
+
+RuntimeValue recordBinary(const Token& op, const RuntimeValue& left, const RuntimeValue& right) {
+    int l = liveNode(left);
+    int r = liveNode(right);
+    RuntimeValue a = untracked(left);
+    RuntimeValue b = untracked(right);
+    RuntimeValue result = binaryOp(op, a, b);
+    if (l < 0 && r < 0) return result;
+
+    TapeOp kind;
+    switch (op.type) {
+        case TokenType::PLUS: kind = TapeOp::Add; break;
+        case TokenType::MINUS: kind = TapeOp::Subtract; break;
+        case TokenType::STAR: kind = TapeOp::Multiply; break;
+        case TokenType::SLASH: kind = TapeOp::Divide; break;
+        case TokenType::AT: kind = TapeOp::MatMul; break;
+        case TokenType::GREATER:
+        case TokenType::GREATER_EQUAL:
+        case TokenType::LESS:
+        case TokenType::LESS_EQUAL:
+        case TokenType::EQUAL_EQUAL:
+        case TokenType::BANG_EQUAL:
+            return result; // Comparisons have no gradient
+        default:
+            throw RuntimeError(op, "grad() cannot differentiate '" + op.lexeme + "'.");
+    }
+    Node node{kind, l, r, numeric(a), numeric(b), result};
+    return push(std::move(node));
+}
+
+RuntimeValue recordUnary(const Token& op, const RuntimeValue& right) {
+    int r = liveNode(right);
+    RuntimeValue result = unaryOp(op, untracked(right));
+    if (r < 0 || op.type != TokenType::MINUS) return result;
+    return push(Node{TapeOp::Negate, r, -1, RuntimeValue(), RuntimeValue(), result});
+}
+
+RuntimeValue recordIndex(const Token& bracket, const RuntimeValue& object, const RuntimeValue& index) {
+    int l = liveNode(object);
+    RuntimeValue source = untracked(object);
+    RuntimeValue i = untracked(index);
+    RuntimeValue result = indexGet(bracket, source, i);
+    if (l < 0) return result;
+    Node node{TapeOp::Index, l, -1, source, RuntimeValue(), result};
+    node.index = static_cast<size_t>(i.asNumber());
+    return push(std::move(node));
+}
+
+RuntimeValue recordSlice(const Token& bracket, const RuntimeValue& object, const RuntimeValue& start,
+                         const RuntimeValue& end) {
+    int l = liveNode(object);
+    RuntimeValue source = untracked(object);
+    RuntimeValue from = untracked(start);
+    RuntimeValue result = sliceGet(bracket, source, from, untracked(end));
+    if (l < 0 || !source.isTensor()) return result;
+    Node node{TapeOp::Slice, l, -1, source, RuntimeValue(), result};
+    node.index = from.isNil() ? 0 : static_cast<size_t>(from.asNumber());
+    return push(std::move(node));
+}
+
+RuntimeValue recordProperty(const Token& name, const RuntimeValue& object) {
+    int l = liveNode(object);
+    RuntimeValue result = propertyGet(name, untracked(object));
+    if (l < 0) return result;
+    return push(Node{TapeOp::Transpose, l, -1, RuntimeValue(), RuntimeValue(), result});
+}
+
+RuntimeValue applyReshape(const RuntimeValue& x, std::vector<size_t> shape) {
+    RuntimeValue value = untracked(x);
+    Ref<TrollTensor> tensor = toTensor(value);
+    if (!tensor) {
+        throw NativeError("reshape() expects a tensor or a numeric array.");
+    }
+    size_t count = 1;
+    for (size_t extent : shape) count *= extent;
+    if (count != tensor->size()) {
+        throw NativeError("reshape() cannot change the number of elements.");
+    }
+    RuntimeValue result(tensor->reshape(std::move(shape)));
+    int node = liveNode(x);
+    if (node < 0) return result;
+    return push(Node{TapeOp::Reshape, node, -1, RuntimeValue(tensor), RuntimeValue(), result});
+}
+
+RuntimeValue applyReduction(Reduction reduction, const RuntimeValue& x, const RuntimeValue& axis) {
+    RuntimeValue value = untracked(x);
+    Ref<TrollTensor> tensor = toTensor(value);
+    if (!tensor && value.isArray() && value.asArray()->elements.empty()) {
+        tensor = makeRef<TrollTensor>(std::vector<size_t>{0}); // [] is as numeric as it gets
+    }
+    if (!tensor) {
+        throw NativeError("Argument must be a tensor or a numeric array.");
+    }
+    size_t dimension = ALL_AXES;
+    if (!axis.isNil()) {
+        double rank = static_cast<double>(tensor->rank());
+        double index = axis.isNumber() ? axis.asNumber() : rank;
+        if (index < 0) index += rank;
+        if (index != std::floor(index) || index < 0 || index >= rank) {
+            throw NativeError("Axis must be an integer in range for the argument's rank.");
+        }
+        // Along the only axis is the same as over everything
+        if (tensor->rank() > 1) dimension = static_cast<size_t>(index);
+    }
+    size_t count = dimension == ALL_AXES ? tensor->size() : tensor->shape[dimension];
+    // Sums and norms of nothing are 0; a mean or maximum has no such value
+    if (count == 0 && reduction != Reduction::Sum && reduction != Reduction::Norm) {
+        throw NativeError(std::string("Cannot take the ") + (reduction == Reduction::Mean ? "mean" : "maximum") +
+                          " of no elements.");
+    }
+
+    RuntimeValue result = dimension == ALL_AXES ? RuntimeValue(reduceAll(reduction, *tensor))
+                                                : RuntimeValue(reduceAxis(reduction, *tensor, dimension));
+    int node = liveNode(x);
+    if (node < 0) return result;
+    TapeOp kind;
+    switch (reduction) {
+        case Reduction::Sum: kind = TapeOp::Sum; break;
+        case Reduction::Mean: kind = TapeOp::Mean; break;
+        case Reduction::Max: kind = TapeOp::Max; break;
+        case Reduction::Norm: kind = TapeOp::Norm; break;
+        default: return result; // Indices have no gradient
+    }
+    Node reduced{kind, node, -1, RuntimeValue(tensor), RuntimeValue(), result};
+    reduced.index = dimension;
+    return push(std::move(reduced));
+}
+
+RuntimeValue applyConv2d(const RuntimeValue& input, const RuntimeValue& kernel, size_t stride, size_t padding) {
+    Ref<TrollTensor> x = imageOperand(untracked(input), "conv2d", "an (N, C, H, W) input");
+    Ref<TrollTensor> w = imageOperand(untracked(kernel), "conv2d", "an (F, C, KH, KW) kernel");
+    if (w->shape[1] != x->shape[1]) {
+        throw NativeError("conv2d() kernel channels do not match the input's.");
+    }
+    if (x->shape[2] + 2 * padding < w->shape[2] || x->shape[3] + 2 * padding < w->shape[3]) {
+        throw NativeError("conv2d() kernel is larger than the padded input.");
+    }
+    DType dtype = promoteTypes(x->dtype(), w->dtype());
+    x = x->astype(dtype)->contiguous();
+    w = w->astype(dtype)->contiguous();
+    Conv2dShape shape = convolutionShape(*x, *w, stride, padding);
+    auto out = makeRef<TrollTensor>(std::vector<size_t>{shape.batch, shape.filters, shape.outHeight(), shape.outWidth()},
+                                    dtype);
+    dispatchDType(dtype, [&](auto type) {
+        using T = decltype(type);
+        conv2d(shape, x->elements<T>(), w->elements<T>(), out->elements<T>());
+    });
+
+    RuntimeValue result(out);
+    int l = liveNode(input);
+    int r = liveNode(kernel);
+    if (l < 0 && r < 0) return result;
+    Node node{TapeOp::Conv2d, l, r, RuntimeValue(x), RuntimeValue(w), result};
+    node.stride = stride;
+    node.padding = padding;
+    return push(std::move(node));
+}
+
+RuntimeValue applyPool2d(Pooling pooling, const RuntimeValue& input, size_t size, size_t stride) {
+    const char* name = pooling == Pooling::Max ? "maxpool2d" : "avgpool2d";
+    Ref<TrollTensor> x = imageOperand(untracked(input), name, "an (N, C, H, W) input");
+    if (x->shape[2] < size || x->shape[3] < size) {
+        throw NativeError(std::string(name) + "() window is larger than the input.");
+    }
+    x = x->contiguous();
+    Conv2dShape shape = poolingShape(*x, size, stride);
+    auto out = makeRef<TrollTensor>(std::vector<size_t>{shape.batch, shape.channels, shape.outHeight(), shape.outWidth()},
+                                    x->dtype());
+    dispatchDType(x->dtype(), [&](auto type) {
+        using T = decltype(type);
+        pool2d(pooling, shape, x->elements<T>(), out->elements<T>());
+    });
+
+    RuntimeValue result(out);
+    int l = liveNode(input);
+    if (l < 0) return result;
+    Node node{pooling == Pooling::Max ? TapeOp::MaxPool : TapeOp::AvgPool, l, -1, RuntimeValue(x), RuntimeValue(), result};
+    node.index = size;
+    node.stride = stride;
+    return push(std::move(node));
+}
+
+RuntimeValue applyFunction(ElementFunction function, const RuntimeValue& x) {
+    RuntimeValue value = untracked(x);
+    RuntimeValue result;
+    if (value.isNumber()) {
+        result = RuntimeValue(apply(function, value.asNumber()));
+    } else if (Ref<TrollTensor> tensor = toTensor(value)) {
+        if (lazyTensors() && tensor->dtype() == DType::F64) {
+            result = RuntimeValue(lazyTensor(LazyExpr::map(function, lazyOperand(*tensor))));
+        } else {
+            auto out = makeRef<TrollTensor>(tensor->shape, tensor->dtype());
+            map(function, *tensor, *out);
+            result = RuntimeValue(out);
+        }
+    } else {
+        throw NativeError("Argument must be a number or a numeric array.");
+    }
+
+    int node = liveNode(x);
+    if (node < 0) return result;
+    TapeOp kind;
+    switch (function) {
+        case ElementFunction::Exp: kind = TapeOp::Exp; break;
+        case ElementFunction::Log: kind = TapeOp::Log; break;
+        case ElementFunction::Tanh: kind = TapeOp::Tanh; break;
+        case ElementFunction::Relu: kind = TapeOp::Relu; break;
+        default: return result; // Step is flat wherever it is differentiable
+    }
+    return push(Node{kind, node, -1, numeric(value), RuntimeValue(), result});
+}
+
+RuntimeValue GradFunction::call(Interpreter* interpreter, const std::vector<RuntimeValue>& arguments) {
+    if (activeTape) {
+        throw NativeError("grad() cannot be nested.");
+    }
+    Tape tape{nextSerial++, {}};
+    ActiveTape active(&tape);
+
+    // Numeric arguments become the leaves, in order
+    std::vector<RuntimeValue> inputs;
+    std::vector<int> leaves;
+    for (const auto& argument : arguments) {
+        RuntimeValue value = argument.isNumber() ? argument : numeric(untracked(argument));
+        if (!value.isNumber() && !value.isTensor()) {
+            leaves.push_back(-1);
+            inputs.push_back(argument);
+            continue;
+        }
+        leaves.push_back(static_cast<int>(tape.nodes.size()));
+        inputs.push_back(push(Node{TapeOp::Leaf, -1, -1, RuntimeValue(), RuntimeValue(), value}));
+    }
+
+    RuntimeValue output = function.asCallable()->call(interpreter, inputs);
+    int outputNode = liveNode(output);
+    std::vector<RuntimeValue> gradients;
+    if (outputNode >= 0) gradients = backward(tape, outputNode);
+
+    std::vector<RuntimeValue> results;
+    for (int leaf : leaves) {
+        if (leaf < 0) {
+            results.emplace_back();
+        } else if (outputNode >= 0 && !gradients[leaf].isNil()) {
+            results.push_back(gradients[leaf]);
+        } else {
+            results.push_back(zerosLike(tape.nodes[leaf].value));
+        }
+    }
+    if (results.size() == 1) return results[0];
+    return RuntimeValue(makeRef<TrollArray>(std::move(results)));
+}
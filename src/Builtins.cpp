@@ -0,0 +1,305 @@
+#include "../include/Builtins.h"
+#include "../include/Autodiff.h"
+#include "../include/Checkpoint.h"
+#include "../include/NativeFunction.h"
+#include "../include/NumpyFile.h"
+#include "../include/SparseTensor.h"
+#include "../include/TensorAllocator.h"
+#include "../include/TrollArray.h"
+#include "../include/TrollModel.h"
+#include <cmath>
+#include <cstdint>
+#include <new>
+
+static RuntimeValue native(std::string name, int arity, NativeFunction::Body body, int optional = 0) {
+    return RuntimeValue(makeRef<NativeFunction>(std::move(name), arity, std::move(body), optional));
+}
+
+static RuntimeValue elementFunction(std::string name, ElementFunction function) {
+    return native(std::move(name), 1, [function](Interpreter*, const std::vector<RuntimeValue>& arguments) {
+        return applyFunction(function, arguments[0]);
+    });
+}
+
+// f(x) or f(x, axis): over every element, or along one axis
+static RuntimeValue reductionFunction(std::string name, Reduction reduction) {
+    return native(std::move(name), 2, [reduction](Interpreter*, const std::vector<RuntimeValue>& arguments) {
+        return applyReduction(reduction, arguments[0], arguments.size() > 1 ? arguments[1] : RuntimeValue());
+    }, 1);
+}
+
+static size_t sizeArgument(const RuntimeValue& value, const char* function) {
+    double size = value.isNumber() ? value.asNumber() : -1.0;
+    if (size < 0 || size != std::floor(size)) {
+        throw NativeError(std::string(function) + "() expects a shape: a size or an array of sizes.");
+    }
+    if (size >= 0x1p64) throw NativeError(std::string(function) + "() shape is too large.");
+    return static_cast<size_t>(size);
+}
+
+// Elements of a tensor of the given shape, checked to fit in size_t as
+// bytes of the widest dtype
+static size_t elementCount(const std::vector<size_t>& shape, const char* function) {
+    size_t elements = 1;
+    for (size_t extent : shape) {
+        if (extent != 0 && elements > SIZE_MAX / sizeof(double) / extent) {
+            throw NativeError(std::string(function) + "() shape is too large.");
+        }
+        elements *= extent;
+    }
+    return elements;
+}
+
+static std::vector<size_t> shapeArgument(const RuntimeValue& value, const char* function) {
+    if (!value.isArray()) return {sizeArgument(value, function)};
+    std::vector<size_t> shape;
+    for (const RuntimeValue& extent : value.asArray()->elements) {
+        shape.push_back(sizeArgument(extent, function));
+    }
+    return shape;
+}
+
+// A shape for x's elements, where one extent may be -1: as many as the
+// others leave
+static std::vector<size_t> reshapeArgument(const RuntimeValue& x, const RuntimeValue& value) {
+    Ref<TrollTensor> tensor = toTensor(untracked(x));
+    if (!tensor) {
+        throw NativeError("reshape() expects a tensor or a numeric array.");
+    }
+    std::vector<RuntimeValue> extents = value.isArray() ? value.asArray()->elements : std::vector<RuntimeValue>{value};
+    std::vector<size_t> shape;
+    int inferred = -1;
+    for (const RuntimeValue& extent : extents) {
+        if (extent.isNumber() && extent.asNumber() == -1 && inferred < 0) {
+            inferred = static_cast<int>(shape.size());
+            shape.push_back(1);
+            continue;
+        }
+        shape.push_back(sizeArgument(extent, "reshape"));
+    }
+    size_t known = elementCount(shape, "reshape");
+    if (inferred >= 0 && known > 0) shape[inferred] = tensor->size() / known;
+    return shape;
+}
+
+// A whole number of at least `least`, for the parameter `what` of `function`
+static size_t countArgument(const RuntimeValue& value, const char* function, const char* what, size_t least) {
+    double count = value.isNumber() ? value.asNumber() : -1.0;
+    if (count < static_cast<double>(least) || count != std::floor(count)) {
+        throw NativeError(std::string(function) + "() expects a whole " + what + " of at least " +
+                          std::to_string(least) + ".");
+    }
+    return static_cast<size_t>(count);
+}
+
+// f(input, size, stride) over size x size windows, `stride` apart (size
+// by default)
+static RuntimeValue poolingFunction(std::string name, Pooling pooling) {
+    return native(name, 3, [name, pooling](Interpreter*, const std::vector<RuntimeValue>& arguments) {
+        size_t size = countArgument(arguments[1], name.c_str(), "window size", 1);
+        size_t stride = arguments.size() > 2 ? countArgument(arguments[2], name.c_str(), "stride", 1) : size;
+        return applyPool2d(pooling, arguments[0], size, stride);
+    }, 1);
+}
+
+// The elements of a flat numeric array or 1-D tensor, for `function`
+static std::vector<double> numbersArgument(const RuntimeValue& value, const char* function) {
+    RuntimeValue numbers = untracked(value);
+    if (numbers.isArray() && numbers.asArray()->elements.empty()) return {};
+    Ref<TrollTensor> tensor = toTensor(numbers);
+    if (!tensor || tensor->rank() != 1) {
+        throw NativeError(std::string(function) + "() expects flat arrays of row indices, column indices and values.");
+    }
+    std::vector<double> elements(tensor->size());
+    tensor->copyTo(elements.data());
+    return elements;
+}
+
+// Whole numbers below `extent`
+static std::vector<size_t> indicesArgument(const RuntimeValue& value, size_t extent, const char* function) {
+    std::vector<size_t> indices;
+    for (double index : numbersArgument(value, function)) {
+        if (index < 0 || index >= static_cast<double>(extent) || index != std::floor(index)) {
+            throw NativeError(std::string(function) + "() index out of bounds.");
+        }
+        indices.push_back(static_cast<size_t>(index));
+    }
+    return indices;
+}
+
+// sparse(rows, cols, values, shape) from coordinate triplets, or sparse(x)
+// from the nonzeros of a dense matrix
+static RuntimeValue sparseFromArguments(const std::vector<RuntimeValue>& arguments) {
+    if (arguments.size() == 1) {
+        Ref<TrollTensor> matrix = toTensor(untracked(arguments[0]));
+        if (!matrix || matrix->rank() != 2) {
+            throw NativeError("sparse() expects a matrix, or row indices, column indices, values and a shape.");
+        }
+        if (matrix->shape[0] > SparseTensor::MAX_EXTENT || matrix->shape[1] > SparseTensor::MAX_EXTENT) {
+            throw NativeError("sparse() matrix is too large.");
+        }
+        return RuntimeValue(SparseTensor::fromDense(*matrix));
+    }
+    if (arguments.size() < 4) {
+        throw NativeError("sparse() expects a matrix, or row indices, column indices, values and a shape.");
+    }
+    std::vector<size_t> shape = shapeArgument(arguments[3], "sparse");
+    if (shape.size() != 2) {
+        throw NativeError("sparse() expects a shape of two sizes.");
+    }
+    if (shape[0] > SparseTensor::MAX_EXTENT || shape[1] > SparseTensor::MAX_EXTENT) {
+        throw NativeError("sparse() matrix is too large.");
+    }
+    std::vector<size_t> rows = indicesArgument(arguments[0], shape[0], "sparse");
+    std::vector<size_t> cols = indicesArgument(arguments[1], shape[1], "sparse");
+    std::vector<double> values = numbersArgument(arguments[2], "sparse");
+    if (rows.size() != values.size() || cols.size() != values.size()) {
+        throw NativeError("sparse() expects as many row and column indices as values.");
+    }
+    return RuntimeValue(SparseTensor::fromTriplets(shape[0], shape[1], rows, cols, values));
+}
+
+static std::string pathArgument(const RuntimeValue& value, const char* function) {
+    if (!value.isString()) {
+        throw NativeError(std::string(function) + "() expects a path string.");
+    }
+    return value.asString();
+}
+
+static DType dtypeArgument(const RuntimeValue& value) {
+    DType dtype;
+    if (!value.isString() || !parseDType(value.asString(), dtype)) {
+        throw NativeError("Expected a dtype: \"f64\", \"f32\" or \"bf16\".");
+    }
+    return dtype;
+}
+
+std::vector<std::pair<std::string, RuntimeValue>> builtins() {
+    std::vector<std::pair<std::string, RuntimeValue>> functions;
+
+    functions.emplace_back("grad", native("grad", 1, [](Interpreter*, const std::vector<RuntimeValue>& arguments) {
+        if (!arguments[0].isCallable()) {
+            throw NativeError("grad() expects a function.");
+        }
+        return RuntimeValue(makeRef<GradFunction>(arguments[0]));
+    }));
+    functions.emplace_back("exp", elementFunction("exp", ElementFunction::Exp));
+    functions.emplace_back("log", elementFunction("log", ElementFunction::Log));
+    functions.emplace_back("tanh", elementFunction("tanh", ElementFunction::Tanh));
+    functions.emplace_back("relu", elementFunction("relu", ElementFunction::Relu));
+
+    // Reductions of a tensor or numeric array; see applyReduction
+    functions.emplace_back("sum", reductionFunction("sum", Reduction::Sum));
+    functions.emplace_back("mean", reductionFunction("mean", Reduction::Mean));
+    functions.emplace_back("max", reductionFunction("max", Reduction::Max));
+    functions.emplace_back("argmax", reductionFunction("argmax", Reduction::ArgMax));
+    functions.emplace_back("norm", reductionFunction("norm", Reduction::Norm));
+
+    // conv2d(input, kernel, stride, padding) on NCHW tensors; see Convolution.h
+    functions.emplace_back("conv2d", native("conv2d", 4, [](Interpreter*, const std::vector<RuntimeValue>& arguments) {
+        size_t stride = countArgument(arguments[2], "conv2d", "stride", 1);
+        size_t padding = countArgument(arguments[3], "conv2d", "padding", 0);
+        return applyConv2d(arguments[0], arguments[1], stride, padding);
+    }));
+    functions.emplace_back("maxpool2d", poolingFunction("maxpool2d", Pooling::Max));
+    functions.emplace_back("avgpool2d", poolingFunction("avgpool2d", Pooling::Average));
+
+    // Sparse matrices in CSR form; `@` with one runs a sparse kernel
+    functions.emplace_back("sparse", native("sparse", 4, [](Interpreter*, const std::vector<RuntimeValue>& arguments) {
+        return sparseFromArguments(arguments);
+    }, 3));
+    // The sparse matrix as a dense f64 tensor; dense values pass through
+    functions.emplace_back("dense", native("dense", 1, [](Interpreter*, const std::vector<RuntimeValue>& arguments) {
+        if (arguments[0].isSparse()) return RuntimeValue(arguments[0].asSparse()->toDense());
+        if (!toTensor(untracked(arguments[0]))) {
+            throw NativeError("dense() expects a sparse matrix or a numeric array.");
+        }
+        return arguments[0];
+    }));
+    functions.emplace_back("nnz", native("nnz", 1, [](Interpreter*, const std::vector<RuntimeValue>& arguments) {
+        if (!arguments[0].isSparse()) {
+            throw NativeError("nnz() expects a sparse matrix.");
+        }
+        return RuntimeValue(static_cast<double>(arguments[0].asSparse()->nonzeros()));
+    }));
+
+    // Materializes a deferred tensor (see Lazy.h); other values pass through
+    functions.emplace_back("eval", native("eval", 1, [](Interpreter*, const std::vector<RuntimeValue>& arguments) {
+        RuntimeValue value = untracked(arguments[0]);
+        if (value.isTensor()) value.asTensor()->data();
+        return arguments[0];
+    }));
+
+    // reshape(x, shape): a view of x's elements under another shape
+    functions.emplace_back("reshape", native("reshape", 2, [](Interpreter*, const std::vector<RuntimeValue>& arguments) {
+        return applyReshape(arguments[0], reshapeArgument(arguments[0], arguments[1]));
+    }));
+    // zeros(shape, dtype): a new tensor of the given shape (a size or an
+    // array of sizes) and dtype, f64 by default
+    functions.emplace_back("zeros", native("zeros", 2, [](Interpreter*, const std::vector<RuntimeValue>& arguments) {
+        std::vector<size_t> shape = shapeArgument(arguments[0], "zeros");
+        size_t elements = elementCount(shape, "zeros");
+        DType dtype = arguments.size() > 1 ? dtypeArgument(arguments[1]) : DType::F64;
+        try {
+            return RuntimeValue(makeRef<TrollTensor>(std::move(shape), dtype));
+        } catch (const std::bad_alloc&) {
+            throw NativeError("zeros() cannot allocate " + std::to_string(elements) + " elements.");
+        }
+    }, 1));
+    // The tensor in another dtype (itself if it has it already); not
+    // recorded by grad()
+    functions.emplace_back("astype", native("astype", 2, [](Interpreter*, const std::vector<RuntimeValue>& arguments) {
+        DType dtype = dtypeArgument(arguments[1]);
+        Ref<TrollTensor> tensor = toTensor(untracked(arguments[0]));
+        if (!tensor) {
+            throw NativeError("astype() expects a tensor or a numeric array.");
+        }
+        return RuntimeValue(tensor->astype(dtype));
+    }));
+    functions.emplace_back("dtype", native("dtype", 1, [](Interpreter*, const std::vector<RuntimeValue>& arguments) {
+        RuntimeValue value = untracked(arguments[0]);
+        if (value.isTensor()) return RuntimeValue(std::string(dtypeName(value.asTensor()->dtype())));
+        if (value.isNumber() || toTensor(value)) return RuntimeValue(std::string(dtypeName(DType::F64)));
+        throw NativeError("dtype() expects a number, tensor or numeric array.");
+    }));
+
+    // NumPy .npy files; a loaded tensor reads the mapped file and cannot be
+    // assigned into
+    functions.emplace_back("load_npy", native("load_npy", 1, [](Interpreter*, const std::vector<RuntimeValue>& arguments) {
+        return loadNpy(pathArgument(arguments[0], "load_npy"));
+    }));
+    functions.emplace_back("save_npy", native("save_npy", 2, [](Interpreter*, const std::vector<RuntimeValue>& arguments) {
+        Ref<TrollTensor> tensor = toTensor(untracked(arguments[0]));
+        if (!tensor) {
+            throw NativeError("save_npy() expects a tensor or a numeric array.");
+        }
+        saveNpy(*tensor, pathArgument(arguments[1], "save_npy"));
+        return RuntimeValue();
+    }));
+    functions.emplace_back("save", native("save", 2, [](Interpreter*, const std::vector<RuntimeValue>& arguments) {
+        if (!arguments[0].isInstance()) {
+            throw NativeError("save() expects a model instance.");
+        }
+        saveCheckpoint(*arguments[0].asInstance(), pathArgument(arguments[1], "save"));
+        return RuntimeValue();
+    }));
+    // A new instance of the model, built by its initializers, with the
+    // checkpoint's fields then put in place
+    functions.emplace_back("load", native("load", 2, [](Interpreter* interpreter, const std::vector<RuntimeValue>& arguments) {
+        auto* model = arguments[0].isCallable() ? dynamic_cast<TrollModel*>(arguments[0].asCallable()) : nullptr;
+        if (!model) {
+            throw NativeError("load() expects a model.");
+        }
+        std::string path = pathArgument(arguments[1], "load");
+        RuntimeValue instance = model->call(interpreter, {});
+        loadCheckpoint(*instance.asInstance(), path);
+        return instance;
+    }));
+
+    // Frees the tensor memory cached for reuse; the number of bytes freed
+    functions.emplace_back("release_memory", native("release_memory", 0, [](Interpreter*, const std::vector<RuntimeValue>&) {
+        return RuntimeValue(static_cast<double>(TensorAllocator::release()));
+    }));
+
+    return functions;
+}
@@ -0,0 +1,314 @@
+#include "../include/Checkpoint.h"
+#include "../include/Autodiff.h"
+#include "../include/MappedFile.h"
+#include "../include/NativeFunction.h"
+#include "../include/ThreadPool.h"
+#include "../include/TrollArray.h"
+#include "../include/TrollModel.h"
+#include "../include/TrollTensor.h"
+#include <algorithm>
+#include <cstdint>
+#include <unordered_set>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "Checkpoints are written in host order");
+
+namespace {
+
+const char MAGIC[] = "TROLLCKP";
+constexpr size_t MAGIC_LENGTH = 8;
+constexpr uint32_t VERSION = 1;
+constexpr size_t PAYLOAD_ALIGNMENT = 64;
+constexpr size_t COPY_GRAIN = size_t(1) << 22; // Bytes per parallel copy chunk
+
+enum class Kind : uint8_t {
+    Number,
+    Tensor,
+    Array, // Flat and numeric; restored as an array of numbers
+};
+
+struct Entry {
+    std::string name;
+    Kind kind;
+    double number = 0;
+    Ref<TrollTensor> tensor; // Contiguous elements of a tensor or array
+    uint64_t offset = 0;
+};
+
+// Field names of the instance in slot order, methods included
+std::vector<std::pair<int, std::string>> fieldNames(const TrollInstance& instance) {
+    std::vector<std::pair<int, std::string>> names;
+    for (const auto& field : instance.model->declaration->fieldSlots) {
+        names.emplace_back(field.second, field.first);
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+bool isNumericArray(const TrollArray& array) {
+    return std::all_of(array.elements.begin(), array.elements.end(),
+                       [](const RuntimeValue& element) { return untracked(element).isNumber(); });
+}
+
+void collect(const RuntimeValue& field, const std::string& name, std::vector<Entry>& entries,
+             std::unordered_set<Object*>& visited);
+
+void collectFields(TrollInstance& instance, const std::string& prefix, std::vector<Entry>& entries,
+                   std::unordered_set<Object*>& visited) {
+    if (!visited.insert(&instance).second) return;
+    for (const auto& field : fieldNames(instance)) {
+        collect(instance.fields[field.first], prefix + field.second, entries, visited);
+    }
+}
+
+void collect(const RuntimeValue& field, const std::string& name, std::vector<Entry>& entries,
+             std::unordered_set<Object*>& visited) {
+    RuntimeValue value = untracked(field);
+    if (value.isNumber()) {
+        entries.push_back(Entry{name, Kind::Number, value.asNumber(), {}, 0});
+    } else if (value.isTensor()) {
+        entries.push_back(Entry{name, Kind::Tensor, 0, value.asTensor()->contiguous(), 0});
+    } else if (value.isArray()) {
+        TrollArray* array = value.asArray();
+        if (!isNumericArray(*array)) {
+            if (!visited.insert(array).second) return;
+            for (size_t i = 0; i < array->elements.size(); ++i) {
+                collect(array->elements[i], name + "." + std::to_string(i), entries, visited);
+            }
+            return;
+        }
+        auto elements = makeRef<TrollTensor>(std::vector<size_t>{array->elements.size()});
+        for (size_t i = 0; i < array->elements.size(); ++i) {
+            elements->data()[i] = untracked(array->elements[i]).asNumber();
+        }
+        entries.push_back(Entry{name, Kind::Array, 0, std::move(elements), 0});
+    } else if (value.isInstance()) {
+        collectFields(*value.asInstance(), name + ".", entries, visited);
+    }
+}
+
+template <typename T>
+void append(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+size_t payloadBytes(const Entry& entry) {
+    return entry.tensor->size() * dtypeSize(entry.tensor->dtype());
+}
+
+size_t alignUp(size_t offset) {
+    return (offset + PAYLOAD_ALIGNMENT - 1) / PAYLOAD_ALIGNMENT * PAYLOAD_ALIGNMENT;
+}
+
+std::string encodeIndex(std::vector<Entry>& entries) {
+    std::string index(MAGIC, MAGIC_LENGTH);
+    append(index, VERSION);
+    append(index, static_cast<uint32_t>(entries.size()));
+    std::vector<size_t> offsetAt(entries.size()); // Where each payload offset goes
+    for (size_t e = 0; e < entries.size(); ++e) {
+        const Entry& entry = entries[e];
+        std::string record;
+        if (entry.name.size() > UINT16_MAX) {
+            throw NativeError("Cannot save field '" + entry.name.substr(0, 64) + "...': names are limited to " +
+                              std::to_string(UINT16_MAX) + " bytes.");
+        }
+        append(record, static_cast<uint16_t>(entry.name.size()));
+        record += entry.name;
+        append(record, entry.kind);
+        if (entry.kind == Kind::Number) {
+            append(record, DType::F64);
+            append(record, uint16_t(0));
+            append(record, entry.number);
+        } else {
+            append(record, entry.tensor->dtype());
+            append(record, static_cast<uint16_t>(entry.tensor->rank()));
+            for (size_t extent : entry.tensor->shape) append(record, static_cast<uint64_t>(extent));
+            offsetAt[e] = index.size() + sizeof(uint32_t) + record.size();
+            append(record, uint64_t(0));
+        }
+        append(index, static_cast<uint32_t>(record.size()));
+        index += record;
+    }
+    // The payloads follow the index, so their offsets are known only now
+    size_t payload = alignUp(index.size());
+    for (size_t e = 0; e < entries.size(); ++e) {
+        if (entries[e].kind == Kind::Number) continue;
+        entries[e].offset = payload;
+        std::memcpy(&index[offsetAt[e]], &entries[e].offset, sizeof(uint64_t));
+        payload = alignUp(payload + payloadBytes(entries[e]));
+    }
+    return index;
+}
+
+// Reads the index of a mapped checkpoint, bounds-checked
+class IndexReader {
+public:
+    IndexReader(const MappedFile& file, const std::string& path) : file(file), path(path) {}
+
+    template <typename T>
+    T read() {
+        need(sizeof(T));
+        T value;
+        std::memcpy(&value, file.data() + position, sizeof(T));
+        position += sizeof(T);
+        return value;
+    }
+
+    std::string readString(size_t length) {
+        need(length);
+        std::string text(file.data() + position, length);
+        position += length;
+        return text;
+    }
+
+    size_t at() const { return position; }
+    void seek(size_t to) { position = to; }
+
+    void need(size_t bytes) const {
+        if (bytes > file.size() - position) malformed("it ends inside its index");
+    }
+
+    [[noreturn]] void malformed(const std::string& problem) const {
+        throw NativeError("'" + path + "' is not a readable checkpoint: " + problem + ".");
+    }
+
+private:
+    const MappedFile& file;
+    const std::string& path;
+    size_t position = 0;
+};
+
+// The field or array element the dotted name leads to from `instance`
+RuntimeValue* locate(TrollInstance& instance, const std::string& name, const std::string& path) {
+    RuntimeValue* target = nullptr;
+    RuntimeValue container{Ref<TrollInstance>(&instance)};
+    size_t start = 0;
+    while (true) {
+        size_t end = name.find('.', start);
+        std::string segment = name.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        target = nullptr;
+        if (container.isInstance()) {
+            TrollInstance* holder = container.asInstance();
+            int slot = holder->shape->slotOf(segment);
+            if (slot >= 0) target = &holder->fields[slot];
+        } else if (container.isArray() && !segment.empty() && segment.size() < 19 &&
+                   segment.find_first_not_of("0123456789") == std::string::npos) {
+            TrollArray* holder = container.asArray();
+            size_t i = std::stoull(segment);
+            if (i < holder->elements.size()) target = &holder->elements[i];
+        }
+        if (!target) {
+            throw NativeError("'" + path + "' does not match " + instance.model->name + ": it has no field '" +
+                              name + "'.");
+        }
+        if (end == std::string::npos) return target;
+        container = untracked(*target);
+        start = end + 1;
+    }
+}
+
+// Copies large payloads out of the mapping on every thread, so the page
+// faults are taken in parallel
+void copyPayload(void* out, const char* in, size_t bytes) {
+    if (bytes < 2 * COPY_GRAIN) {
+        std::memcpy(out, in, bytes);
+        return;
+    }
+    ThreadPool::get().parallelFor(bytes, COPY_GRAIN, [&](size_t begin, size_t end) {
+        std::memcpy(static_cast<char*>(out) + begin, in + begin, end - begin);
+    });
+}
+
+} // namespace
+
+void saveCheckpoint(TrollInstance& instance, const std::string& path) {
+    std::vector<Entry> entries;
+    std::unordered_set<Object*> visited;
+    collectFields(instance, "", entries, visited);
+    std::string index = encodeIndex(entries);
+
+    static const char padding[PAYLOAD_ALIGNMENT] = {};
+    std::vector<iovec> parts;
+    parts.push_back({const_cast<char*>(index.data()), index.size()});
+    size_t position = index.size();
+    for (const Entry& entry : entries) {
+        if (entry.kind == Kind::Number) continue;
+        if (entry.offset > position) {
+            parts.push_back({const_cast<char*>(padding), entry.offset - position});
+        }
+        size_t bytes = payloadBytes(entry);
+        parts.push_back({entry.tensor->raw(), bytes});
+        position = entry.offset + bytes;
+    }
+
+    // An interrupted save leaves any earlier checkpoint at path intact
+    try {
+        replaceFile(path, std::move(parts));
+    } catch (const std::runtime_error& error) {
+        throw NativeError(error.what());
+    }
+}
+
+void loadCheckpoint(TrollInstance& instance, const std::string& path) {
+    std::shared_ptr<MappedFile> file;
+    try {
+        file = MappedFile::open(path);
+    } catch (const std::runtime_error& error) {
+        throw NativeError(error.what());
+    }
+    IndexReader reader(*file, path);
+    if (file->size() < MAGIC_LENGTH || std::memcmp(file->data(), MAGIC, MAGIC_LENGTH) != 0) {
+        reader.malformed("the magic string is missing");
+    }
+    reader.seek(MAGIC_LENGTH);
+    uint32_t version = reader.read<uint32_t>();
+    if (version != VERSION) reader.malformed("format version " + std::to_string(version) + " is unknown");
+    uint32_t count = reader.read<uint32_t>();
+
+    for (uint32_t e = 0; e < count; ++e) {
+        uint32_t length = reader.read<uint32_t>();
+        reader.need(length);
+        size_t next = reader.at() + length;
+        std::string name = reader.readString(reader.read<uint16_t>());
+        auto kind = reader.read<Kind>();
+        auto dtype = reader.read<DType>();
+        uint16_t rank = reader.read<uint16_t>();
+        if (kind > Kind::Array || dtype > DType::BF16 || (kind != Kind::Tensor && dtype != DType::F64)) {
+            reader.malformed("entry '" + name + "' has an unknown type");
+        }
+        RuntimeValue* target = locate(instance, name, path);
+
+        if (kind == Kind::Number) {
+            *target = RuntimeValue(reader.read<double>());
+        } else {
+            std::vector<size_t> shape(rank);
+            size_t elements = 1;
+            for (size_t& extent : shape) {
+                extent = reader.read<uint64_t>();
+                if (extent != 0 && elements > SIZE_MAX / extent) reader.malformed("entry '" + name + "' is too large");
+                elements *= extent;
+            }
+            if (kind == Kind::Array && rank != 1) reader.malformed("entry '" + name + "' has an unknown type");
+            uint64_t offset = reader.read<uint64_t>();
+            size_t bytes = elements * dtypeSize(dtype);
+            if (elements > SIZE_MAX / dtypeSize(dtype) || offset > file->size() || bytes > file->size() - offset) {
+                reader.malformed("the elements of '" + name + "' run past the end of the file");
+            }
+            if (offset % PAYLOAD_ALIGNMENT != 0) reader.malformed("the elements of '" + name + "' are not aligned");
+            const char* payload = file->data() + offset;
+            if (kind == Kind::Tensor) {
+                auto tensor = makeRef<TrollTensor>(std::move(shape), dtype);
+                copyPayload(tensor->raw(), payload, bytes);
+                *target = RuntimeValue(tensor);
+            } else {
+                std::vector<RuntimeValue> numbers(elements);
+                for (size_t i = 0; i < elements; ++i) {
+                    double number;
+                    std::memcpy(&number, payload + i * sizeof(double), sizeof(double));
+                    numbers[i] = RuntimeValue(number);
+                }
+                *target = RuntimeValue(makeRef<TrollArray>(std::move(numbers)));
+            }
+        }
+        if (reader.at() != next) reader.malformed("entry '" + name + "' has the wrong length");
+    }
+}
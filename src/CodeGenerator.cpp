@@ -54,42 +54,41 @@ void CodeGenerator::setupExternalFunctions() {
     getArgs.push_back(builder->getInt32Ty());
     llvm::FunctionType* getType = llvm::FunctionType::get(builder->getDoubleTy(), getArgs, false);
     llvm::Function::Create(getType, llvm::Function::ExternalLinkage, "troll_array_get", module.get());
+
+    // void* troll_array_binary(int op, int ltype, double lnum, void* lptr, int rtype, double rnum, void* rptr)
+    std::vector<llvm::Type*> binaryArgs;
+    binaryArgs.push_back(builder->getInt32Ty());
+    binaryArgs.push_back(builder->getInt32Ty());
+    binaryArgs.push_back(builder->getDoubleTy());
+    binaryArgs.push_back(llvm::PointerType::getUnqual(*context));
+    binaryArgs.push_back(builder->getInt32Ty());
+    binaryArgs.push_back(builder->getDoubleTy());
+    binaryArgs.push_back(llvm::PointerType::getUnqual(*context));
+    llvm::FunctionType* binaryType = llvm::FunctionType::get(llvm::PointerType::getUnqual(*context), binaryArgs, false);
+    llvm::Function::Create(binaryType, llvm::Function::ExternalLinkage, "troll_array_binary", module.get());
+}
+
+// TrollValues are built as SSA aggregates; fields a type does not use stay
+// zero (a null ptr for numbers and bools)
+llvm::Value* CodeGenerator::makeValue(ValueType type, llvm::Value* num, llvm::Value* ptr) {
+    llvm::Value* value = llvm::Constant::getNullValue(valueStructType);
+    value = builder->CreateInsertValue(value, builder->getInt32(type), 0);
+    if (num) value = builder->CreateInsertValue(value, num, 1);
+    if (ptr) value = builder->CreateInsertValue(value, ptr, 2);
+    return value;
 }
 
 llvm::Value* CodeGenerator::createNumber(double val) {
-    llvm::Value* alloc = builder->CreateAlloca(valueStructType);
-    llvm::Value* typePtr = builder->CreateStructGEP(valueStructType, alloc, 0);
-    llvm::Value* numPtr = builder->CreateStructGEP(valueStructType, alloc, 1);
-    
-    builder->CreateStore(builder->getInt32(TYPE_NUMBER), typePtr);
-    builder->CreateStore(llvm::ConstantFP::get(*context, llvm::APFloat(val)), numPtr);
-    
-    // Load as value (first class aggregate) or keep as pointer?
-    // Let's stick to passing Load (SSA struct value)
-    return builder->CreateLoad(valueStructType, alloc);
+    return makeValue(TYPE_NUMBER, llvm::ConstantFP::get(*context, llvm::APFloat(val)), nullptr);
 }
 
 llvm::Value* CodeGenerator::createBool(bool val) {
     // Bool is treated as number 0.0 or 1.0 but with TYPE_BOOL (2)
-    llvm::Value* alloc = builder->CreateAlloca(valueStructType);
-    llvm::Value* typePtr = builder->CreateStructGEP(valueStructType, alloc, 0);
-    llvm::Value* numPtr = builder->CreateStructGEP(valueStructType, alloc, 1);
-    
-    builder->CreateStore(builder->getInt32(TYPE_BOOL), typePtr);
-    builder->CreateStore(llvm::ConstantFP::get(*context, llvm::APFloat(val ? 1.0 : 0.0)), numPtr);
-    
-    return builder->CreateLoad(valueStructType, alloc);
+    return makeValue(TYPE_BOOL, llvm::ConstantFP::get(*context, llvm::APFloat(val ? 1.0 : 0.0)), nullptr);
 }
 
 llvm::Value* CodeGenerator::createArray(llvm::Value* ptr) {
-    llvm::Value* alloc = builder->CreateAlloca(valueStructType);
-    llvm::Value* typePtr = builder->CreateStructGEP(valueStructType, alloc, 0);
-    llvm::Value* ptrPtr = builder->CreateStructGEP(valueStructType, alloc, 2);
-    
-    builder->CreateStore(builder->getInt32(TYPE_ARRAY), typePtr);
-    builder->CreateStore(ptr, ptrPtr); // Store the array pointer
-    
-    return builder->CreateLoad(valueStructType, alloc);
+    return makeValue(TYPE_ARRAY, nullptr, ptr);
 }
 
 llvm::Value* CodeGenerator::unpackNumber(llvm::Value* trollVal) {
@@ -99,17 +98,117 @@ llvm::Value* CodeGenerator::unpackNumber(llvm::Value* trollVal) {
 }
 
 llvm::Value* CodeGenerator::createNumberFromValue(llvm::Value* val) {
-    llvm::Value* alloc = builder->CreateAlloca(valueStructType);
-    llvm::Value* typePtr = builder->CreateStructGEP(valueStructType, alloc, 0);
-    llvm::Value* numPtr = builder->CreateStructGEP(valueStructType, alloc, 1);
-    
-    builder->CreateStore(builder->getInt32(TYPE_NUMBER), typePtr);
-    builder->CreateStore(val, numPtr);
-    
-    return builder->CreateLoad(valueStructType, alloc);
+    return makeValue(TYPE_NUMBER, val, nullptr);
+}
+
+// Array types, found ahead of code generation: a variable may hold an array
+// when any binding of its name may (parameters included, through the
+// arguments of every call), and a function may return one when any of its
+// returns may. Names are not scoped, which only ever adds arrays. Repeats
+// until nothing changes, since uses can come before the binding that
+// decides them.
+void CodeGenerator::inferArrayTypes(const std::vector<std::shared_ptr<Stmt>>& statements) {
+    size_t before;
+    do {
+        before = arrayVariables.size() + arrayFunctions.size() + functionDecls.size();
+        for (const auto& stmt : statements) collectArrayTypes(stmt, nullptr);
+    } while (arrayVariables.size() + arrayFunctions.size() + functionDecls.size() != before);
+}
+
+void CodeGenerator::collectArrayTypes(const std::shared_ptr<Stmt>& stmt, FunctionStmt* function) {
+    if (!stmt) return;
+    if (auto let = std::dynamic_pointer_cast<LetStmt>(stmt)) {
+        collectArrayTypes(let->initializer);
+        if (mayBeArray(let->initializer)) arrayVariables.insert(let->name.lexeme);
+    } else if (auto block = std::dynamic_pointer_cast<BlockStmt>(stmt)) {
+        for (const auto& s : block->statements) collectArrayTypes(s, function);
+    } else if (auto ifStmt = std::dynamic_pointer_cast<IfStmt>(stmt)) {
+        collectArrayTypes(ifStmt->condition);
+        collectArrayTypes(ifStmt->thenBranch, function);
+        collectArrayTypes(ifStmt->elseBranch, function);
+    } else if (auto whileStmt = std::dynamic_pointer_cast<WhileStmt>(stmt)) {
+        collectArrayTypes(whileStmt->condition);
+        collectArrayTypes(whileStmt->body, function);
+    } else if (auto ret = std::dynamic_pointer_cast<ReturnStmt>(stmt)) {
+        collectArrayTypes(ret->value);
+        if (function && mayBeArray(ret->value)) arrayFunctions.insert(function->name.lexeme);
+    } else if (auto print = std::dynamic_pointer_cast<PrintStmt>(stmt)) {
+        collectArrayTypes(print->expression);
+    } else if (auto exprStmt = std::dynamic_pointer_cast<ExprStmt>(stmt)) {
+        collectArrayTypes(exprStmt->expression);
+    } else if (auto fn = std::dynamic_pointer_cast<FunctionStmt>(stmt)) {
+        functionDecls[fn->name.lexeme] = fn.get();
+        for (const auto& s : fn->body) collectArrayTypes(s, fn.get());
+    }
+}
+
+void CodeGenerator::collectArrayTypes(const std::shared_ptr<Expr>& expr) {
+    if (!expr) return;
+    if (auto assign = std::dynamic_pointer_cast<AssignmentExpr>(expr)) {
+        collectArrayTypes(assign->value);
+        if (mayBeArray(assign->value)) arrayVariables.insert(assign->name.lexeme);
+    } else if (auto binary = std::dynamic_pointer_cast<BinaryExpr>(expr)) {
+        collectArrayTypes(binary->left);
+        collectArrayTypes(binary->right);
+    } else if (auto call = std::dynamic_pointer_cast<CallExpr>(expr)) {
+        for (const auto& arg : call->arguments) collectArrayTypes(arg);
+        auto callee = std::dynamic_pointer_cast<VariableExpr>(call->callee);
+        auto decl = callee ? functionDecls.find(callee->name.lexeme) : functionDecls.end();
+        if (decl == functionDecls.end()) return;
+        const std::vector<Token>& params = decl->second->params;
+        for (size_t i = 0; i < params.size() && i < call->arguments.size(); ++i) {
+            if (mayBeArray(call->arguments[i])) arrayVariables.insert(params[i].lexeme);
+        }
+    } else if (auto array = std::dynamic_pointer_cast<ArrayLiteralExpr>(expr)) {
+        for (const auto& element : array->elements) collectArrayTypes(element);
+    } else if (auto index = std::dynamic_pointer_cast<IndexExpr>(expr)) {
+        collectArrayTypes(index->object);
+        collectArrayTypes(index->index);
+    } else if (auto store = std::dynamic_pointer_cast<ArrayAssignmentExpr>(expr)) {
+        collectArrayTypes(store->object);
+        collectArrayTypes(store->index);
+        collectArrayTypes(store->value);
+    }
+}
+
+bool CodeGenerator::mayBeArray(const std::shared_ptr<Expr>& expr) const {
+    if (!expr) return false;
+    if (std::dynamic_pointer_cast<ArrayLiteralExpr>(expr)) return true;
+    if (auto var = std::dynamic_pointer_cast<VariableExpr>(expr)) return arrayVariables.count(var->name.lexeme) > 0;
+    if (auto assign = std::dynamic_pointer_cast<AssignmentExpr>(expr)) return mayBeArray(assign->value);
+    if (auto store = std::dynamic_pointer_cast<ArrayAssignmentExpr>(expr)) return mayBeArray(store->value);
+    if (auto binary = std::dynamic_pointer_cast<BinaryExpr>(expr)) {
+        switch (binary->op.type) {
+            case TokenType::PLUS:
+            case TokenType::MINUS:
+            case TokenType::STAR:
+            case TokenType::SLASH:
+                return mayBeArray(binary->left) || mayBeArray(binary->right);
+            default: return false; // Comparisons give bools
+        }
+    }
+    if (auto call = std::dynamic_pointer_cast<CallExpr>(expr)) {
+        auto callee = std::dynamic_pointer_cast<VariableExpr>(call->callee);
+        if (!callee || !functionDecls.count(callee->name.lexeme)) return true; // Nothing known about it
+        return arrayFunctions.count(callee->name.lexeme) > 0;
+    }
+    return false; // Literals, and elements read with a[i]
+}
+
+// Every prototype exists before any body is emitted, so a call can come
+// ahead of its callee's definition (mutual recursion, for one).
+void CodeGenerator::declareFunctions() {
+    for (const auto& decl : functionDecls) {
+        std::vector<llvm::Type*> args(decl.second->params.size(), valueStructType);
+        llvm::FunctionType* ft = llvm::FunctionType::get(valueStructType, args, false);
+        llvm::Function::Create(ft, llvm::Function::ExternalLinkage, decl.first, module.get());
+    }
 }
 
 void CodeGenerator::generateCode(const std::vector<std::shared_ptr<Stmt>>& statements) {
+    inferArrayTypes(statements);
+    declareFunctions();
+
     // Create main function: int main()
     llvm::FunctionType* funcType = llvm::FunctionType::get(builder->getInt32Ty(), false);
     llvm::Function* mainFunc = llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, "main", module.get());
@@ -170,6 +269,46 @@ std::any CodeGenerator::visitLiteralExpr(std::shared_ptr<LiteralExpr> expr) {
     return (llvm::Value*)nullptr;
 }
 
+llvm::Value* CodeGenerator::arithmetic(int arrayOp, llvm::Value* left, llvm::Value* right, llvm::Value* scalar,
+                                       bool array) {
+    // Operands that are numbers in every run need no type check
+    if (!array) return createNumberFromValue(scalar);
+
+    // Scalar math is computed up front; arrays branch off to the runtime,
+    // which runs the whole elementwise op as one loop
+    llvm::Value* leftType = builder->CreateExtractValue(left, 0);
+    llvm::Value* rightType = builder->CreateExtractValue(right, 0);
+    llvm::Value* isArray = builder->CreateOr(builder->CreateICmpEQ(leftType, builder->getInt32(TYPE_ARRAY)),
+                                             builder->CreateICmpEQ(rightType, builder->getInt32(TYPE_ARRAY)));
+
+    llvm::Function* func = builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock* arrayBB = llvm::BasicBlock::Create(*context, "elementwise", func);
+    llvm::BasicBlock* numberBB = llvm::BasicBlock::Create(*context, "scalar", func);
+    llvm::BasicBlock* mergeBB = llvm::BasicBlock::Create(*context, "arithcont", func);
+    builder->CreateCondBr(isArray, arrayBB, numberBB);
+
+    builder->SetInsertPoint(arrayBB);
+    llvm::Function* binaryFunc = module->getFunction("troll_array_binary");
+    llvm::Value* resultPtr = builder->CreateCall(binaryFunc, {
+        builder->getInt32(arrayOp),
+        leftType, builder->CreateExtractValue(left, 1), builder->CreateExtractValue(left, 2),
+        rightType, builder->CreateExtractValue(right, 1), builder->CreateExtractValue(right, 2)});
+    llvm::Value* arrayResult = createArray(resultPtr);
+    builder->CreateBr(mergeBB);
+    arrayBB = builder->GetInsertBlock();
+
+    builder->SetInsertPoint(numberBB);
+    llvm::Value* numberResult = createNumberFromValue(scalar);
+    builder->CreateBr(mergeBB);
+    numberBB = builder->GetInsertBlock();
+
+    builder->SetInsertPoint(mergeBB);
+    llvm::PHINode* phi = builder->CreatePHI(valueStructType, 2, "arithtmp");
+    phi->addIncoming(arrayResult, arrayBB);
+    phi->addIncoming(numberResult, numberBB);
+    return phi;
+}
+
 std::any CodeGenerator::visitBinaryExpr(std::shared_ptr<BinaryExpr> expr) {
     llvm::Value* LStruct = evaluate(expr->left);
     llvm::Value* RStruct = evaluate(expr->right);
@@ -179,11 +318,15 @@ std::any CodeGenerator::visitBinaryExpr(std::shared_ptr<BinaryExpr> expr) {
     llvm::Value* L = unpackNumber(LStruct);
     llvm::Value* R = unpackNumber(RStruct);
     
-    // Math ops return Number (TrollValue)
-    if (expr->op.type == TokenType::PLUS) return createNumberFromValue(builder->CreateFAdd(L, R));
-    if (expr->op.type == TokenType::MINUS) return createNumberFromValue(builder->CreateFSub(L, R));
-    if (expr->op.type == TokenType::STAR) return createNumberFromValue(builder->CreateFMul(L, R));
-    if (expr->op.type == TokenType::SLASH) return createNumberFromValue(builder->CreateFDiv(L, R));
+    // Math ops return Number (TrollValue), or Array when either side is one
+    bool array = mayBeArray(expr->left) || mayBeArray(expr->right);
+    switch (expr->op.type) {
+        case TokenType::PLUS: return arithmetic(ARRAY_ADD, LStruct, RStruct, builder->CreateFAdd(L, R), array);
+        case TokenType::MINUS: return arithmetic(ARRAY_SUB, LStruct, RStruct, builder->CreateFSub(L, R), array);
+        case TokenType::STAR: return arithmetic(ARRAY_MUL, LStruct, RStruct, builder->CreateFMul(L, R), array);
+        case TokenType::SLASH: return arithmetic(ARRAY_DIV, LStruct, RStruct, builder->CreateFDiv(L, R), array);
+        default: break;
+    }
 
     // Comp ops return Bool (TrollValue)
     llvm::Value* cmp = nullptr;
@@ -198,11 +341,7 @@ std::any CodeGenerator::visitBinaryExpr(std::shared_ptr<BinaryExpr> expr) {
     }
     
     // Create Bool TrollValue from i1 result
-    llvm::Value* alloc = builder->CreateAlloca(valueStructType);
-    builder->CreateStore(builder->getInt32(TYPE_BOOL), builder->CreateStructGEP(valueStructType, alloc, 0));
-    llvm::Value* asDouble = builder->CreateUIToFP(cmp, builder->getDoubleTy());
-    builder->CreateStore(asDouble, builder->CreateStructGEP(valueStructType, alloc, 1));
-    return (llvm::Value*)builder->CreateLoad(valueStructType, alloc);
+    return makeValue(TYPE_BOOL, builder->CreateUIToFP(cmp, builder->getDoubleTy()), nullptr);
 }
 
 // Stubs for now
@@ -276,7 +415,15 @@ std::any CodeGenerator::visitCallExpr(std::shared_ptr<CallExpr> expr) {
         argsV.push_back(evaluate(arg));
     }
     
-    return (llvm::Value*)builder->CreateCall(calleeF, argsV, "calltmp");
+    llvm::CallInst* call = builder->CreateCall(calleeF, argsV, "calltmp");
+    if (expr->tail) {
+        // visitReturnStmt emits the ret right after the call. musttail needs
+        // matching prototypes, so other callees only get the tail hint.
+        llvm::Function* caller = builder->GetInsertBlock()->getParent();
+        bool samePrototype = caller->getFunctionType() == calleeF->getFunctionType();
+        call->setTailCallKind(samePrototype ? llvm::CallInst::TCK_MustTail : llvm::CallInst::TCK_Tail);
+    }
+    return (llvm::Value*)call;
 }
 std::any CodeGenerator::visitGetExpr(std::shared_ptr<GetExpr> expr) { return (llvm::Value*)nullptr; }
 std::any CodeGenerator::visitAssignmentExpr(std::shared_ptr<AssignmentExpr> expr) {
@@ -312,6 +459,9 @@ std::any CodeGenerator::visitArrayLiteralExpr(std::shared_ptr<ArrayLiteralExpr>
     return createArray(rawPtr);
 }
 
+// Compiled arrays have no views
+std::any CodeGenerator::visitSliceExpr(std::shared_ptr<SliceExpr> expr) { return (llvm::Value*)nullptr; }
+
 std::any CodeGenerator::visitIndexExpr(std::shared_ptr<IndexExpr> expr) {
     llvm::Value* objStruct = evaluate(expr->object);
     llvm::Value* idxStruct = evaluate(expr->index);
@@ -433,13 +583,14 @@ std::any CodeGenerator::visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt) {
     auto oldNamedValues = namedValues;
     namedValues.clear();
 
-    // Function signature uses TrollValue Struct (passed by value for now)
-    // Actually, passing struct by value in LLVM IR often requires 'byval' or expands it.
-    // Let's just use what LLVM defaults to for the StructType.
-    std::vector<llvm::Type*> args(stmt->params.size(), valueStructType);
-    llvm::FunctionType* ft = llvm::FunctionType::get(valueStructType, args, false);
-    
-    llvm::Function* function = llvm::Function::Create(ft, llvm::Function::ExternalLinkage, stmt->name.lexeme, module.get());
+    // Declared by declareFunctions; TrollValue structs are passed by value.
+    // A redefinition gets a function of its own, which LLVM renames.
+    llvm::Function* function = module->getFunction(stmt->name.lexeme);
+    if (!function->empty() || function->arg_size() != stmt->params.size()) {
+        std::vector<llvm::Type*> args(stmt->params.size(), valueStructType);
+        llvm::FunctionType* ft = llvm::FunctionType::get(valueStructType, args, false);
+        function = llvm::Function::Create(ft, llvm::Function::ExternalLinkage, stmt->name.lexeme, module.get());
+    }
     
     llvm::BasicBlock* bb = llvm::BasicBlock::Create(*context, "entry", function);
     builder->SetInsertPoint(bb);
@@ -0,0 +1,613 @@
+#include "../include/Compiler.h"
+#include "../include/VM.h"
+#include <stdexcept>
+
+std::shared_ptr<FunctionProto> Compiler::compile(const std::vector<std::shared_ptr<Stmt>>& statements) {
+    FunctionState state;
+    state.proto = std::make_shared<FunctionProto>();
+    state.proto->name = "script";
+    fs = &state;
+
+    for (const auto& stmt : statements) {
+        compileStatement(stmt);
+    }
+    emit(OpCode::RETURNNIL);
+
+    fs = nullptr;
+    return state.proto;
+}
+
+// Emission helpers
+
+int Compiler::allocRegister() {
+    int reg = fs->freeRegister++;
+    if (fs->freeRegister > fs->proto->maxRegisters) {
+        fs->proto->maxRegisters = fs->freeRegister;
+    }
+    return reg;
+}
+
+size_t Compiler::emit(OpCode op, int a, int b, int c, const Token* token) {
+    auto& proto = *fs->proto;
+    proto.code.push_back(Instruction{op, static_cast<uint32_t>(a), static_cast<uint32_t>(b), static_cast<uint32_t>(c)});
+    proto.tokenAt.push_back(token ? addToken(*token) : -1);
+    return proto.code.size() - 1;
+}
+
+void Compiler::patchJump(size_t at) {
+    Instruction& instr = fs->proto->code[at];
+    uint32_t target = static_cast<uint32_t>(currentOffset());
+    switch (instr.op) {
+        case OpCode::JMPIF:
+        case OpCode::JMPIFNOT:
+            instr.b = target;
+            break;
+        default: // JMP and the fused compare-and-jump ops
+            instr.a = target;
+            break;
+    }
+}
+
+int Compiler::addConstant(RuntimeValue value) {
+    auto& constants = fs->proto->constants;
+    if (value.isNumber()) {
+        double d = value.asNumber();
+        auto it = fs->numberConstants.find(d);
+        if (it != fs->numberConstants.end()) return it->second;
+        constants.push_back(value);
+        return fs->numberConstants[d] = static_cast<int>(constants.size() - 1);
+    }
+    if (value.isString()) {
+        const std::string& s = value.asString();
+        auto it = fs->stringConstants.find(s);
+        if (it != fs->stringConstants.end()) return it->second;
+        constants.push_back(value);
+        return fs->stringConstants[s] = static_cast<int>(constants.size() - 1);
+    }
+    constants.push_back(std::move(value));
+    return static_cast<int>(constants.size() - 1);
+}
+
+int Compiler::addToken(const Token& token) {
+    fs->proto->tokens.push_back(token);
+    return static_cast<int>(fs->proto->tokens.size() - 1);
+}
+
+int Compiler::currentOffset() const {
+    return static_cast<int>(fs->proto->code.size());
+}
+
+// Scopes and variables
+
+void Compiler::beginScope(bool isEnv) {
+    fs->scopes.push_back(Scope{isEnv, fs->freeRegister, {}, {}});
+}
+
+void Compiler::endScope() {
+    fs->freeRegister = fs->scopes.back().firstRegister;
+    fs->scopes.pop_back();
+}
+
+bool Compiler::atGlobalScope() const {
+    return fs->enclosing == nullptr && fs->scopes.empty();
+}
+
+void Compiler::declareHoisted(const std::vector<std::shared_ptr<Stmt>>& statements) {
+    auto& scope = fs->scopes.back();
+    for (const auto& stmt : statements) {
+        if (auto function = std::dynamic_pointer_cast<FunctionStmt>(stmt)) {
+            scope.locals.push_back(Local{function->name.lexeme, function->slot});
+        } else if (auto model = std::dynamic_pointer_cast<ModelStmt>(stmt)) {
+            scope.locals.push_back(Local{model->name.lexeme, model->slot});
+        } else if (auto let = std::dynamic_pointer_cast<LetStmt>(stmt)) {
+            scope.later.push_back(Local{let->name.lexeme, let->slot});
+        }
+    }
+}
+
+Compiler::VarRef Compiler::resolve(const std::string& name) {
+    int depth = 0;
+    // Like the Resolver, a nested function sees every let of its enclosing
+    // scopes, wherever it is declared. A let not reached yet is late: until
+    // it runs, the bindings further out apply (see VariableExpr::fallbacks).
+    LateBinding late{{}, -1};
+    for (FunctionState* f = fs; f != nullptr; f = f->enclosing) {
+        for (int i = static_cast<int>(f->scopes.size()) - 1; i >= 0; --i) {
+            const Scope& scope = f->scopes[i];
+            for (auto it = scope.locals.rbegin(); it != scope.locals.rend(); ++it) {
+                if (it->name != name) continue;
+                if (scope.isEnv) {
+                    if (late.bindings.empty()) return VarRef{VarKind::Env, it->index, depth};
+                    late.bindings.push_back(SlotRef{depth, it->index});
+                    return VarRef{VarKind::Late, 0, 0, std::move(late)};
+                }
+                if (f == fs) return VarRef{VarKind::Register, it->index, 0};
+                // Registers of an enclosing function are never captured: any scope
+                // containing a function declaration is an Environment scope.
+                throw std::logic_error("Compiler: captured register variable '" + name + "'.");
+            }
+            if (f != fs) {
+                for (const Local& local : scope.later) {
+                    if (local.name != name) continue;
+                    late.bindings.push_back(SlotRef{depth, local.index});
+                    break;
+                }
+            }
+            if (scope.isEnv) depth++;
+        }
+    }
+    if (late.bindings.empty()) return VarRef{VarKind::Global, vm.globalSlot(name), 0};
+    late.global = vm.globalSlot(name);
+    return VarRef{VarKind::Late, 0, 0, std::move(late)};
+}
+
+int Compiler::addLateBinding(LateBinding late) {
+    fs->proto->lateBindings.push_back(std::move(late));
+    return static_cast<int>(fs->proto->lateBindings.size() - 1);
+}
+
+// Expressions
+
+void Compiler::compileExpr(const std::shared_ptr<Expr>& expr, int target) {
+    int savedDest = dest;
+    bool savedDiscard = discard;
+    dest = target;
+    discard = false;
+    expr->accept(this);
+    dest = savedDest;
+    discard = savedDiscard;
+}
+
+int Compiler::exprToAnyRegister(const std::shared_ptr<Expr>& expr) {
+    if (auto var = std::dynamic_pointer_cast<VariableExpr>(expr)) {
+        VarRef ref = resolve(var->name.lexeme);
+        if (ref.kind == VarKind::Register) return ref.index;
+    }
+    int reg = allocRegister();
+    compileExpr(expr, reg);
+    return reg;
+}
+
+int Compiler::exprToOperand(const std::shared_ptr<Expr>& expr) {
+    if (auto literal = std::dynamic_pointer_cast<LiteralExpr>(expr)) {
+        if (!std::holds_alternative<std::monostate>(literal->value)) {
+            return static_cast<int>(addConstant(literal->constant) | RK_CONSTANT);
+        }
+    }
+    return exprToAnyRegister(expr);
+}
+
+void Compiler::compileCondition(const std::shared_ptr<Expr>& condition, std::vector<size_t>& falseJumps) {
+    int saved = fs->freeRegister;
+    if (auto binary = std::dynamic_pointer_cast<BinaryExpr>(condition)) {
+        OpCode op;
+        bool fused = true;
+        switch (binary->op.type) {
+            case TokenType::LESS: op = OpCode::JNLT; break;
+            case TokenType::LESS_EQUAL: op = OpCode::JNLE; break;
+            case TokenType::GREATER: op = OpCode::JNGT; break;
+            case TokenType::GREATER_EQUAL: op = OpCode::JNGE; break;
+            default: fused = false; break;
+        }
+        if (fused) {
+            int b = exprToOperand(binary->left);
+            int c = exprToOperand(binary->right);
+            falseJumps.push_back(emit(op, 0, b, c, &binary->op));
+            fs->freeRegister = saved;
+            return;
+        }
+    }
+    int reg = exprToAnyRegister(condition);
+    falseJumps.push_back(emit(OpCode::JMPIFNOT, reg, 0));
+    fs->freeRegister = saved;
+}
+
+std::any Compiler::visitLiteralExpr(std::shared_ptr<LiteralExpr> expr) {
+    if (std::holds_alternative<std::monostate>(expr->value)) {
+        emit(OpCode::LOADNIL, dest);
+    } else {
+        emit(OpCode::LOADK, dest, addConstant(expr->constant));
+    }
+    return std::any();
+}
+
+std::any Compiler::visitVariableExpr(std::shared_ptr<VariableExpr> expr) {
+    VarRef ref = resolve(expr->name.lexeme);
+    switch (ref.kind) {
+        case VarKind::Register:
+            if (ref.index != dest) emit(OpCode::MOVE, dest, ref.index);
+            break;
+        case VarKind::Env:
+            emit(expr->method ? OpCode::GETMETHOD : OpCode::GETENV, dest, ref.depth, ref.index);
+            break;
+        case VarKind::Global:
+            emit(OpCode::GETGLOBAL, dest, ref.index, 0, &expr->name);
+            break;
+        case VarKind::Late:
+            emit(OpCode::GETLATE, dest, addLateBinding(std::move(ref.late)), 0, &expr->name);
+            break;
+    }
+    return std::any();
+}
+
+std::any Compiler::visitBinaryExpr(std::shared_ptr<BinaryExpr> expr) {
+    OpCode op;
+    switch (expr->op.type) {
+        case TokenType::PLUS: op = OpCode::ADD; break;
+        case TokenType::MINUS: op = OpCode::SUB; break;
+        case TokenType::STAR: op = OpCode::MUL; break;
+        case TokenType::SLASH: op = OpCode::DIV; break;
+        case TokenType::PERCENT: op = OpCode::MOD; break;
+        case TokenType::AT: op = OpCode::MATMUL; break;
+        case TokenType::LESS: op = OpCode::LT; break;
+        case TokenType::LESS_EQUAL: op = OpCode::LE; break;
+        case TokenType::GREATER: op = OpCode::GT; break;
+        case TokenType::GREATER_EQUAL: op = OpCode::GE; break;
+        case TokenType::EQUAL_EQUAL: op = OpCode::EQ; break;
+        case TokenType::BANG_EQUAL: op = OpCode::NE; break;
+        default: op = OpCode::MOD; break; // Unknown operators evaluate to nil like the Interpreter
+    }
+
+    int saved = fs->freeRegister;
+    int b = exprToOperand(expr->left);
+    int c = exprToOperand(expr->right);
+    emit(op, dest, b, c, &expr->op);
+    fs->freeRegister = saved;
+    return std::any();
+}
+
+std::any Compiler::visitUnaryExpr(std::shared_ptr<UnaryExpr> expr) {
+    int saved = fs->freeRegister;
+    int reg = exprToAnyRegister(expr->right);
+    emit(expr->op.type == TokenType::MINUS ? OpCode::NEG : OpCode::NOT, dest, reg, 0, &expr->op);
+    fs->freeRegister = saved;
+    return std::any();
+}
+
+std::any Compiler::visitAssignmentExpr(std::shared_ptr<AssignmentExpr> expr) {
+    VarRef ref = resolve(expr->name.lexeme);
+    switch (ref.kind) {
+        case VarKind::Register:
+            compileExpr(expr->value, ref.index);
+            if (!discard && ref.index != dest) emit(OpCode::MOVE, dest, ref.index);
+            break;
+        case VarKind::Env:
+            compileExpr(expr->value, dest);
+            emit(OpCode::SETENV, dest, ref.depth, ref.index);
+            break;
+        case VarKind::Global:
+            compileExpr(expr->value, dest);
+            emit(OpCode::SETGLOBAL, dest, ref.index, 0, &expr->name);
+            break;
+        case VarKind::Late:
+            compileExpr(expr->value, dest);
+            emit(OpCode::SETLATE, dest, addLateBinding(std::move(ref.late)), 0, &expr->name);
+            break;
+    }
+    return std::any();
+}
+
+std::any Compiler::visitLogicalExpr(std::shared_ptr<LogicalExpr> expr) {
+    // Evaluate into a scratch register: dest may be a local read by the right operand.
+    int saved = fs->freeRegister;
+    int reg = allocRegister();
+    compileExpr(expr->left, reg);
+    size_t jump = emit(expr->op.type == TokenType::PIPE_PIPE ? OpCode::JMPIF : OpCode::JMPIFNOT, reg, 0);
+    compileExpr(expr->right, reg);
+    patchJump(jump);
+    emit(OpCode::MOVE, dest, reg);
+    fs->freeRegister = saved;
+    return std::any();
+}
+
+std::any Compiler::visitCallExpr(std::shared_ptr<CallExpr> expr) {
+    int saved = fs->freeRegister;
+    int base = allocRegister();
+    int argc = static_cast<int>(expr->arguments.size());
+
+    // obj.name(args): the receiver sits in the callee register until INVOKE looks the method up
+    if (auto get = std::dynamic_pointer_cast<GetExpr>(expr->callee)) {
+        compileExpr(get->object, base);
+        for (const auto& argument : expr->arguments) {
+            compileExpr(argument, allocRegister());
+        }
+        auto& caches = fs->proto->propertyCaches;
+        caches.emplace_back();
+        emit(expr->tail ? OpCode::TAILINVOKE : OpCode::INVOKE, base, argc, static_cast<int>(caches.size() - 1), &get->name);
+        if (!discard) emit(OpCode::MOVE, dest, base);
+        fs->freeRegister = saved;
+        return std::any();
+    }
+
+    // A sibling method is loaded unbound; CALL finds its receiver from the hop count
+    int receiverHops = 0;
+    auto variable = std::dynamic_pointer_cast<VariableExpr>(expr->callee);
+    if (variable && variable->method) {
+        VarRef ref = resolve(variable->name.lexeme); // Model scopes are always Environment scopes
+        emit(OpCode::GETENV, base, ref.depth, ref.index);
+        receiverHops = ref.depth + 1;
+    } else {
+        compileExpr(expr->callee, base);
+    }
+    for (const auto& argument : expr->arguments) {
+        compileExpr(argument, allocRegister());
+    }
+    // A tail call into compiled code never comes back here; a native callee
+    // falls through to the MOVE and the RETURN that follows
+    emit(expr->tail ? OpCode::TAILCALL : OpCode::CALL, base, argc, receiverHops, &expr->paren);
+    if (!discard) emit(OpCode::MOVE, dest, base);
+    fs->freeRegister = saved;
+    return std::any();
+}
+
+std::any Compiler::visitGetExpr(std::shared_ptr<GetExpr> expr) {
+    int saved = fs->freeRegister;
+    int object = exprToAnyRegister(expr->object);
+    auto& caches = fs->proto->propertyCaches;
+    caches.emplace_back();
+    emit(OpCode::GETPROP, dest, object, static_cast<int>(caches.size() - 1), &expr->name);
+    fs->freeRegister = saved;
+    return std::any();
+}
+
+std::any Compiler::visitArrayLiteralExpr(std::shared_ptr<ArrayLiteralExpr> expr) {
+    int saved = fs->freeRegister;
+    int base = fs->freeRegister;
+    for (const auto& el : expr->elements) {
+        compileExpr(el, allocRegister());
+    }
+    emit(OpCode::NEWARRAY, dest, base, static_cast<int>(expr->elements.size()));
+    fs->freeRegister = saved;
+    return std::any();
+}
+
+std::any Compiler::visitIndexExpr(std::shared_ptr<IndexExpr> expr) {
+    int saved = fs->freeRegister;
+    int object = exprToOperand(expr->object);
+    int index = exprToOperand(expr->index);
+    emit(OpCode::GETINDEX, dest, object, index, &expr->bracket);
+    fs->freeRegister = saved;
+    return std::any();
+}
+
+std::any Compiler::visitSliceExpr(std::shared_ptr<SliceExpr> expr) {
+    int saved = fs->freeRegister;
+    int object = exprToAnyRegister(expr->object);
+    int start = allocRegister();
+    int end = allocRegister();
+    if (expr->start) {
+        compileExpr(expr->start, start);
+    } else {
+        emit(OpCode::LOADNIL, start);
+    }
+    if (expr->end) {
+        compileExpr(expr->end, end);
+    } else {
+        emit(OpCode::LOADNIL, end);
+    }
+    emit(OpCode::GETSLICE, dest, object, start, &expr->bracket);
+    fs->freeRegister = saved;
+    return std::any();
+}
+
+std::any Compiler::visitArrayAssignmentExpr(std::shared_ptr<ArrayAssignmentExpr> expr) {
+    int saved = fs->freeRegister;
+    int object = exprToAnyRegister(expr->object);
+    int index = exprToOperand(expr->index);
+    int value = exprToOperand(expr->value);
+    emit(OpCode::SETINDEX, object, index, value, &expr->bracket);
+    if (!discard) {
+        if (value & RK_CONSTANT) {
+            emit(OpCode::LOADK, dest, value & ~RK_CONSTANT);
+        } else if (value != dest) {
+            emit(OpCode::MOVE, dest, value);
+        }
+    }
+    fs->freeRegister = saved;
+    return std::any();
+}
+
+// Statements
+
+void Compiler::compileStatement(const std::shared_ptr<Stmt>& stmt) {
+    stmt->accept(this);
+}
+
+std::any Compiler::visitExprStmt(std::shared_ptr<ExprStmt> stmt) {
+    int saved = fs->freeRegister;
+    int savedDest = dest;
+    dest = allocRegister();
+    discard = true;
+    stmt->expression->accept(this);
+    discard = false;
+    dest = savedDest;
+    fs->freeRegister = saved;
+    return std::any();
+}
+
+std::any Compiler::visitPrintStmt(std::shared_ptr<PrintStmt> stmt) {
+    int saved = fs->freeRegister;
+    emit(OpCode::PRINT, exprToAnyRegister(stmt->expression));
+    fs->freeRegister = saved;
+    return std::any();
+}
+
+std::any Compiler::visitLetStmt(std::shared_ptr<LetStmt> stmt) {
+    bool registerLocal = !atGlobalScope() && !fs->scopes.back().isEnv;
+    int saved = fs->freeRegister;
+    int reg = allocRegister();
+
+    if (stmt->initializer) {
+        compileExpr(stmt->initializer, reg);
+    } else {
+        emit(OpCode::LOADNIL, reg);
+    }
+
+    if (registerLocal) {
+        // The register stays allocated until the end of the scope
+        fs->scopes.back().locals.push_back(Local{stmt->name.lexeme, reg});
+        return std::any();
+    }
+    bindDeclaration(stmt->name.lexeme, stmt->slot, reg, stmt->name);
+    fs->freeRegister = saved;
+    return std::any();
+}
+
+std::any Compiler::visitBlockStmt(std::shared_ptr<BlockStmt> stmt) {
+    bool isEnv = stmt->captured;
+    beginScope(isEnv);
+    if (isEnv) {
+        emit(OpCode::PUSHENV, stmt->localCount);
+        declareHoisted(stmt->statements);
+    }
+    for (const auto& s : stmt->statements) {
+        compileStatement(s);
+    }
+    if (isEnv) emit(OpCode::POPENV);
+    endScope();
+    return std::any();
+}
+
+std::any Compiler::visitIfStmt(std::shared_ptr<IfStmt> stmt) {
+    std::vector<size_t> falseJumps;
+    compileCondition(stmt->condition, falseJumps);
+    compileStatement(stmt->thenBranch);
+
+    if (stmt->elseBranch) {
+        size_t endJump = emit(OpCode::JMP);
+        for (size_t jump : falseJumps) patchJump(jump);
+        compileStatement(stmt->elseBranch);
+        patchJump(endJump);
+    } else {
+        for (size_t jump : falseJumps) patchJump(jump);
+    }
+    return std::any();
+}
+
+std::any Compiler::visitWhileStmt(std::shared_ptr<WhileStmt> stmt) {
+    int loopStart = currentOffset();
+    std::vector<size_t> exitJumps;
+    compileCondition(stmt->condition, exitJumps);
+    compileStatement(stmt->body);
+    emit(OpCode::JMP, loopStart);
+    for (size_t jump : exitJumps) patchJump(jump);
+    return std::any();
+}
+
+std::any Compiler::visitReturnStmt(std::shared_ptr<ReturnStmt> stmt) {
+    if (stmt->value) {
+        int saved = fs->freeRegister;
+        emit(OpCode::RETURN, exprToAnyRegister(stmt->value));
+        fs->freeRegister = saved;
+    } else {
+        emit(OpCode::RETURNNIL);
+    }
+    return std::any();
+}
+
+std::any Compiler::visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt) {
+    int saved = fs->freeRegister;
+    int reg = allocRegister();
+    compileFunction(stmt, reg);
+    bindDeclaration(stmt->name.lexeme, stmt->slot, reg, stmt->name);
+    fs->freeRegister = saved;
+    return std::any();
+}
+
+std::any Compiler::visitModelStmt(std::shared_ptr<ModelStmt> stmt) {
+    int saved = fs->freeRegister;
+    int reg = allocRegister();
+    compileModel(stmt, reg);
+    bindDeclaration(stmt->name.lexeme, stmt->slot, reg, stmt->name);
+    fs->freeRegister = saved;
+    return std::any();
+}
+
+// Stores a declaration's value from reg into its global or Environment slot.
+void Compiler::bindDeclaration(const std::string& name, int slot, int reg, const Token& token) {
+    if (atGlobalScope()) {
+        emit(OpCode::DEFGLOBAL, reg, vm.globalSlot(name));
+        return;
+    }
+
+    auto& scope = fs->scopes.back();
+    bool declared = false;
+    for (const auto& local : scope.locals) {
+        if (local.name == name) declared = true;
+    }
+    if (!declared) scope.locals.push_back(Local{name, slot});
+    emit(OpCode::SETENV, reg, 0, slot, &token);
+}
+
+void Compiler::compileFunction(const std::shared_ptr<FunctionStmt>& stmt, int target) {
+    fs->proto->protos.push_back(compileFunctionProto(stmt));
+    emit(OpCode::CLOSURE, target, static_cast<int>(fs->proto->protos.size() - 1));
+}
+
+std::shared_ptr<FunctionProto> Compiler::compileFunctionProto(const std::shared_ptr<FunctionStmt>& stmt) {
+    FunctionState state;
+    state.proto = std::make_shared<FunctionProto>();
+    state.proto->name = stmt->name.lexeme;
+    state.proto->arity = static_cast<int>(stmt->params.size());
+    state.enclosing = fs;
+    fs = &state;
+
+    // Arguments arrive in registers 0..arity-1
+    bool isEnv = stmt->captured;
+    beginScope(isEnv);
+    for (size_t i = 0; i < stmt->params.size(); ++i) {
+        allocRegister();
+    }
+    if (isEnv) {
+        emit(OpCode::PUSHENV, stmt->localCount);
+        for (size_t i = 0; i < stmt->params.size(); ++i) {
+            emit(OpCode::SETENV, static_cast<int>(i), 0, static_cast<int>(i));
+        }
+    }
+    for (size_t i = 0; i < stmt->params.size(); ++i) {
+        fs->scopes.back().locals.push_back(Local{stmt->params[i].lexeme, static_cast<int>(i)});
+    }
+    if (isEnv) declareHoisted(stmt->body);
+
+    for (const auto& s : stmt->body) {
+        compileStatement(s);
+    }
+    emit(OpCode::RETURNNIL);
+    endScope();
+
+    fs = state.enclosing;
+    return state.proto;
+}
+
+void Compiler::compileModel(const std::shared_ptr<ModelStmt>& stmt, int target) {
+    FunctionState state;
+    state.proto = std::make_shared<FunctionProto>();
+    state.proto->name = stmt->name.lexeme;
+    state.enclosing = fs;
+    fs = &state;
+
+    // The constructor runs directly in the instance Environment, so its
+    // outermost scope is an Environment scope without a PUSHENV.
+    beginScope(true);
+    for (const auto& field : stmt->fieldSlots) {
+        fs->scopes.back().locals.push_back(Local{field.first, field.second});
+    }
+    // Methods are compiled once, in the constructor's scope so they reach
+    // fields through the instance Environment, but never instantiated here.
+    ModelProto model;
+    model.declaration = stmt;
+    model.constructor = state.proto;
+    for (const auto& member : stmt->methods) {
+        if (auto function = std::dynamic_pointer_cast<FunctionStmt>(member)) {
+            model.methods.emplace_back(stmt->fieldSlots.at(function->name.lexeme), compileFunctionProto(function));
+        } else {
+            compileStatement(member);
+        }
+    }
+    emit(OpCode::RETURNNIL);
+    endScope();
+
+    fs = state.enclosing;
+    fs->proto->models.push_back(std::move(model));
+    emit(OpCode::MODEL, target, static_cast<int>(fs->proto->models.size() - 1));
+}
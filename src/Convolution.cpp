@@ -0,0 +1,270 @@
+#include "../include/Convolution.h"
+#include "../include/Gemm.h"
+#include "../include/ThreadPool.h"
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+// Images with small outputs are unrolled side by side until the product
+// has this many columns, so gemm gets panels wide enough to block
+constexpr size_t MIN_COLUMNS = 512;
+
+bool isDirect(const Conv2dShape& shape) {
+    return shape.kernelHeight == 1 && shape.kernelWidth == 1 && shape.stride == 1 && shape.padding == 0;
+}
+
+// Input row of output row `o` at kernel offset `k`, or -1 in the padding
+inline ptrdiff_t sourceIndex(size_t o, size_t k, const Conv2dShape& shape, size_t extent) {
+    ptrdiff_t i = static_cast<ptrdiff_t>(o * shape.stride + k) - static_cast<ptrdiff_t>(shape.padding);
+    return i >= 0 && i < static_cast<ptrdiff_t>(extent) ? i : -1;
+}
+
+// cols[(c, kh, kw)][(oh, ow)] = image[c][oh * stride + kh - padding][ow * stride + kw - padding],
+// zero in the padding, with rows `ld` apart. Channels are split across the
+// pool.
+template <typename T>
+void im2col(const Conv2dShape& shape, const T* image, T* cols, size_t ld) {
+    size_t outHeight = shape.outHeight();
+    size_t outWidth = shape.outWidth();
+    size_t window = shape.kernelHeight * shape.kernelWidth;
+    size_t plane = shape.height * shape.width;
+    ThreadPool::forEach(shape.channels, window * outHeight * outWidth, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            for (size_t kh = 0; kh < shape.kernelHeight; ++kh) {
+                for (size_t kw = 0; kw < shape.kernelWidth; ++kw) {
+                    T* row = cols + ((c * shape.kernelHeight + kh) * shape.kernelWidth + kw) * ld;
+                    for (size_t oh = 0; oh < outHeight; ++oh) {
+                        T* target = row + oh * outWidth;
+                        ptrdiff_t ih = sourceIndex(oh, kh, shape, shape.height);
+                        if (ih < 0) {
+                            std::fill(target, target + outWidth, T(0.0f));
+                            continue;
+                        }
+                        const T* source = image + c * plane + static_cast<size_t>(ih) * shape.width;
+                        for (size_t ow = 0; ow < outWidth; ++ow) {
+                            ptrdiff_t iw = sourceIndex(ow, kw, shape, shape.width);
+                            target[ow] = iw < 0 ? T(0.0f) : source[iw];
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
+
+// The reverse: adds every column entry back into the image element it
+// was taken from
+template <typename C>
+void col2im(const Conv2dShape& shape, const C* cols, C* image) {
+    size_t outHeight = shape.outHeight();
+    size_t outWidth = shape.outWidth();
+    size_t window = shape.kernelHeight * shape.kernelWidth;
+    size_t plane = shape.height * shape.width;
+    ThreadPool::forEach(shape.channels, window * outHeight * outWidth, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            for (size_t kh = 0; kh < shape.kernelHeight; ++kh) {
+                for (size_t kw = 0; kw < shape.kernelWidth; ++kw) {
+                    const C* row = cols + ((c * shape.kernelHeight + kh) * shape.kernelWidth + kw) * outHeight * outWidth;
+                    for (size_t oh = 0; oh < outHeight; ++oh) {
+                        ptrdiff_t ih = sourceIndex(oh, kh, shape, shape.height);
+                        if (ih < 0) continue;
+                        C* target = image + c * plane + static_cast<size_t>(ih) * shape.width;
+                        for (size_t ow = 0; ow < outWidth; ++ow) {
+                            ptrdiff_t iw = sourceIndex(ow, kw, shape, shape.width);
+                            if (iw >= 0) target[iw] += row[oh * outWidth + ow];
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
+
+// c (m x n, contiguous) = a @ b in T's compute type
+template <typename T>
+void product(size_t m, size_t n, size_t k, StridedMatrix<T> a, StridedMatrix<T> b,
+             typename ComputeType<T>::type* c) {
+    gemm(m, n, k, a, b, c, n);
+}
+
+template <typename T>
+StridedMatrix<T> rowMajor(const T* data, size_t columns) {
+    return StridedMatrix<T>{data, static_cast<ptrdiff_t>(columns), 1};
+}
+
+// The transpose of a row-major matrix with `columns` columns
+template <typename T>
+StridedMatrix<T> transposed(const T* data, size_t columns) {
+    return StridedMatrix<T>{data, 1, static_cast<ptrdiff_t>(columns)};
+}
+
+} // namespace
+
+template <typename T>
+void conv2d(const Conv2dShape& shape, const T* input, const T* kernel, T* out) {
+    using C = typename ComputeType<T>::type;
+    size_t k = shape.channels * shape.kernelHeight * shape.kernelWidth;
+    size_t spatial = shape.outHeight() * shape.outWidth();
+    size_t imageSize = shape.channels * shape.height * shape.width;
+    bool direct = isDirect(shape);
+    size_t group = direct ? 1 : std::min(shape.batch, std::max<size_t>(1, MIN_COLUMNS / std::max<size_t>(1, spatial)));
+    size_t columns = group * spatial;
+    std::vector<T> cols(direct ? 0 : k * columns);
+    std::vector<C> result(group == 1 && std::is_same<T, C>::value ? 0 : shape.filters * columns);
+
+    for (size_t first = 0; first < shape.batch; first += group) {
+        size_t images = std::min(group, shape.batch - first);
+        const T* image = input + first * imageSize;
+        for (size_t g = 0; g < images && !direct; ++g) {
+            im2col(shape, image + g * imageSize, cols.data() + g * spatial, columns);
+        }
+        StridedMatrix<T> windows = rowMajor(direct ? image : cols.data(), columns);
+        T* planes = out + first * shape.filters * spatial;
+        if constexpr (std::is_same<T, C>::value) {
+            if (group == 1) {
+                product(shape.filters, spatial, k, rowMajor(kernel, k), windows, planes);
+                continue;
+            }
+        }
+        // Columns of image g become its F output planes
+        product(shape.filters, images * spatial, k, rowMajor(kernel, k), windows, result.data());
+        for (size_t g = 0; g < images; ++g) {
+            for (size_t f = 0; f < shape.filters; ++f) {
+                const C* source = result.data() + f * images * spatial + g * spatial;
+                T* target = planes + (g * shape.filters + f) * spatial;
+                for (size_t i = 0; i < spatial; ++i) target[i] = T(source[i]);
+            }
+        }
+    }
+}
+
+template <typename T>
+void conv2dBackward(const Conv2dShape& shape, const T* input, const T* kernel, const T* gradient,
+                    T* inputGradient, T* kernelGradient) {
+    using C = typename ComputeType<T>::type;
+    size_t k = shape.channels * shape.kernelHeight * shape.kernelWidth;
+    size_t spatial = shape.outHeight() * shape.outWidth();
+    size_t plane = shape.height * shape.width;
+    size_t imageSize = shape.channels * plane;
+    bool direct = isDirect(shape);
+    std::vector<T> cols(direct || !kernelGradient ? 0 : k * spatial);
+    std::vector<C> kernelSum(kernelGradient ? shape.filters * k : 0);
+    std::vector<C> kernelStep(kernelSum.size());
+    std::vector<C> colsGradient(inputGradient ? k * spatial : 0);
+    std::vector<C> imageGradient(inputGradient && !direct ? imageSize : 0);
+
+    for (size_t n = 0; n < shape.batch; ++n) {
+        const T* image = input + n * imageSize;
+        StridedMatrix<T> outputGradient = rowMajor(gradient + n * shape.filters * spatial, spatial);
+        if (kernelGradient) {
+            // dK += dOut (F x spatial) @ cols^T (spatial x k)
+            if (!direct) im2col(shape, image, cols.data(), spatial);
+            product(shape.filters, k, spatial, outputGradient, transposed(direct ? image : cols.data(), spatial),
+                    kernelStep.data());
+            for (size_t i = 0; i < kernelSum.size(); ++i) kernelSum[i] += kernelStep[i];
+        }
+        if (inputGradient) {
+            // dCols = K^T (k x F) @ dOut (F x spatial), folded back into the image
+            product(k, spatial, shape.filters, transposed(kernel, k), outputGradient, colsGradient.data());
+            const C* source = colsGradient.data();
+            if (!direct) {
+                std::fill(imageGradient.begin(), imageGradient.end(), C(0));
+                col2im(shape, colsGradient.data(), imageGradient.data());
+                source = imageGradient.data();
+            }
+            T* target = inputGradient + n * imageSize;
+            for (size_t i = 0; i < imageSize; ++i) target[i] = T(source[i]);
+        }
+    }
+    if (kernelGradient) {
+        for (size_t i = 0; i < kernelSum.size(); ++i) kernelGradient[i] = T(kernelSum[i]);
+    }
+}
+
+template <typename T>
+void pool2d(Pooling pooling, const Conv2dShape& shape, const T* input, T* out) {
+    using C = typename ComputeType<T>::type;
+    size_t outHeight = shape.outHeight();
+    size_t outWidth = shape.outWidth();
+    size_t plane = shape.height * shape.width;
+    C area = C(shape.kernelHeight * shape.kernelWidth);
+    ThreadPool::forEach(shape.batch * shape.channels, plane, [&](size_t begin, size_t end) {
+        for (size_t p = begin; p < end; ++p) {
+            const T* source = input + p * plane;
+            T* target = out + p * outHeight * outWidth;
+            for (size_t oh = 0; oh < outHeight; ++oh) {
+                for (size_t ow = 0; ow < outWidth; ++ow) {
+                    const T* corner = source + oh * shape.stride * shape.width + ow * shape.stride;
+                    C value = pooling == Pooling::Max ? -std::numeric_limits<C>::infinity() : C(0);
+                    for (size_t kh = 0; kh < shape.kernelHeight; ++kh) {
+                        for (size_t kw = 0; kw < shape.kernelWidth; ++kw) {
+                            C x = C(corner[kh * shape.width + kw]);
+                            value = pooling == Pooling::Max ? (x > value ? x : value) : value + x;
+                        }
+                    }
+                    target[oh * outWidth + ow] = T(pooling == Pooling::Max ? value : value / area);
+                }
+            }
+        }
+    });
+}
+
+template <typename T>
+void pool2dBackward(Pooling pooling, const Conv2dShape& shape, const T* input, const T* gradient,
+                    T* inputGradient) {
+    using C = typename ComputeType<T>::type;
+    size_t outHeight = shape.outHeight();
+    size_t outWidth = shape.outWidth();
+    size_t plane = shape.height * shape.width;
+    C area = C(shape.kernelHeight * shape.kernelWidth);
+    ThreadPool::forEach(shape.batch * shape.channels, plane, [&](size_t begin, size_t end) {
+        // Windows may overlap, so a plane is summed in C before rounding
+        std::vector<C> sums(plane);
+        for (size_t p = begin; p < end; ++p) {
+            const T* source = input + p * plane;
+            const T* g = gradient + p * outHeight * outWidth;
+            std::fill(sums.begin(), sums.end(), C(0));
+            for (size_t oh = 0; oh < outHeight; ++oh) {
+                for (size_t ow = 0; ow < outWidth; ++ow) {
+                    size_t corner = oh * shape.stride * shape.width + ow * shape.stride;
+                    C share = C(g[oh * outWidth + ow]);
+                    if (pooling == Pooling::Average) {
+                        for (size_t kh = 0; kh < shape.kernelHeight; ++kh) {
+                            for (size_t kw = 0; kw < shape.kernelWidth; ++kw) {
+                                sums[corner + kh * shape.width + kw] += share / area;
+                            }
+                        }
+                        continue;
+                    }
+                    size_t best = corner;
+                    for (size_t kh = 0; kh < shape.kernelHeight; ++kh) {
+                        for (size_t kw = 0; kw < shape.kernelWidth; ++kw) {
+                            size_t i = corner + kh * shape.width + kw;
+                            if (C(source[i]) > C(source[best])) best = i;
+                        }
+                    }
+                    sums[best] += share;
+                }
+            }
+            T* target = inputGradient + p * plane;
+            for (size_t i = 0; i < plane; ++i) target[i] = T(sums[i]);
+        }
+    });
+}
+
+template void conv2d(const Conv2dShape&, const double*, const double*, double*);
+template void conv2d(const Conv2dShape&, const float*, const float*, float*);
+template void conv2d(const Conv2dShape&, const BFloat16*, const BFloat16*, BFloat16*);
+template void conv2dBackward(const Conv2dShape&, const double*, const double*, const double*, double*, double*);
+template void conv2dBackward(const Conv2dShape&, const float*, const float*, const float*, float*, float*);
+template void conv2dBackward(const Conv2dShape&, const BFloat16*, const BFloat16*, const BFloat16*, BFloat16*,
+                             BFloat16*);
+template void pool2d(Pooling, const Conv2dShape&, const double*, double*);
+template void pool2d(Pooling, const Conv2dShape&, const float*, float*);
+template void pool2d(Pooling, const Conv2dShape&, const BFloat16*, BFloat16*);
+template void pool2dBackward(Pooling, const Conv2dShape&, const double*, const double*, double*);
+template void pool2dBackward(Pooling, const Conv2dShape&, const float*, const float*, float*);
+template void pool2dBackward(Pooling, const Conv2dShape&, const BFloat16*, const BFloat16*, BFloat16*);
@@ -0,0 +1,439 @@
+#include "../include/Gemm.h"
+#include "../include/ThreadPool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TROLL_GEMM_X86
+#endif
+
+namespace {
+
+// C[0:MR, 0:NR] += packed A panel (kc x MR) * packed B panel (kc x NR)
+template <typename T>
+struct Kernel {
+    using MicroKernel = void (*)(size_t kc, const T* a, const T* b, T* c, size_t ldc);
+
+    const char* name;
+    size_t mr;
+    size_t nr;
+    MicroKernel run;
+};
+
+constexpr size_t KC = 256;  // Depth of a packed panel; A and B micro-panels stay in L1
+constexpr size_t MC = 96;   // Rows of A packed per block (L2), a multiple of every MR
+constexpr size_t NC = 2048; // Columns of B packed per panel (L3)
+constexpr size_t MAX_TILE = 8 * 48; // Largest MR x NR
+
+template <typename T, size_t MR, size_t NR>
+void scalarKernel(size_t kc, const T* a, const T* b, T* c, size_t ldc) {
+    T acc[MR][NR] = {};
+    for (size_t p = 0; p < kc; ++p) {
+        for (size_t i = 0; i < MR; ++i) {
+            for (size_t j = 0; j < NR; ++j) {
+                acc[i][j] += a[i] * b[j];
+            }
+        }
+        a += MR;
+        b += NR;
+    }
+    for (size_t i = 0; i < MR; ++i) {
+        for (size_t j = 0; j < NR; ++j) {
+            c[i * ldc + j] += acc[i][j];
+        }
+    }
+}
+
+#ifdef TROLL_GEMM_X86
+// 6 x 8: twelve ymm accumulators, two B vectors and one broadcast
+__attribute__((target("avx2,fma")))
+void avx2Kernel(size_t kc, const double* a, const double* b, double* c, size_t ldc) {
+    __m256d acc[6][2];
+#pragma GCC unroll 6
+    for (int i = 0; i < 6; ++i) {
+        acc[i][0] = _mm256_setzero_pd();
+        acc[i][1] = _mm256_setzero_pd();
+    }
+    for (size_t p = 0; p < kc; ++p) {
+        __m256d b0 = _mm256_loadu_pd(b);
+        __m256d b1 = _mm256_loadu_pd(b + 4);
+#pragma GCC unroll 6
+        for (int i = 0; i < 6; ++i) {
+            __m256d ai = _mm256_broadcast_sd(a + i);
+            acc[i][0] = _mm256_fmadd_pd(ai, b0, acc[i][0]);
+            acc[i][1] = _mm256_fmadd_pd(ai, b1, acc[i][1]);
+        }
+        a += 6;
+        b += 8;
+    }
+#pragma GCC unroll 6
+    for (int i = 0; i < 6; ++i) {
+        double* row = c + i * ldc;
+        _mm256_storeu_pd(row, _mm256_add_pd(_mm256_loadu_pd(row), acc[i][0]));
+        _mm256_storeu_pd(row + 4, _mm256_add_pd(_mm256_loadu_pd(row + 4), acc[i][1]));
+    }
+}
+
+// 8 x 24: twenty-four zmm accumulators, three B vectors and one broadcast
+__attribute__((target("avx512f")))
+void avx512Kernel(size_t kc, const double* a, const double* b, double* c, size_t ldc) {
+    __m512d acc[8][3];
+#pragma GCC unroll 8
+    for (int i = 0; i < 8; ++i) {
+        acc[i][0] = _mm512_setzero_pd();
+        acc[i][1] = _mm512_setzero_pd();
+        acc[i][2] = _mm512_setzero_pd();
+    }
+    for (size_t p = 0; p < kc; ++p) {
+        __m512d b0 = _mm512_loadu_pd(b);
+        __m512d b1 = _mm512_loadu_pd(b + 8);
+        __m512d b2 = _mm512_loadu_pd(b + 16);
+#pragma GCC unroll 8
+        for (int i = 0; i < 8; ++i) {
+            __m512d ai = _mm512_set1_pd(a[i]);
+            acc[i][0] = _mm512_fmadd_pd(ai, b0, acc[i][0]);
+            acc[i][1] = _mm512_fmadd_pd(ai, b1, acc[i][1]);
+            acc[i][2] = _mm512_fmadd_pd(ai, b2, acc[i][2]);
+        }
+        a += 8;
+        b += 24;
+    }
+#pragma GCC unroll 8
+    for (int i = 0; i < 8; ++i) {
+        double* row = c + i * ldc;
+        _mm512_storeu_pd(row, _mm512_add_pd(_mm512_loadu_pd(row), acc[i][0]));
+        _mm512_storeu_pd(row + 8, _mm512_add_pd(_mm512_loadu_pd(row + 8), acc[i][1]));
+        _mm512_storeu_pd(row + 16, _mm512_add_pd(_mm512_loadu_pd(row + 16), acc[i][2]));
+    }
+}
+
+// The f32 kernels: the same register tiles, with twice the columns
+__attribute__((target("avx2,fma")))
+void avx2KernelF32(size_t kc, const float* a, const float* b, float* c, size_t ldc) {
+    __m256 acc[6][2];
+#pragma GCC unroll 6
+    for (int i = 0; i < 6; ++i) {
+        acc[i][0] = _mm256_setzero_ps();
+        acc[i][1] = _mm256_setzero_ps();
+    }
+    for (size_t p = 0; p < kc; ++p) {
+        __m256 b0 = _mm256_loadu_ps(b);
+        __m256 b1 = _mm256_loadu_ps(b + 8);
+#pragma GCC unroll 6
+        for (int i = 0; i < 6; ++i) {
+            __m256 ai = _mm256_broadcast_ss(a + i);
+            acc[i][0] = _mm256_fmadd_ps(ai, b0, acc[i][0]);
+            acc[i][1] = _mm256_fmadd_ps(ai, b1, acc[i][1]);
+        }
+        a += 6;
+        b += 16;
+    }
+#pragma GCC unroll 6
+    for (int i = 0; i < 6; ++i) {
+        float* row = c + i * ldc;
+        _mm256_storeu_ps(row, _mm256_add_ps(_mm256_loadu_ps(row), acc[i][0]));
+        _mm256_storeu_ps(row + 8, _mm256_add_ps(_mm256_loadu_ps(row + 8), acc[i][1]));
+    }
+}
+
+__attribute__((target("avx512f")))
+void avx512KernelF32(size_t kc, const float* a, const float* b, float* c, size_t ldc) {
+    __m512 acc[8][3];
+#pragma GCC unroll 8
+    for (int i = 0; i < 8; ++i) {
+        acc[i][0] = _mm512_setzero_ps();
+        acc[i][1] = _mm512_setzero_ps();
+        acc[i][2] = _mm512_setzero_ps();
+    }
+    for (size_t p = 0; p < kc; ++p) {
+        __m512 b0 = _mm512_loadu_ps(b);
+        __m512 b1 = _mm512_loadu_ps(b + 16);
+        __m512 b2 = _mm512_loadu_ps(b + 32);
+#pragma GCC unroll 8
+        for (int i = 0; i < 8; ++i) {
+            __m512 ai = _mm512_set1_ps(a[i]);
+            acc[i][0] = _mm512_fmadd_ps(ai, b0, acc[i][0]);
+            acc[i][1] = _mm512_fmadd_ps(ai, b1, acc[i][1]);
+            acc[i][2] = _mm512_fmadd_ps(ai, b2, acc[i][2]);
+        }
+        a += 8;
+        b += 48;
+    }
+#pragma GCC unroll 8
+    for (int i = 0; i < 8; ++i) {
+        float* row = c + i * ldc;
+        _mm512_storeu_ps(row, _mm512_add_ps(_mm512_loadu_ps(row), acc[i][0]));
+        _mm512_storeu_ps(row + 16, _mm512_add_ps(_mm512_loadu_ps(row + 16), acc[i][1]));
+        _mm512_storeu_ps(row + 32, _mm512_add_ps(_mm512_loadu_ps(row + 32), acc[i][2]));
+    }
+}
+#endif
+
+template <typename T>
+const Kernel<T>& selectKernel(const Kernel<T>& scalar, const Kernel<T>* avx2, const Kernel<T>* avx512) {
+    const char* forced = std::getenv("TROLL_GEMM");
+#ifdef TROLL_GEMM_X86
+    __builtin_cpu_init();
+    bool hasAvx512 = __builtin_cpu_supports("avx512f");
+    bool hasAvx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if (forced) {
+        if (std::strcmp(forced, "avx512") == 0 && hasAvx512) return *avx512;
+        if (std::strcmp(forced, "avx2") == 0 && hasAvx2) return *avx2;
+        if (std::strcmp(forced, "scalar") == 0) return scalar;
+    }
+    if (hasAvx512) return *avx512;
+    if (hasAvx2) return *avx2;
+#else
+    (void)forced;
+    (void)avx2;
+    (void)avx512;
+#endif
+    return scalar;
+}
+
+template <typename T>
+const Kernel<T>& kernel();
+
+const Kernel<double> SCALAR{"scalar", 4, 4, scalarKernel<double, 4, 4>};
+const Kernel<float> SCALAR_F32{"scalar", 4, 8, scalarKernel<float, 4, 8>};
+#ifdef TROLL_GEMM_X86
+const Kernel<double> AVX2{"avx2", 6, 8, avx2Kernel};
+const Kernel<double> AVX512{"avx512", 8, 24, avx512Kernel};
+const Kernel<float> AVX2_F32{"avx2", 6, 16, avx2KernelF32};
+const Kernel<float> AVX512_F32{"avx512", 8, 48, avx512KernelF32};
+
+template <>
+const Kernel<double>& kernel<double>() {
+    static const Kernel<double>& selected = selectKernel(SCALAR, &AVX2, &AVX512);
+    return selected;
+}
+
+template <>
+const Kernel<float>& kernel<float>() {
+    static const Kernel<float>& selected = selectKernel(SCALAR_F32, &AVX2_F32, &AVX512_F32);
+    return selected;
+}
+#else
+template <>
+const Kernel<double>& kernel<double>() {
+    static const Kernel<double>& selected = selectKernel<double>(SCALAR, nullptr, nullptr);
+    return selected;
+}
+
+template <>
+const Kernel<float>& kernel<float>() {
+    static const Kernel<float>& selected = selectKernel<float>(SCALAR_F32, nullptr, nullptr);
+    return selected;
+}
+#endif
+
+// Rows [i, i + mc) x depth [p, p + kc) of A into MR-row micro-panels, each
+// stored depth-major (MR values per step), zero-padded past the last row.
+// Elements are converted to the kernel's type on the way.
+template <typename S, typename T>
+void packA(const StridedMatrix<S>& a, size_t i, size_t mc, size_t p, size_t kc, size_t mr, T* out) {
+    for (size_t ir = 0; ir < mc; ir += mr) {
+        size_t rows = std::min(mr, mc - ir);
+        for (size_t q = 0; q < kc; ++q) {
+            const S* column = a.data + static_cast<ptrdiff_t>(p + q) * a.colStride;
+            for (size_t r = 0; r < rows; ++r) {
+                out[r] = static_cast<T>(column[static_cast<ptrdiff_t>(i + ir + r) * a.rowStride]);
+            }
+            for (size_t r = rows; r < mr; ++r) out[r] = T(0);
+            out += mr;
+        }
+    }
+}
+
+// Depth [p, p + kc) x columns [j, j + nc) of B into NR-column micro-panels,
+// each stored depth-major, zero-padded past the last column.
+template <typename S, typename T>
+void packB(const StridedMatrix<S>& b, size_t p, size_t kc, size_t j, size_t nc, size_t nr, T* out) {
+    for (size_t jr = 0; jr < nc; jr += nr) {
+        size_t cols = std::min(nr, nc - jr);
+        for (size_t q = 0; q < kc; ++q) {
+            const S* row = b.data + static_cast<ptrdiff_t>(p + q) * b.rowStride;
+            if (std::is_same<S, T>::value && b.colStride == 1) {
+                std::memcpy(out, row + j + jr, cols * sizeof(T));
+            } else {
+                for (size_t col = 0; col < cols; ++col) {
+                    out[col] = static_cast<T>(row[static_cast<ptrdiff_t>(j + jr + col) * b.colStride]);
+                }
+            }
+            for (size_t col = cols; col < nr; ++col) out[col] = T(0);
+            out += nr;
+        }
+    }
+}
+
+// Packing buffers are reused across calls; one set per thread and type
+template <typename T>
+struct PackBuffers {
+    std::vector<T> a;
+    std::vector<T> b;
+};
+
+template <typename T>
+PackBuffers<T>& packBuffers() {
+    thread_local PackBuffers<T> buffers;
+    return buffers;
+}
+
+// Below this many multiply-adds the whole product runs on the calling thread
+constexpr size_t PARALLEL_WORK = 1 << 20;
+
+// S is the element type of A and B, T the one the kernel computes in.
+// Computes `batch` products against the one B: sample s reads A at
+// a.data + s * aBatch and writes C at c + s * cBatch. Each B panel is
+// packed once and used by the row blocks of every sample. `mayParallel`
+// false keeps the whole call on the calling thread.
+template <typename S, typename T>
+void blockedGemm(size_t batch, size_t m, size_t n, size_t k, StridedMatrix<S> a, ptrdiff_t aBatch,
+                 StridedMatrix<S> b, T* c, size_t ldc, size_t cBatch, bool mayParallel) {
+    for (size_t s = 0; s < batch; ++s) {
+        for (size_t i = 0; i < m; ++i) {
+            std::fill(c + s * cBatch + i * ldc, c + s * cBatch + i * ldc + n, T(0));
+        }
+    }
+    if (batch == 0 || m == 0 || n == 0 || k == 0) return;
+
+    const Kernel<T>& kern = kernel<T>();
+    const size_t mr = kern.mr;
+    const size_t nr = kern.nr;
+    ThreadPool& pool = ThreadPool::get();
+    bool parallel = mayParallel && pool.threadCount() > 1 && batch * m * n * k >= PARALLEL_WORK;
+    // A thread waiting on the parallel loop may pick up another gemm, so a
+    // parallel call cannot share its B panel through the thread's buffers
+    std::vector<T> ownB;
+    std::vector<T>& packedB = parallel ? ownB : packBuffers<T>().b;
+    packedB.resize(KC * ((std::min(n, NC) + nr - 1) / nr * nr));
+
+    for (size_t jc = 0; jc < n; jc += NC) {
+        size_t nc = std::min(NC, n - jc);
+        size_t panels = (nc + nr - 1) / nr;
+        for (size_t pc = 0; pc < k; pc += KC) {
+            size_t kc = std::min(KC, k - pc);
+            packB(b, pc, kc, jc, nc, nr, packedB.data());
+
+            // Output tiles: MC-row blocks of each sample's A times groups of B
+            // micro-panels. Each tile packs its own A block on whichever
+            // thread runs it.
+            size_t rowBlocks = batch * ((m + MC - 1) / MC);
+            size_t groupPanels = panels;
+            if (parallel) {
+                size_t wanted = 4 * pool.threadCount(); // Enough tiles to balance
+                size_t groups = std::min(panels, (wanted + rowBlocks - 1) / rowBlocks);
+                groupPanels = (panels + groups - 1) / groups;
+            }
+            size_t groups = (panels + groupPanels - 1) / groupPanels;
+
+            auto runTiles = [&](size_t begin, size_t end) {
+                std::vector<T>& packedA = packBuffers<T>().a;
+                packedA.resize(MC * KC);
+                T edge[MAX_TILE]; // Partial tiles are computed here, then added to C
+                size_t sampleBlocks = rowBlocks / batch;
+                for (size_t tile = begin; tile < end; ++tile) {
+                    size_t sample = tile / groups / sampleBlocks;
+                    size_t ic = (tile / groups % sampleBlocks) * MC;
+                    size_t mc = std::min(MC, m - ic);
+                    size_t firstPanel = (tile % groups) * groupPanels;
+                    size_t lastPanel = std::min(panels, firstPanel + groupPanels);
+                    StridedMatrix<S> sampleA{a.data + static_cast<ptrdiff_t>(sample) * aBatch, a.rowStride, a.colStride};
+                    T* sampleC = c + sample * cBatch;
+                    packA(sampleA, ic, mc, pc, kc, mr, packedA.data());
+
+                    for (size_t jr = firstPanel * nr; jr < lastPanel * nr; jr += nr) {
+                        size_t cols = std::min(nr, nc - jr);
+                        const T* panelB = packedB.data() + jr * kc;
+                        for (size_t ir = 0; ir < mc; ir += mr) {
+                            size_t rows = std::min(mr, mc - ir);
+                            const T* panelA = packedA.data() + ir * kc;
+                            T* out = sampleC + (ic + ir) * ldc + jc + jr;
+                            if (rows == mr && cols == nr) {
+                                kern.run(kc, panelA, panelB, out, ldc);
+                                continue;
+                            }
+                            std::fill(edge, edge + mr * nr, T(0));
+                            kern.run(kc, panelA, panelB, edge, nr);
+                            for (size_t r = 0; r < rows; ++r) {
+                                for (size_t col = 0; col < cols; ++col) {
+                                    out[r * ldc + col] += edge[r * nr + col];
+                                }
+                            }
+                        }
+                    }
+                }
+            };
+
+            if (parallel) {
+                pool.parallelFor(rowBlocks * groups, 1, runTiles);
+            } else {
+                runTiles(0, rowBlocks * groups);
+            }
+        }
+    }
+}
+
+// A batch with a B per sample: no packed panel is shared, so the samples
+// are spread over the pool as they are, one serial product each, unless
+// there are too few of them to keep every thread busy
+template <typename S, typename T>
+void batchedProducts(size_t batch, size_t m, size_t n, size_t k, StridedMatrix<S> a, ptrdiff_t aBatch,
+                     StridedMatrix<S> b, ptrdiff_t bBatch, T* c, size_t ldc, size_t cBatch) {
+    if (bBatch == 0 || batch == 1) {
+        blockedGemm(batch, m, n, k, a, aBatch, b, c, ldc, cBatch, true);
+        return;
+    }
+    auto runSamples = [&](size_t begin, size_t end, bool mayParallel) {
+        for (size_t s = begin; s < end; ++s) {
+            ptrdiff_t sample = static_cast<ptrdiff_t>(s);
+            StridedMatrix<S> sampleA{a.data + sample * aBatch, a.rowStride, a.colStride};
+            StridedMatrix<S> sampleB{b.data + sample * bBatch, b.rowStride, b.colStride};
+            blockedGemm(1, m, n, k, sampleA, 0, sampleB, c + s * cBatch, ldc, 0, mayParallel);
+        }
+    };
+    ThreadPool& pool = ThreadPool::get();
+    if (pool.threadCount() > 1 && batch >= pool.threadCount() && batch * m * n * k >= PARALLEL_WORK) {
+        pool.parallelFor(batch, 1, [&](size_t begin, size_t end) { runSamples(begin, end, false); });
+    } else {
+        runSamples(0, batch, true);
+    }
+}
+
+} // namespace
+
+const char* gemmKernelName() {
+    return kernel<double>().name;
+}
+
+void gemm(size_t m, size_t n, size_t k, MatrixView a, MatrixView b, double* c, size_t ldc) {
+    blockedGemm(1, m, n, k, a, 0, b, c, ldc, 0, true);
+}
+
+void gemm(size_t m, size_t n, size_t k, StridedMatrix<float> a, StridedMatrix<float> b, float* c, size_t ldc) {
+    blockedGemm(1, m, n, k, a, 0, b, c, ldc, 0, true);
+}
+
+void gemm(size_t m, size_t n, size_t k, StridedMatrix<BFloat16> a, StridedMatrix<BFloat16> b, float* c,
+          size_t ldc) {
+    blockedGemm(1, m, n, k, a, 0, b, c, ldc, 0, true);
+}
+
+void batchedGemm(size_t batch, size_t m, size_t n, size_t k, MatrixView a, ptrdiff_t aBatch, MatrixView b,
+                 ptrdiff_t bBatch, double* c, size_t ldc, size_t cBatch) {
+    batchedProducts(batch, m, n, k, a, aBatch, b, bBatch, c, ldc, cBatch);
+}
+
+void batchedGemm(size_t batch, size_t m, size_t n, size_t k, StridedMatrix<float> a, ptrdiff_t aBatch,
+                 StridedMatrix<float> b, ptrdiff_t bBatch, float* c, size_t ldc, size_t cBatch) {
+    batchedProducts(batch, m, n, k, a, aBatch, b, bBatch, c, ldc, cBatch);
+}
+
+void batchedGemm(size_t batch, size_t m, size_t n, size_t k, StridedMatrix<BFloat16> a, ptrdiff_t aBatch,
+                 StridedMatrix<BFloat16> b, ptrdiff_t bBatch, float* c, size_t ldc, size_t cBatch) {
+    batchedProducts(batch, m, n, k, a, aBatch, b, bBatch, c, ldc, cBatch);
+}
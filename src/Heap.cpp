@@ -0,0 +1,89 @@
+#include "../include/Heap.h"
+#include "../include/Object.h"
+#include <algorithm>
+
+// Step 2: a reference from inside the heap is not a root
+struct Heap::SubtractInternal : GcVisitor {
+    void visit(Object* object) override;
+};
+
+// Step 3: everything reachable from a root survives
+struct Heap::Mark : GcVisitor {
+    std::vector<Object*> pending;
+    void visit(Object* object) override;
+};
+
+void Heap::SubtractInternal::visit(Object* object) {
+    if (object->tracked()) --object->gcRefs;
+}
+
+void Heap::Mark::visit(Object* object) {
+    if (object->tracked() && !object->gcMarked) {
+        object->gcMarked = true;
+        pending.push_back(object);
+    }
+}
+
+void Heap::collect() {
+    auto start = std::chrono::steady_clock::now();
+
+    for (Object* object : objects) {
+        object->gcRefs = static_cast<int32_t>(object->refCount);
+        object->gcMarked = false;
+    }
+
+    SubtractInternal subtract;
+    for (Object* object : objects) {
+        object->trace(subtract);
+    }
+
+    Mark mark;
+    for (Object* object : objects) {
+        if (object->gcRefs > 0 && !object->gcMarked) {
+            object->gcMarked = true;
+            mark.pending.push_back(object);
+        }
+    }
+    while (!mark.pending.empty()) {
+        Object* object = mark.pending.back();
+        mark.pending.pop_back();
+        object->trace(mark);
+    }
+
+    // Step 4: keep the garbage alive while its references are cleared, so
+    // objects inside a cycle are not freed while still being walked.
+    std::vector<Object*> garbage;
+    for (Object* object : objects) {
+        if (!object->gcMarked) garbage.push_back(object);
+    }
+    for (Object* object : garbage) object->retain();
+    for (Object* object : garbage) object->clearReferences();
+    for (Object* object : garbage) object->release();
+
+    totalFreedByCollector += garbage.size();
+    allocatedSinceCollect = 0;
+    threshold = std::max(MIN_THRESHOLD, objects.size());
+
+    auto pause = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    ++collections;
+    totalPause += pause;
+    maxPause = std::max(maxPause, pause);
+}
+
+void Heap::printStats(std::ostream& out) const {
+    size_t bytes = 0;
+    for (const Object* object : objects) {
+        bytes += object->byteSize();
+    }
+    auto ms = [](std::chrono::nanoseconds duration) { return duration.count() / 1e6; };
+
+    out << "[gc] heap: " << objects.size() << " objects, " << bytes << " bytes (peak "
+        << peakObjects << " objects)\n";
+    out << "[gc] allocated: " << totalAllocated << " objects, cycles freed: " << totalFreedByCollector << "\n";
+    out << "[gc] collections: " << collections << ", pause total " << ms(totalPause) << " ms, max "
+        << ms(maxPause) << " ms";
+    if (collections > 0) {
+        out << ", mean " << ms(totalPause) / collections << " ms";
+    }
+    out << "\n";
+}
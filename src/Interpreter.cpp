@@ -3,18 +3,25 @@
 #include "../include/TrollArray.h"
 #include "../include/TrollInstance.h"
 #include "../include/TrollModel.h"
-#include "../include/Return.h"
+#include "../include/Operators.h"
+#include "../include/Builtins.h"
+#include "../include/NativeFunction.h"
 #include <iostream>
 #include <cmath>
 
 Interpreter::Interpreter() {
-    environment = std::make_shared<Environment>();
+    globals = makeRef<Environment>();
+    environment = globals.get();
+    for (auto& builtin : builtins()) {
+        globals->define(builtin.first, std::move(builtin.second));
+    }
 }
 
 void Interpreter::interpret(const std::vector<std::shared_ptr<Stmt>>& statements) {
     try {
         for (const auto& stmt : statements) {
             execute(stmt);
+            if (returning) break; // Top-level return ends the script
         }
     } catch (RuntimeError& error) {
         std::cerr << error.what() << "\n[line " << error.token.line << "]\n";
@@ -26,165 +33,95 @@ RuntimeValue Interpreter::evaluate(std::shared_ptr<Expr> expr) {
 }
 
 void Interpreter::execute(std::shared_ptr<Stmt> stmt) {
+    Heap::get().maybeCollect(); // Statement boundaries are GC safe points
     stmt->accept(this);
 }
 
-void Interpreter::executeBlock(const std::vector<std::shared_ptr<Stmt>>& statements, std::shared_ptr<Environment> env) {
-    std::shared_ptr<Environment> previous = this->environment;
-    this->environment = env;
+namespace {
+// Restores the current environment on every exit path, including a
+// RuntimeError unwinding through the block.
+struct EnvironmentGuard {
+    Environment*& current;
+    Environment* previous;
 
-    try {
-        for (const auto& stmt : statements) {
-            execute(stmt);
-        }
-    } catch (...) {
-        this->environment = previous;
-        throw;
+    EnvironmentGuard(Environment*& current, Environment* next) : current(current), previous(current) {
+        current = next;
+    }
+    ~EnvironmentGuard() {
+        current = previous;
+    }
+};
+}
+
+void Interpreter::executeBlock(const std::vector<std::shared_ptr<Stmt>>& statements, Environment* env) {
+    EnvironmentGuard guard(this->environment, env);
+
+    for (const auto& stmt : statements) {
+        execute(stmt);
+        if (returning) return;
     }
+}
 
-    this->environment = previous;
+RuntimeValue Interpreter::takeReturnValue() {
+    if (!returning) return RuntimeValue(std::monostate{});
+    returning = false;
+    return std::move(returnValue);
 }
 
 // Visitors
 
 std::any Interpreter::visitLiteralExpr(std::shared_ptr<LiteralExpr> expr) {
-    if (std::holds_alternative<int>(expr->value)) {
-        return RuntimeValue(static_cast<double>(std::get<int>(expr->value))); // Treat ints as doubles runtime
+    return expr->constant;
+}
+
+std::any Interpreter::visitVariableExpr(std::shared_ptr<VariableExpr> expr) {
+    if (expr->depth < 0) {
+        return globals->get(expr->name);
     }
-    if (std::holds_alternative<double>(expr->value)) {
-        return RuntimeValue(std::get<double>(expr->value));
+    if (expr->method) {
+        return bindMethod(environment->getAt(expr->depth, expr->slot), environment->ancestor(expr->depth));
     }
-    if (std::holds_alternative<std::string>(expr->value)) {
-        return RuntimeValue(std::get<std::string>(expr->value));
+    const RuntimeValue& value = environment->getAt(expr->depth, expr->slot);
+    if (!value.isUndefined()) {
+        return value;
     }
-    if (std::holds_alternative<bool>(expr->value)) {
-        return RuntimeValue(std::get<bool>(expr->value));
+    // The let of the slot has not run yet; see VariableExpr::fallbacks
+    if (RuntimeValue* outer = environment->firstDefined(expr->fallbacks)) {
+        return *outer;
     }
-    return RuntimeValue(std::monostate{}); // Nil
-}
-
-std::any Interpreter::visitVariableExpr(std::shared_ptr<VariableExpr> expr) {
-    return environment->get(expr->name);
+    if (expr->globalFallback) {
+        return globals->get(expr->name);
+    }
+    return RuntimeValue(); // A hoisted function called ahead of a let it follows
 }
 
 std::any Interpreter::visitBinaryExpr(std::shared_ptr<BinaryExpr> expr) {
     RuntimeValue left = evaluate(expr->left);
     RuntimeValue right = evaluate(expr->right);
-
-    switch (expr->op.type) {
-        case TokenType::MINUS:
-            checkNumberOperands(expr->op, left, right);
-            return RuntimeValue(std::get<double>(left) - std::get<double>(right));
-        case TokenType::PLUS:
-            if (std::holds_alternative<double>(left) && std::holds_alternative<double>(right)) {
-                return RuntimeValue(std::get<double>(left) + std::get<double>(right));
-            }
-            if (std::holds_alternative<std::string>(left) && std::holds_alternative<std::string>(right)) {
-                return RuntimeValue(std::get<std::string>(left) + std::get<std::string>(right));
-            }
-             throw RuntimeError(expr->op, "Operands must be two numbers or two strings.");
-        case TokenType::SLASH:
-            checkNumberOperands(expr->op, left, right);
-            return RuntimeValue(std::get<double>(left) / std::get<double>(right));
-        case TokenType::STAR:
-            checkNumberOperands(expr->op, left, right);
-            return RuntimeValue(std::get<double>(left) * std::get<double>(right));
-        case TokenType::GREATER:
-            checkNumberOperands(expr->op, left, right);
-            return RuntimeValue(std::get<double>(left) > std::get<double>(right));
-        case TokenType::GREATER_EQUAL:
-            checkNumberOperands(expr->op, left, right);
-            return RuntimeValue(std::get<double>(left) >= std::get<double>(right));
-        case TokenType::LESS:
-            checkNumberOperands(expr->op, left, right);
-            return RuntimeValue(std::get<double>(left) < std::get<double>(right));
-        case TokenType::LESS_EQUAL:
-            checkNumberOperands(expr->op, left, right);
-            return RuntimeValue(std::get<double>(left) <= std::get<double>(right));
-        case TokenType::AT:
-            // Matrix Multiplication
-            if (std::holds_alternative<std::shared_ptr<TrollArray>>(left) && std::holds_alternative<std::shared_ptr<TrollArray>>(right)) {
-                 // Simplified MatMul implementation
-                 // Assuming 2D matrices of doubles for now.
-                 // Real implementation would need comprehensive error checking and support for 1D/Tensor ops.
-                 auto lArr = std::get<std::shared_ptr<TrollArray>>(left);
-                 auto rArr = std::get<std::shared_ptr<TrollArray>>(right);
-                 
-                 // Implement MatMul Logic here (basic naive O(n^3))
-                 // Rows of Left
-                 size_t rowsL = lArr->elements.size();
-                 if (rowsL == 0) throw RuntimeError(expr->op, "Empty matrix.");
-
-                 // Check Left[0] to see if it's 2D
-                 if (!std::holds_alternative<std::shared_ptr<TrollArray>>(lArr->elements[0])) {
-                     throw RuntimeError(expr->op, "MatMul only supports 2D matrices for now.");
-                 }
-                 auto lRow0 = std::get<std::shared_ptr<TrollArray>>(lArr->elements[0]);
-                 size_t colsL = lRow0->elements.size();
-
-                 // Rows of Right
-                 size_t rowsR = rArr->elements.size();
-                 if (rowsR != colsL) throw RuntimeError(expr->op, "Matrix dimensions mismatch.");
-
-                 // Check Right[0]
-                 if (rowsR == 0) throw RuntimeError(expr->op, "Empty matrix.");
-                 if (!std::holds_alternative<std::shared_ptr<TrollArray>>(rArr->elements[0])) {
-                      throw RuntimeError(expr->op, "MatMul only supports 2D matrices for now.");
-                 }
-                 auto rRow0 = std::get<std::shared_ptr<TrollArray>>(rArr->elements[0]);
-                 size_t colsR = rRow0->elements.size();
-
-                 // Result Matrix: rowsL x colsR
-                 std::vector<RuntimeValue> resRows;
-                 
-                 for (size_t i = 0; i < rowsL; ++i) {
-                     std::vector<RuntimeValue> newRow;
-                     for (size_t j = 0; j < colsR; ++j) {
-                         double sum = 0.0;
-                         for (size_t k = 0; k < colsL; ++k) {
-                             // Val A = Left[i][k]
-                             auto rowVal = std::get<std::shared_ptr<TrollArray>>(lArr->elements[i]);
-                             double valA = std::get<double>(rowVal->elements[k]);
-                             
-                             // Val B = Right[k][j]
-                             auto colVal = std::get<std::shared_ptr<TrollArray>>(rArr->elements[k]);
-                             double valB = std::get<double>(colVal->elements[j]);
-
-                             sum += valA * valB;
-                         }
-                         newRow.push_back(RuntimeValue(sum));
-                     }
-                     resRows.push_back(std::make_shared<TrollArray>(newRow)); // Row is Array
-                 }
-                 return RuntimeValue(std::make_shared<TrollArray>(resRows));
-            }
-            throw RuntimeError(expr->op, "MatMul operator '@' requires two TrollArray operands.");
-        case TokenType::BANG_EQUAL:
-            return RuntimeValue(!isEqual(left, right));
-        case TokenType::EQUAL_EQUAL:
-            return RuntimeValue(isEqual(left, right));
-        default:
-            return RuntimeValue(std::monostate{});
-    }
+    return binaryOp(expr->op, left, right);
 }
 
 std::any Interpreter::visitUnaryExpr(std::shared_ptr<UnaryExpr> expr) {
     RuntimeValue right = evaluate(expr->right);
-
-    switch (expr->op.type) {
-        case TokenType::MINUS:
-            checkNumberOperand(expr->op, right);
-            return RuntimeValue(-std::get<double>(right));
-        case TokenType::BANG:
-            return RuntimeValue(!isTruthy(right));
-        default:
-            return RuntimeValue(std::monostate{});
-    }
+    return unaryOp(expr->op, right);
 }
 
 std::any Interpreter::visitAssignmentExpr(std::shared_ptr<AssignmentExpr> expr) {
     RuntimeValue value = evaluate(expr->value);
-    environment->assign(expr->name, value);
+    if (expr->depth < 0) {
+        globals->assign(expr->name, value);
+    } else if ((expr->globalFallback || !expr->fallbacks.empty()) &&
+               environment->getAt(expr->depth, expr->slot).isUndefined()) {
+        if (RuntimeValue* outer = environment->firstDefined(expr->fallbacks)) {
+            *outer = value;
+        } else if (expr->globalFallback) {
+            globals->assign(expr->name, value);
+        } else {
+            environment->assignAt(expr->depth, expr->slot, value);
+        }
+    } else {
+        environment->assignAt(expr->depth, expr->slot, value);
+    }
     return value;
 }
 
@@ -204,12 +141,20 @@ std::any Interpreter::visitLetStmt(std::shared_ptr<LetStmt> stmt) {
     if (stmt->initializer != nullptr) {
         value = evaluate(stmt->initializer);
     }
-    environment->define(stmt->name.lexeme, value);
+    define(stmt->slot, stmt->name.lexeme, std::move(value));
     return std::any();
 }
 
 std::any Interpreter::visitBlockStmt(std::shared_ptr<BlockStmt> stmt) {
-    executeBlock(stmt->statements, std::make_shared<Environment>(environment));
+    if (stmt->captured) {
+        auto env = makeRef<Environment>(Ref<Environment>(environment), stmt->localCount, RuntimeValue::undefined());
+        executeBlock(stmt->statements, env.get());
+        return std::any();
+    }
+
+    ArenaFrame frame(arena, stmt->localCount);
+    Environment env(environment, frame.data());
+    executeBlock(stmt->statements, &env);
     return std::any();
 }
 
@@ -228,35 +173,70 @@ std::any Interpreter::visitLogicalExpr(std::shared_ptr<LogicalExpr> expr) {
 }
 
 std::any Interpreter::visitCallExpr(std::shared_ptr<CallExpr> expr) {
-    RuntimeValue callee = evaluate(expr->callee);
+    // A method called straight off its receiver runs in the receiver's
+    // Environment without materializing a bound copy.
+    RuntimeValue receiver; // Keeps the instance alive during the call
+    Environment* receiverEnv = nullptr;
+    RuntimeValue callee;
+    if (!expr->hasReceiver) {
+        callee = evaluate(expr->callee);
+    } else if (auto get = dynamic_cast<GetExpr*>(expr->callee.get())) {
+        receiver = evaluate(get->object);
+        if (!receiver.isInstance()) {
+            throw RuntimeError(get->name, "Only instances have properties.");
+        }
+        TrollInstance* instance = receiver.asInstance();
+        callee = instance->get(get->name, get->cache);
+        receiverEnv = instance->env.get();
+    } else {
+        auto variable = static_cast<VariableExpr*>(expr->callee.get());
+        receiverEnv = environment->ancestor(variable->depth);
+        callee = receiverEnv->slots[variable->slot];
+    }
+
+    // Script functions get their arguments evaluated straight into the callee's slots
+    if (callee.isCallable()) {
+        auto* function = dynamic_cast<TrollFunction*>(callee.asCallable());
+        if (function && function->declaration->params.size() == expr->arguments.size()) {
+            Environment* parent = function->isMethod ? receiverEnv : function->closure.get();
+            if (expr->tail) {
+                prepareTailCall(std::move(callee), parent, expr->arguments);
+                return RuntimeValue(std::monostate{});
+            }
+            return callFunction(function, parent, expr->arguments);
+        }
+    }
 
     std::vector<RuntimeValue> arguments;
     for (const auto& argument : expr->arguments) {
         arguments.push_back(evaluate(argument));
     }
 
-    if (!std::holds_alternative<std::shared_ptr<Callable>>(callee)) {
+    if (!callee.isCallable()) {
         throw RuntimeError(expr->paren, "Can only call functions and classes.");
     }
 
-    std::shared_ptr<Callable> function = std::get<std::shared_ptr<Callable>>(callee);
+    Callable* function = callee.asCallable();
 
-    if (arguments.size() != function->arity()) {
-        throw RuntimeError(expr->paren, "Expected " + 
-            std::to_string(function->arity()) + " arguments but got " + 
-            std::to_string(arguments.size()) + ".");
+    std::string mismatch = arityMismatch(function, arguments.size());
+    if (!mismatch.empty()) {
+        throw RuntimeError(expr->paren, mismatch);
     }
 
-    return function->call(this, arguments);
+    try {
+        return function->call(this, arguments);
+    } catch (NativeError& error) {
+        throw RuntimeError(expr->paren, error.what());
+    }
 }
 
 std::any Interpreter::visitGetExpr(std::shared_ptr<GetExpr> expr) {
     RuntimeValue object = evaluate(expr->object);
-    if (std::holds_alternative<std::shared_ptr<TrollInstance>>(object)) {
-        return std::get<std::shared_ptr<TrollInstance>>(object)->get(expr->name);
+    if (object.isInstance()) {
+        TrollInstance* instance = object.asInstance();
+        return bindMethod(instance->get(expr->name, expr->cache), instance->env.get());
     }
-
-    throw RuntimeError(expr->name, "Only instances have properties.");
+    return propertyGet(expr->name, object);
 }
 
 std::any Interpreter::visitArrayLiteralExpr(std::shared_ptr<ArrayLiteralExpr> expr) {
@@ -264,7 +244,7 @@ std::any Interpreter::visitArrayLiteralExpr(std::shared_ptr<ArrayLiteralExpr> ex
     for (const auto& el : expr->elements) {
         elements.push_back(evaluate(el));
     }
-    return RuntimeValue(std::make_shared<TrollArray>(elements));
+    return arrayLiteral(std::move(elements));
 }
 
 std::any Interpreter::visitIfStmt(std::shared_ptr<IfStmt> stmt) {
@@ -279,13 +259,14 @@ std::any Interpreter::visitIfStmt(std::shared_ptr<IfStmt> stmt) {
 std::any Interpreter::visitWhileStmt(std::shared_ptr<WhileStmt> stmt) {
     while (isTruthy(evaluate(stmt->condition))) {
         execute(stmt->body);
+        if (returning) break;
     }
     return std::any();
 }
 
 std::any Interpreter::visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt) {
-    auto function = std::make_shared<TrollFunction>(stmt, environment);
-    environment->define(stmt->name.lexeme, RuntimeValue(function));
+    auto function = makeRef<TrollFunction>(stmt, Ref<Environment>(environment));
+    define(stmt->slot, stmt->name.lexeme, RuntimeValue(function));
     return std::any();
 }
 
@@ -295,45 +276,111 @@ std::any Interpreter::visitReturnStmt(std::shared_ptr<ReturnStmt> stmt) {
         value = evaluate(stmt->value);
     }
 
-    throw Return(value);
+    returnValue = std::move(value);
+    returning = true;
+    return std::any();
 }
 
 std::any Interpreter::visitModelStmt(std::shared_ptr<ModelStmt> stmt) {
-    auto model = std::make_shared<TrollModel>(stmt, environment);
-    environment->define(stmt->name.lexeme, RuntimeValue(model));
+    auto model = makeRef<TrollModel>(stmt, Ref<Environment>(environment));
+    for (const auto& member : stmt->methods) {
+        if (auto function = std::dynamic_pointer_cast<FunctionStmt>(member)) {
+            auto method = makeRef<TrollFunction>(function, nullptr);
+            method->isMethod = true;
+            model->methods.emplace_back(stmt->fieldSlots[function->name.lexeme], RuntimeValue(method));
+        }
+    }
+    define(stmt->slot, stmt->name.lexeme, RuntimeValue(model));
     return std::any();
 }
 
 // Helpers
 
-bool Interpreter::isTruthy(const RuntimeValue& value) {
-    if (std::holds_alternative<std::monostate>(value)) return false;
-    if (std::holds_alternative<bool>(value)) return std::get<bool>(value);
-    return true;
+// Frames of functions that declare no closures live in the arena; the others
+// need a heap Environment that their closures can keep alive.
+template <typename ArgumentAt>
+void Interpreter::runFrame(TrollFunction* function, Environment* parent, size_t argumentCount, ArgumentAt argumentAt) {
+    const FunctionStmt& declaration = *function->declaration;
+    if (declaration.captured) {
+        auto env = makeRef<Environment>(Ref<Environment>(parent), declaration.localCount, RuntimeValue::undefined());
+        for (size_t i = 0; i < argumentCount; ++i) {
+            env->slots[i] = argumentAt(i);
+        }
+        executeBlock(declaration.body, env.get());
+        return;
+    }
+
+    ArenaFrame frame(arena, declaration.localCount);
+    for (size_t i = 0; i < argumentCount; ++i) {
+        frame.data()[i] = argumentAt(i);
+    }
+    Environment env(parent, frame.data());
+    executeBlock(declaration.body, &env);
 }
 
-bool Interpreter::isEqual(const RuntimeValue& a, const RuntimeValue& b) {
-    // Simplified equality
-    if (a.index() != b.index()) return false;
-    if (std::holds_alternative<double>(a)) return std::get<double>(a) == std::get<double>(b);
-    if (std::holds_alternative<bool>(a)) return std::get<bool>(a) == std::get<bool>(b);
-    if (std::holds_alternative<std::string>(a)) return std::get<std::string>(a) == std::get<std::string>(b);
-    return true; // nil == nil
+// A tail call left pending by the body runs here, after the caller's frame
+// is gone, so tail recursion uses constant native stack and arena space.
+template <typename ArgumentAt>
+RuntimeValue Interpreter::invoke(TrollFunction* function, Environment* parent, size_t argumentCount, ArgumentAt argumentAt) {
+    runFrame(function, parent, argumentCount, argumentAt);
+    while (tailCalling) {
+        tailCalling = false;
+        returning = false;
+        RuntimeValue callee = std::move(tailCallee);
+        Ref<Environment> calleeParent = std::move(tailParent);
+        runFrame(static_cast<TrollFunction*>(callee.asCallable()), calleeParent.get(), tailArguments.size(),
+                 [&](size_t i) { return std::move(tailArguments[i]); });
+    }
+    return takeReturnValue();
 }
 
-void Interpreter::checkNumberOperand(const Token& operatorToken, const RuntimeValue& operand) {
-    if (std::holds_alternative<double>(operand)) return;
-    throw RuntimeError(operatorToken, "Operand must be a number.");
+// Arguments are evaluated into scratch arena slots first: a nested call among
+// them may leave its own tail call in tailArguments.
+void Interpreter::prepareTailCall(RuntimeValue callee, Environment* parent, const std::vector<std::shared_ptr<Expr>>& arguments) {
+    ArenaFrame scratch(arena, arguments.size());
+    for (size_t i = 0; i < arguments.size(); ++i) {
+        scratch.data()[i] = evaluate(arguments[i]);
+    }
+    tailArguments.assign(std::make_move_iterator(scratch.data()),
+                         std::make_move_iterator(scratch.data() + arguments.size()));
+    tailCallee = std::move(callee);
+    tailParent = Ref<Environment>(parent);
+    tailCalling = true;
+}
+
+RuntimeValue Interpreter::callFunction(TrollFunction* function, Environment* parent, const std::vector<std::shared_ptr<Expr>>& arguments) {
+    return invoke(function, parent, arguments.size(), [&](size_t i) { return evaluate(arguments[i]); });
+}
+
+RuntimeValue Interpreter::callFunction(TrollFunction* function, const std::vector<RuntimeValue>& arguments) {
+    return invoke(function, function->closure.get(), arguments.size(), [&](size_t i) { return arguments[i]; });
 }
 
-void Interpreter::checkNumberOperands(const Token& operatorToken, const RuntimeValue& left, const RuntimeValue& right) {
-    if (std::holds_alternative<double>(left) && std::holds_alternative<double>(right)) return;
-    throw RuntimeError(operatorToken, "Operands must be numbers.");
+void Interpreter::define(int slot, const std::string& name, RuntimeValue value) {
+    if (slot >= 0) {
+        environment->defineAt(slot, std::move(value));
+    } else {
+        environment->define(name, std::move(value));
+    }
 }
 
 std::any Interpreter::visitIndexExpr(std::shared_ptr<IndexExpr> expr) {
-    throw std::runtime_error("Not implemented in Interpreter");
+    RuntimeValue object = evaluate(expr->object);
+    RuntimeValue index = evaluate(expr->index);
+    return indexGet(expr->bracket, object, index);
 }
+
+std::any Interpreter::visitSliceExpr(std::shared_ptr<SliceExpr> expr) {
+    RuntimeValue object = evaluate(expr->object);
+    RuntimeValue start = expr->start ? evaluate(expr->start) : RuntimeValue();
+    RuntimeValue end = expr->end ? evaluate(expr->end) : RuntimeValue();
+    return sliceGet(expr->bracket, object, start, end);
+}
+
 std::any Interpreter::visitArrayAssignmentExpr(std::shared_ptr<ArrayAssignmentExpr> expr) {
-    throw std::runtime_error("Not implemented in Interpreter");
+    RuntimeValue object = evaluate(expr->object);
+    RuntimeValue index = evaluate(expr->index);
+    RuntimeValue value = evaluate(expr->value);
+    indexSet(expr->bracket, object, index, value);
+    return value;
 }
@@ -2,6 +2,27 @@
 #include <iostream>
 #include <cstdlib>
 
+// Elementwise loops behind troll_array_binary: array-array, array-number
+// and number-array, each vectorized and cloned per instruction set.
+template <int Op>
+static inline double troll_apply(double x, double y) {
+    return Op == 0 ? x + y : Op == 1 ? x - y : Op == 2 ? x * y : x / y;
+}
+
+template <int Op>
+__attribute__((target_clones("avx512f", "avx2", "default"), optimize("vect-cost-model=dynamic")))
+static void troll_elementwise(const double* a, bool aScalar, const double* b, bool bScalar, double* __restrict out, size_t n) {
+    if (aScalar) {
+        const double x = *a;
+        for (size_t i = 0; i < n; ++i) out[i] = troll_apply<Op>(x, b[i]);
+    } else if (bScalar) {
+        const double y = *b;
+        for (size_t i = 0; i < n; ++i) out[i] = troll_apply<Op>(a[i], y);
+    } else {
+        for (size_t i = 0; i < n; ++i) out[i] = troll_apply<Op>(a[i], b[i]);
+    }
+}
+
 extern "C" {
     // Check if we need to export these symbols explicitly for dynamic linking, 
     // but for static linking (linking .o files), this is fine.
@@ -62,6 +83,35 @@ extern "C" {
          std::cout << "]\n";
     }
 
+    // op: 0 add, 1 sub, 2 mul, 3 div. Either side may be a number (type 0)
+    // broadcast over the other; two arrays must have equal lengths.
+    void* troll_array_binary(int op, int ltype, double lnum, void* lptr, int rtype, double rnum, void* rptr) {
+        auto* left = ltype == 1 ? static_cast<std::vector<double>*>(lptr) : nullptr;
+        auto* right = rtype == 1 ? static_cast<std::vector<double>*>(rptr) : nullptr;
+        if ((ltype == 1 && !left) || (rtype == 1 && !right)) {
+             std::cerr << "Runtime Error: Null pointer access\n";
+             exit(1);
+        }
+        if (left && right && left->size() != right->size()) {
+            std::cerr << "Runtime Error: Operand lengths " << left->size() << " and " << right->size()
+                      << " cannot be broadcast together\n";
+            exit(1);
+        }
+        size_t n = left ? left->size() : right->size();
+        auto* result = new std::vector<double>(n);
+        const double* a = left ? left->data() : &lnum;
+        const double* b = right ? right->data() : &rnum;
+        bool aScalar = !left;
+        bool bScalar = !right;
+        switch (op) {
+            case 0: troll_elementwise<0>(a, aScalar, b, bScalar, result->data(), n); break;
+            case 1: troll_elementwise<1>(a, aScalar, b, bScalar, result->data(), n); break;
+            case 2: troll_elementwise<2>(a, aScalar, b, bScalar, result->data(), n); break;
+            default: troll_elementwise<3>(a, aScalar, b, bScalar, result->data(), n); break;
+        }
+        return static_cast<void*>(result);
+    }
+
     void troll_print_value(int type, double num, void* ptr) {
         if (type == 0) { // Number
             std::cout << num << "\n";
@@ -0,0 +1,286 @@
+#include "../include/Lazy.h"
+#include "../include/ThreadPool.h"
+#include <algorithm>
+#include <unordered_map>
+
+static bool lazyEnabled = false;
+
+void setLazyTensors(bool enabled) {
+    lazyEnabled = enabled;
+}
+
+bool lazyTensors() {
+    return lazyEnabled;
+}
+
+namespace {
+
+constexpr size_t MAX_FUSED = 32;      // Nodes per fused group; bigger operands are evaluated first
+constexpr size_t RUN = 512;           // Outputs per step of a fused pass, so temporaries stay in L1
+
+// Buffers that may still be pending, for forcePendingTensors
+std::vector<std::weak_ptr<TensorBuffer>> pendingBuffers;
+
+std::vector<ptrdiff_t> rowMajorStrides(const std::vector<size_t>& shape) {
+    std::vector<ptrdiff_t> strides(shape.size());
+    ptrdiff_t stride = 1;
+    for (size_t d = shape.size(); d-- > 0;) {
+        strides[d] = stride;
+        stride *= static_cast<ptrdiff_t>(shape[d]);
+    }
+    return strides;
+}
+
+size_t elementCount(const std::vector<size_t>& shape) {
+    size_t count = 1;
+    for (size_t extent : shape) count *= extent;
+    return count;
+}
+
+Ref<TrollTensor> leafTensor(const LazyExpr& leaf) {
+    return makeRef<TrollTensor>(leaf.buffer, leaf.offset, leaf.shape, leaf.strides);
+}
+
+// A fused group as straight-line steps, each producing one run of values.
+// Leaves and numbers are read in place through strides over the output
+// shape (0 along broadcast dimensions); computed steps write scratch.
+struct Step {
+    LazyExpr::Kind kind;
+    ElementOp op;
+    ElementFunction function;
+    int left = -1; // Earlier steps
+    int right = -1;
+    const double* data = nullptr;
+    std::vector<ptrdiff_t> strides;
+};
+
+class FusedPass {
+public:
+    explicit FusedPass(const std::vector<size_t>& shape) : shape(shape) {}
+
+    // Steps for node and its operands; shared nodes are computed once
+    int add(LazyExpr& node) {
+        auto found = seen.find(&node);
+        if (found != seen.end()) return found->second;
+
+        Step step;
+        step.kind = node.kind;
+        step.op = node.op;
+        step.function = node.function;
+        switch (node.kind) {
+            case LazyExpr::Kind::MatMul: {
+                // Products are not fused: compute one, and share the result
+                auto result = std::make_shared<TensorBuffer>(elementCount(node.shape));
+                matmul(*leafTensor(*node.left), *leafTensor(*node.right), result->data());
+                node.becomeLeaf(std::move(result));
+                step.kind = LazyExpr::Kind::Leaf;
+                step.data = node.buffer->data() + node.offset;
+                step.strides = Operand::of(step.data, node.shape, node.strides, shape).strides;
+                break;
+            }
+            case LazyExpr::Kind::Leaf:
+                step.data = node.buffer->data() + node.offset;
+                step.strides = Operand::of(step.data, node.shape, node.strides, shape).strides;
+                break;
+            case LazyExpr::Kind::Number:
+                step.data = &node.number;
+                step.strides.assign(shape.size(), 0);
+                break;
+            case LazyExpr::Kind::Elementwise:
+                step.left = add(*node.left);
+                step.right = add(*node.right);
+                break;
+            case LazyExpr::Kind::Function:
+                step.left = add(*node.left);
+                break;
+        }
+        steps.push_back(std::move(step));
+        int index = static_cast<int>(steps.size()) - 1;
+        seen[&node] = index;
+        return index;
+    }
+
+    void run(double* out) {
+        size_t count = elementCount(shape);
+        if (count == 0) return;
+        size_t inner = shape.empty() ? 1 : shape.back();
+
+        auto runRange = [&](size_t begin, size_t end) {
+            std::vector<double> scratch(steps.size() * RUN);
+            std::vector<const double*> values(steps.size());
+            std::vector<ptrdiff_t> strides(steps.size());
+            std::vector<size_t> index(shape.empty() ? 0 : shape.size() - 1);
+            for (size_t i = begin; i < end;) {
+                size_t row = i / inner;
+                size_t col = i % inner;
+                size_t length = std::min({inner - col, end - i, RUN});
+                for (size_t d = index.size(); d-- > 0;) {
+                    index[d] = row % shape[d];
+                    row /= shape[d];
+                }
+
+                for (size_t k = 0; k < steps.size(); ++k) {
+                    const Step& step = steps[k];
+                    double* target = k + 1 == steps.size() ? out + i : scratch.data() + k * RUN;
+                    switch (step.kind) {
+                        case LazyExpr::Kind::Elementwise:
+                            elementwiseRun(step.op, values[step.left], strides[step.left],
+                                           values[step.right], strides[step.right], target, length);
+                            values[k] = target;
+                            strides[k] = 1;
+                            break;
+                        case LazyExpr::Kind::Function:
+                            mapRun(step.function, values[step.left], strides[step.left], target, length);
+                            values[k] = target;
+                            strides[k] = 1;
+                            break;
+                        default: {
+                            ptrdiff_t inStride = step.strides.empty() ? 0 : step.strides.back();
+                            ptrdiff_t offset = static_cast<ptrdiff_t>(col) * inStride;
+                            for (size_t d = 0; d < index.size(); ++d) {
+                                offset += static_cast<ptrdiff_t>(index[d]) * step.strides[d];
+                            }
+                            values[k] = step.data + offset;
+                            strides[k] = inStride;
+                            if (k + 1 == steps.size()) {
+                                for (size_t j = 0; j < length; ++j) target[j] = values[k][static_cast<ptrdiff_t>(j) * inStride];
+                            }
+                            break;
+                        }
+                    }
+                }
+                i += length;
+            }
+        };
+
+        ThreadPool::forEach(count, 1, runRange);
+    }
+
+private:
+    const std::vector<size_t>& shape;
+    std::vector<Step> steps;
+    std::unordered_map<const LazyExpr*, int> seen;
+};
+
+void evaluate(LazyExpr& root, double* out) {
+    if (root.kind == LazyExpr::Kind::MatMul) {
+        matmul(*leafTensor(*root.left), *leafTensor(*root.right), out);
+        return;
+    }
+    FusedPass pass(root.shape);
+    pass.add(root);
+    pass.run(out);
+}
+
+} // namespace
+
+void TensorBuffer::materialize() const {
+    std::shared_ptr<LazyExpr> pendingExpression = std::move(expression);
+    expression.reset();
+    values = TensorAllocator::allocate(bytes());
+    evaluate(*pendingExpression, static_cast<double*>(values));
+    pendingExpression->becomeLeaf(std::const_pointer_cast<TensorBuffer>(shared_from_this()));
+}
+
+LazyExpr::~LazyExpr() {
+    if (buffer) --buffer->lazyReaders;
+}
+
+std::shared_ptr<LazyExpr> LazyExpr::leaf(std::shared_ptr<TensorBuffer> buffer, size_t offset,
+                                         std::vector<size_t> shape, std::vector<ptrdiff_t> strides) {
+    auto node = std::make_shared<LazyExpr>();
+    node->kind = Kind::Leaf;
+    node->shape = std::move(shape);
+    node->buffer = std::move(buffer);
+    node->offset = offset;
+    node->strides = std::move(strides);
+    ++node->buffer->lazyReaders;
+    return node;
+}
+
+std::shared_ptr<LazyExpr> LazyExpr::constant(double value) {
+    auto node = std::make_shared<LazyExpr>();
+    node->kind = Kind::Number;
+    node->number = value;
+    return node;
+}
+
+std::shared_ptr<LazyExpr> LazyExpr::elementwise(ElementOp op, std::shared_ptr<LazyExpr> left,
+                                                std::shared_ptr<LazyExpr> right, std::vector<size_t> shape) {
+    auto node = std::make_shared<LazyExpr>();
+    node->kind = Kind::Elementwise;
+    node->op = op;
+    node->left = std::move(left);
+    node->right = std::move(right);
+    node->shape = std::move(shape);
+    node->nodes = 1 + node->left->nodes + node->right->nodes;
+    return node;
+}
+
+std::shared_ptr<LazyExpr> LazyExpr::map(ElementFunction function, std::shared_ptr<LazyExpr> operand) {
+    auto node = std::make_shared<LazyExpr>();
+    node->kind = Kind::Function;
+    node->function = function;
+    node->shape = operand->shape;
+    node->nodes = 1 + operand->nodes;
+    node->left = std::move(operand);
+    return node;
+}
+
+void LazyExpr::becomeLeaf(std::shared_ptr<TensorBuffer> result) {
+    kind = Kind::Leaf;
+    left.reset();
+    right.reset();
+    nodes = 1;
+    buffer = std::move(result);
+    ++buffer->lazyReaders;
+    offset = 0;
+    strides = rowMajorStrides(shape);
+}
+
+std::shared_ptr<LazyExpr> lazyOperand(const TrollTensor& tensor) {
+    const std::shared_ptr<LazyExpr>& pending = tensor.buffer->pending();
+    if (pending && tensor.offset == 0 && tensor.shape == pending->shape &&
+        tensor.strides == rowMajorStrides(tensor.shape) && pending->nodes < MAX_FUSED) {
+        return pending;
+    }
+    // Leaves only ever read computed buffers, which keeps chains of
+    // pending tensors (a loop accumulating into one) from growing
+    tensor.buffer->data();
+    return LazyExpr::leaf(tensor.buffer, tensor.offset, tensor.shape, tensor.strides);
+}
+
+Ref<TrollTensor> lazyTensor(std::shared_ptr<LazyExpr> expression) {
+    std::vector<size_t> shape = expression->shape;
+    auto buffer = std::make_shared<TensorBuffer>(elementCount(shape), std::move(expression));
+    if (pendingBuffers.size() >= 64 && (pendingBuffers.size() & (pendingBuffers.size() - 1)) == 0) {
+        pendingBuffers.erase(std::remove_if(pendingBuffers.begin(), pendingBuffers.end(),
+                                            [](const std::weak_ptr<TensorBuffer>& weak) {
+                                                auto live = weak.lock();
+                                                return !live || !live->pending();
+                                            }),
+                             pendingBuffers.end());
+    }
+    pendingBuffers.push_back(buffer);
+    std::vector<ptrdiff_t> strides = rowMajorStrides(shape);
+    return makeRef<TrollTensor>(std::move(buffer), 0, std::move(shape), std::move(strides));
+}
+
+Ref<TrollTensor> lazyMatmul(const TrollTensor& left, const TrollTensor& right, std::vector<size_t> shape) {
+    auto node = std::make_shared<LazyExpr>();
+    node->kind = LazyExpr::Kind::MatMul;
+    node->shape = std::move(shape);
+    left.buffer->data();
+    right.buffer->data();
+    node->left = LazyExpr::leaf(left.buffer, left.offset, left.shape, left.strides);
+    node->right = LazyExpr::leaf(right.buffer, right.offset, right.shape, right.strides);
+    return lazyTensor(std::move(node));
+}
+
+void forcePendingTensors() {
+    std::vector<std::weak_ptr<TensorBuffer>> buffers;
+    buffers.swap(pendingBuffers);
+    for (const auto& weak : buffers) {
+        if (auto buffer = weak.lock()) buffer->data();
+    }
+}
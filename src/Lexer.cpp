@@ -37,6 +37,7 @@ void Lexer::scanToken() {
         case ',': addToken(TokenType::COMMA); break;
         case '.': addToken(TokenType::DOT); break;
         case ';': addToken(TokenType::SEMICOLON); break;
+        case ':': addToken(TokenType::COLON); break;
         case '-': addToken(TokenType::MINUS); break;
         case '+': addToken(TokenType::PLUS); break;
         case '*': addToken(TokenType::STAR); break;
@@ -0,0 +1,169 @@
+#include "../include/NumpyFile.h"
+#include "../include/MappedFile.h"
+#include "../include/NativeFunction.h"
+#include <cctype>
+#include <cstdint>
+
+namespace {
+
+const char MAGIC[] = "\x93NUMPY";
+constexpr size_t MAGIC_LENGTH = 6;
+constexpr size_t HEADER_ALIGNMENT = 64; // What NumPy pads the header to
+
+[[noreturn]] void malformed(const std::string& path, const std::string& problem) {
+    throw NativeError("'" + path + "' is not a readable .npy file: " + problem + ".");
+}
+
+size_t skipSpaces(const std::string& text, size_t i) {
+    while (i < text.size() && std::isspace(static_cast<unsigned char>(text[i]))) ++i;
+    return i;
+}
+
+// Position just past `'key':` in the header dict, spaces skipped
+size_t findKey(const std::string& header, const std::string& key, const std::string& path) {
+    size_t at = header.find("'" + key + "'");
+    if (at == std::string::npos) malformed(path, "the header has no '" + key + "'");
+    size_t colon = skipSpaces(header, at + key.size() + 2);
+    if (colon >= header.size() || header[colon] != ':') malformed(path, "the header is not a dict");
+    return skipSpaces(header, colon + 1);
+}
+
+std::string parseDescr(const std::string& header, const std::string& path) {
+    size_t start = findKey(header, "descr", path);
+    if (start >= header.size() || (header[start] != '\'' && header[start] != '"')) {
+        malformed(path, "'descr' is not a string");
+    }
+    size_t end = header.find(header[start], start + 1);
+    if (end == std::string::npos) malformed(path, "'descr' is not a string");
+    return header.substr(start + 1, end - start - 1);
+}
+
+bool parseFortranOrder(const std::string& header, const std::string& path) {
+    size_t start = findKey(header, "fortran_order", path);
+    if (header.compare(start, 4, "True") == 0) return true;
+    if (header.compare(start, 5, "False") == 0) return false;
+    malformed(path, "'fortran_order' is not True or False");
+}
+
+std::vector<size_t> parseShape(const std::string& header, const std::string& path) {
+    size_t i = findKey(header, "shape", path);
+    if (i >= header.size() || header[i] != '(') malformed(path, "'shape' is not a tuple");
+    std::vector<size_t> shape;
+    i = skipSpaces(header, i + 1);
+    while (i < header.size() && header[i] != ')') {
+        if (!std::isdigit(static_cast<unsigned char>(header[i]))) malformed(path, "'shape' holds a non-integer");
+        size_t extent = 0;
+        while (i < header.size() && std::isdigit(static_cast<unsigned char>(header[i]))) {
+            extent = extent * 10 + static_cast<size_t>(header[i++] - '0');
+            if (extent > (size_t(1) << 48)) malformed(path, "'shape' is too large");
+        }
+        shape.push_back(extent);
+        i = skipSpaces(header, i);
+        if (i < header.size() && header[i] == ',') i = skipSpaces(header, i + 1);
+    }
+    if (i >= header.size()) malformed(path, "'shape' is not a tuple");
+    return shape;
+}
+
+DType npyDType(const std::string& descr, const std::string& path) {
+    if (descr == "<f8") return DType::F64;
+    if (descr == "<f4") return DType::F32;
+    if (!descr.empty() && descr[0] == '>') malformed(path, "big-endian data is not supported");
+    malformed(path, "dtype '" + descr + "' is not supported (only '<f8' and '<f4')");
+}
+
+std::string shapeLiteral(const std::vector<size_t>& shape) {
+    std::string text = "(";
+    for (size_t d = 0; d < shape.size(); ++d) {
+        if (d > 0) text += ", ";
+        text += std::to_string(shape[d]);
+    }
+    if (shape.size() == 1) text += ",";
+    return text + ")";
+}
+
+} // namespace
+
+RuntimeValue loadNpy(const std::string& path) {
+    std::shared_ptr<MappedFile> file;
+    try {
+        file = MappedFile::open(path);
+    } catch (const std::runtime_error& error) {
+        throw NativeError(error.what());
+    }
+    const char* bytes = file->data();
+    size_t size = file->size();
+    if (size < MAGIC_LENGTH + 4 || std::memcmp(bytes, MAGIC, MAGIC_LENGTH) != 0) {
+        malformed(path, "the magic string is missing");
+    }
+    unsigned major = static_cast<unsigned char>(bytes[MAGIC_LENGTH]);
+    if (major < 1 || major > 3) malformed(path, "format version " + std::to_string(major) + " is unknown");
+
+    // Version 1 has a 2-byte header length, later ones 4; all little-endian
+    size_t lengthBytes = major == 1 ? 2 : 4;
+    if (size < MAGIC_LENGTH + 2 + lengthBytes) malformed(path, "the header length is missing");
+    size_t headerLength = 0;
+    for (size_t b = lengthBytes; b-- > 0;) {
+        headerLength = headerLength << 8 | static_cast<unsigned char>(bytes[MAGIC_LENGTH + 2 + b]);
+    }
+    size_t dataOffset = MAGIC_LENGTH + 2 + lengthBytes + headerLength;
+    if (dataOffset > size) malformed(path, "the header runs past the end of the file");
+    std::string header(bytes + MAGIC_LENGTH + 2 + lengthBytes, headerLength);
+
+    DType dtype = npyDType(parseDescr(header, path), path);
+    bool fortranOrder = parseFortranOrder(header, path);
+    std::vector<size_t> shape = parseShape(header, path);
+
+    size_t count = 1;
+    for (size_t extent : shape) {
+        if (extent != 0 && count > SIZE_MAX / extent) malformed(path, "'shape' is too large");
+        count *= extent;
+    }
+    size_t elementSize = dtypeSize(dtype);
+    if (count > (size - dataOffset) / elementSize) malformed(path, "the file is shorter than its shape");
+    if (dataOffset % elementSize != 0) malformed(path, "the data is not aligned to its dtype");
+
+    const char* elements = bytes + dataOffset;
+    if (shape.empty()) {
+        return RuntimeValue(dtype == DType::F64 ? *reinterpret_cast<const double*>(elements)
+                                                : static_cast<double>(*reinterpret_cast<const float*>(elements)));
+    }
+    // Fortran order is the transpose's strides
+    std::vector<ptrdiff_t> strides(shape.size());
+    ptrdiff_t stride = 1;
+    for (size_t i = 0; i < shape.size(); ++i) {
+        size_t d = fortranOrder ? i : shape.size() - 1 - i;
+        strides[d] = stride;
+        stride *= static_cast<ptrdiff_t>(shape[d]);
+    }
+    auto buffer = std::make_shared<TensorBuffer>(elements, count, dtype, std::move(file));
+    return RuntimeValue(makeRef<TrollTensor>(std::move(buffer), 0, std::move(shape), std::move(strides)));
+}
+
+void saveNpy(TrollTensor& tensor, const std::string& path) {
+    Ref<TrollTensor> source = tensor.dtype() == DType::BF16 ? tensor.astype(DType::F32) : tensor.contiguous();
+    const char* descr = source->dtype() == DType::F64 ? "<f8" : "<f4";
+
+    std::string header = std::string("{'descr': '") + descr + "', 'fortran_order': False, 'shape': " +
+                         shapeLiteral(source->shape) + ", }";
+    // Padded with spaces and a newline so the data starts aligned
+    size_t prefix = MAGIC_LENGTH + 4;
+    header.append((HEADER_ALIGNMENT - (prefix + header.size() + 1) % HEADER_ALIGNMENT) % HEADER_ALIGNMENT, ' ');
+    header += '\n';
+    std::string preamble(MAGIC, MAGIC_LENGTH);
+    preamble += '\x01';
+    preamble += '\x00';
+    preamble += static_cast<char>(header.size() & 0xFF);
+    preamble += static_cast<char>(header.size() >> 8);
+    preamble += header;
+
+    try {
+        // Never written in place: tensors loaded from the old file map it
+        replaceFile(path, {
+            {const_cast<char*>(preamble.data()), preamble.size()},
+            {source->raw(), source->size() * dtypeSize(source->dtype())},
+        });
+    } catch (const std::runtime_error& error) {
+        throw NativeError(error.what());
+    }
+}
@@ -0,0 +1,374 @@
+#include "../include/Operators.h"
+#include "../include/Autodiff.h"
+#include "../include/Environment.h"
+#include "../include/SparseTensor.h"
+#include "../include/TrollArray.h"
+#include "../include/TrollTensor.h"
+#include "../include/Lazy.h"
+#include "../include/TensorOps.h"
+#include <algorithm>
+#include <cmath>
+
+static void checkNumberOperand(const Token& operatorToken, const RuntimeValue& operand) {
+    if (operand.isNumber()) return;
+    throw RuntimeError(operatorToken, "Operand must be a number.");
+}
+
+static void checkNumberOperands(const Token& operatorToken, const RuntimeValue& left, const RuntimeValue& right) {
+    if (left.isNumber() && right.isNumber()) return;
+    throw RuntimeError(operatorToken, "Operands must be numbers.");
+}
+
+bool isTruthy(const RuntimeValue& value) {
+    if (value.isNil()) return false;
+    if (value.isBool()) return value.asBool();
+    return true;
+}
+
+bool isEqual(const RuntimeValue& a, const RuntimeValue& b) {
+    if (a.isTapeValue() || b.isTapeValue()) return isEqual(untracked(a), untracked(b));
+    // Simplified equality
+    if (a.typeTag() != b.typeTag()) return false;
+    if (a.isNumber()) return a.asNumber() == b.asNumber();
+    if (a.isBool()) return a.asBool() == b.asBool();
+    if (a.isString()) return a.asString() == b.asString();
+    return true; // nil == nil
+}
+
+// A 3-D operand is a batch of matrices along its first dimension. The
+// other operand's batch must match or be 1, or it has none and takes part
+// in every product; the whole batch is one batchedMatmul call.
+static RuntimeValue batchMatmul(const Token& op, TrollTensor* left, TrollTensor* right) {
+    size_t leftBatch = left->rank() == 3 ? left->shape[0] : 1;
+    size_t rightBatch = right->rank() == 3 ? right->shape[0] : 1;
+    if (leftBatch != rightBatch && leftBatch != 1 && rightBatch != 1) {
+        throw RuntimeError(op, "Batch dimensions mismatch.");
+    }
+    size_t batch = std::max(leftBatch, rightBatch);
+    size_t k = left->shape.back();
+    size_t inner = right->rank() >= 2 ? right->shape[right->rank() - 2] : right->shape[0];
+    if (inner != k) {
+        throw RuntimeError(op, "Matrix dimensions mismatch.");
+    }
+
+    std::vector<size_t> shape{batch};
+    if (left->rank() >= 2) shape.push_back(left->shape[left->rank() - 2]);
+    if (right->rank() >= 2) shape.push_back(right->shape.back());
+
+    DType dtype = promoteTypes(left->dtype(), right->dtype());
+    Ref<TrollTensor> l = left->astype(dtype);
+    Ref<TrollTensor> r = right->astype(dtype);
+    auto result = makeRef<TrollTensor>(std::move(shape), dtype);
+    ::batchedMatmul(*l, *r, batch, result->raw());
+    return RuntimeValue(result);
+}
+
+// Vectors take part as a row (left) or a column (right) and that dimension
+// is dropped from the result, so vector @ vector is a dot product.
+static RuntimeValue tensorMatmul(const Token& op, TrollTensor* left, TrollTensor* right) {
+    if (left->rank() == 0 || left->rank() > 3 || right->rank() == 0 || right->rank() > 3) {
+        throw RuntimeError(op, "MatMul only supports 1D, 2D and 3D tensors.");
+    }
+    if (left->rank() == 3 || right->rank() == 3) return batchMatmul(op, left, right);
+    size_t m = left->rank() == 2 ? left->shape[0] : 1;
+    size_t k = left->shape.back();
+    size_t n = right->rank() == 2 ? right->shape[1] : 1;
+    if (right->shape[0] != k) {
+        throw RuntimeError(op, "Matrix dimensions mismatch.");
+    }
+
+    std::vector<size_t> shape;
+    if (left->rank() == 2) shape.push_back(m);
+    if (right->rank() == 2) shape.push_back(n);
+
+    DType dtype = promoteTypes(left->dtype(), right->dtype());
+    if (dtype != DType::F64) {
+        Ref<TrollTensor> l = left->astype(dtype);
+        Ref<TrollTensor> r = right->astype(dtype);
+        auto result = makeRef<TrollTensor>(std::move(shape), dtype);
+        ::matmul(*l, *r, result->raw());
+        if (result->rank() == 0) return RuntimeValue(result->get(0));
+        return RuntimeValue(result);
+    }
+    if (shape.empty()) {
+        double sum = 0.0;
+        const double* a = left->data();
+        const double* b = right->data();
+        for (size_t p = 0; p < k; ++p) sum += a[static_cast<ptrdiff_t>(p) * left->strides[0]] * b[static_cast<ptrdiff_t>(p) * right->strides[0]];
+        return RuntimeValue(sum);
+    }
+    if (lazyTensors()) return RuntimeValue(lazyMatmul(*left, *right, std::move(shape)));
+    auto result = makeRef<TrollTensor>(std::move(shape));
+    ::matmul(*left, *right, result->data());
+    return RuntimeValue(result);
+}
+
+// The dense side of a product with a sparse matrix, as an f64 matrix. A
+// vector becomes a row (left) or a column (right) matrix and `vector` is
+// set, so its dimension can be dropped from the result as in tensorMatmul.
+static Ref<TrollTensor> denseOperand(const Token& op, const RuntimeValue& value, bool left, bool& vector) {
+    Ref<TrollTensor> tensor = value.isSparse() ? value.asSparse()->toDense() : toTensor(value);
+    if (!tensor) {
+        throw RuntimeError(op, "MatMul operator '@' requires two numeric arrays.");
+    }
+    if (tensor->rank() == 0 || tensor->rank() > 2) {
+        throw RuntimeError(op, "MatMul only supports 1D and 2D tensors.");
+    }
+    tensor = tensor->astype(DType::F64);
+    vector = tensor->rank() == 1;
+    if (!vector) return tensor;
+    size_t k = tensor->shape[0];
+    return tensor->reshape(left ? std::vector<size_t>{1, k} : std::vector<size_t>{k, 1});
+}
+
+// Either operand sparse; the result is a dense f64 tensor. Of two sparse
+// operands the right one is expanded to dense.
+static RuntimeValue sparseMatmul(const Token& op, const RuntimeValue& left, const RuntimeValue& right) {
+    bool vector;
+    if (left.isSparse()) {
+        SparseTensor* a = left.asSparse();
+        Ref<TrollTensor> b = denseOperand(op, right, false, vector);
+        if (b->shape[0] != a->cols) {
+            throw RuntimeError(op, "Matrix dimensions mismatch.");
+        }
+        Ref<TrollTensor> result = sparseDenseMatmul(*a, *b->contiguous());
+        return RuntimeValue(vector ? result->reshape({a->rows}) : result);
+    }
+    SparseTensor* b = right.asSparse();
+    Ref<TrollTensor> a = denseOperand(op, left, true, vector);
+    if (a->shape[1] != b->rows) {
+        throw RuntimeError(op, "Matrix dimensions mismatch.");
+    }
+    Ref<TrollTensor> result = denseSparseMatmul(*a, *b);
+    return RuntimeValue(vector ? result->reshape({b->cols}) : result);
+}
+
+static RuntimeValue matmul(const Token& op, const RuntimeValue& left, const RuntimeValue& right) {
+    if (left.isSparse() || right.isSparse()) return sparseMatmul(op, left, right);
+    Ref<TrollTensor> l = toTensor(left);
+    Ref<TrollTensor> r = toTensor(right);
+    if (!l || !r) {
+        throw RuntimeError(op, "MatMul operator '@' requires two numeric arrays.");
+    }
+    return tensorMatmul(op, l.get(), r.get());
+}
+
+static bool isArrayLike(const RuntimeValue& value) {
+    return value.isTensor() || value.isArray();
+}
+
+// + - * / on a tensor or numeric array and a number, or on two of them
+// with NumPy broadcasting. The result is always a new tensor.
+static RuntimeValue elementwiseOp(const Token& op, ElementOp kind, const RuntimeValue& left, const RuntimeValue& right) {
+    Ref<TrollTensor> l = left.isNumber() ? nullptr : toTensor(left);
+    Ref<TrollTensor> r = right.isNumber() ? nullptr : toTensor(right);
+    if ((!l && !left.isNumber()) || (!r && !right.isNumber())) {
+        throw RuntimeError(op, "Operands must be numbers or numeric arrays.");
+    }
+    static const std::vector<size_t> scalar;
+    std::vector<size_t> shape;
+    if (!broadcastShapes(l ? l->shape : scalar, r ? r->shape : scalar, shape)) {
+        throw RuntimeError(op, "Operand shapes cannot be broadcast together.");
+    }
+    double leftNumber = left.isNumber() ? left.asNumber() : 0.0;
+    double rightNumber = right.isNumber() ? right.asNumber() : 0.0;
+    DType dtype = l ? l->dtype() : r->dtype();
+    if (l && r) dtype = promoteTypes(l->dtype(), r->dtype());
+    if (l) l = l->astype(dtype);
+    if (r) r = r->astype(dtype);
+    // Deferred expressions are evaluated in f64
+    if (lazyTensors() && dtype == DType::F64) {
+        return RuntimeValue(lazyTensor(LazyExpr::elementwise(kind, l ? lazyOperand(*l) : LazyExpr::constant(leftNumber),
+                                                             r ? lazyOperand(*r) : LazyExpr::constant(rightNumber),
+                                                             std::move(shape))));
+    }
+    auto result = makeRef<TrollTensor>(shape, dtype);
+    elementwise(kind, l ? Operand::of(*l, shape) : Operand::of(leftNumber, shape),
+                r ? Operand::of(*r, shape) : Operand::of(rightNumber, shape), *result);
+    return RuntimeValue(result);
+}
+
+RuntimeValue binaryOp(const Token& op, const RuntimeValue& left, const RuntimeValue& right) {
+    if (left.isTapeValue() || right.isTapeValue()) return recordBinary(op, left, right);
+    switch (op.type) {
+        case TokenType::MINUS:
+            if (isArrayLike(left) || isArrayLike(right)) return elementwiseOp(op, ElementOp::Subtract, left, right);
+            checkNumberOperands(op, left, right);
+            return RuntimeValue(left.asNumber() - right.asNumber());
+        case TokenType::PLUS:
+            if (left.isNumber() && right.isNumber()) {
+                return RuntimeValue(left.asNumber() + right.asNumber());
+            }
+            if (left.isString() && right.isString()) {
+                return RuntimeValue(left.asString() + right.asString());
+            }
+            if (isArrayLike(left) || isArrayLike(right)) return elementwiseOp(op, ElementOp::Add, left, right);
+            throw RuntimeError(op, "Operands must be two numbers or two strings.");
+        case TokenType::SLASH:
+            if (isArrayLike(left) || isArrayLike(right)) return elementwiseOp(op, ElementOp::Divide, left, right);
+            checkNumberOperands(op, left, right);
+            return RuntimeValue(left.asNumber() / right.asNumber());
+        case TokenType::STAR:
+            if (isArrayLike(left) || isArrayLike(right)) return elementwiseOp(op, ElementOp::Multiply, left, right);
+            checkNumberOperands(op, left, right);
+            return RuntimeValue(left.asNumber() * right.asNumber());
+        case TokenType::GREATER:
+            checkNumberOperands(op, left, right);
+            return RuntimeValue(left.asNumber() > right.asNumber());
+        case TokenType::GREATER_EQUAL:
+            checkNumberOperands(op, left, right);
+            return RuntimeValue(left.asNumber() >= right.asNumber());
+        case TokenType::LESS:
+            checkNumberOperands(op, left, right);
+            return RuntimeValue(left.asNumber() < right.asNumber());
+        case TokenType::LESS_EQUAL:
+            checkNumberOperands(op, left, right);
+            return RuntimeValue(left.asNumber() <= right.asNumber());
+        case TokenType::AT:
+            return matmul(op, left, right);
+        case TokenType::BANG_EQUAL:
+            return RuntimeValue(!isEqual(left, right));
+        case TokenType::EQUAL_EQUAL:
+            return RuntimeValue(isEqual(left, right));
+        default:
+            return RuntimeValue(std::monostate{});
+    }
+}
+
+RuntimeValue unaryOp(const Token& op, const RuntimeValue& right) {
+    if (right.isTapeValue()) return recordUnary(op, right);
+    switch (op.type) {
+        case TokenType::MINUS:
+            if (isArrayLike(right)) return elementwiseOp(op, ElementOp::Multiply, RuntimeValue(-1.0), right);
+            checkNumberOperand(op, right);
+            return RuntimeValue(-right.asNumber());
+        case TokenType::BANG:
+            return RuntimeValue(!isTruthy(right));
+        default:
+            return RuntimeValue(std::monostate{});
+    }
+}
+
+static size_t checkIndex(const Token& bracket, size_t size, const RuntimeValue& index) {
+    if (!index.isNumber()) {
+        throw RuntimeError(bracket, "Index must be a number.");
+    }
+    double i = index.asNumber();
+    if (i < 0 || i >= static_cast<double>(size) || i != std::floor(i)) {
+        throw RuntimeError(bracket, "Index out of bounds.");
+    }
+    return static_cast<size_t>(i);
+}
+
+RuntimeValue indexGet(const Token& bracket, const RuntimeValue& object, const RuntimeValue& index) {
+    if (object.isTapeValue() || index.isTapeValue()) return recordIndex(bracket, object, index);
+    if (object.isTensor()) {
+        TrollTensor* tensor = object.asTensor();
+        size_t i = checkIndex(bracket, tensor->shape[0], index);
+        if (tensor->rank() == 1) return RuntimeValue(tensor->get(i * tensor->strides[0]));
+        return RuntimeValue(tensor->row(i));
+    }
+    if (!object.isArray()) {
+        throw RuntimeError(bracket, "Only arrays can be indexed.");
+    }
+    auto& array = *object.asArray();
+    return array.elements[checkIndex(bracket, array.elements.size(), index)];
+}
+
+void indexSet(const Token& bracket, const RuntimeValue& object, const RuntimeValue& index, const RuntimeValue& value) {
+    if (object.isTapeValue()) {
+        throw RuntimeError(bracket, "Cannot assign into a value being differentiated.");
+    }
+    // Indices carry no gradient. An array keeps a tracked value as it is,
+    // so reading the element back records like any other use of it; tensor
+    // elements are plain numbers, and such a store could not be recorded.
+    if (index.isTapeValue()) {
+        indexSet(bracket, object, untracked(index), value);
+        return;
+    }
+    if (value.isTapeValue() && object.isTensor()) {
+        if (isTracked(value)) {
+            throw RuntimeError(bracket, "Cannot store a value being differentiated into a tensor.");
+        }
+        indexSet(bracket, object, index, untracked(value));
+        return;
+    }
+    if (object.isTensor()) {
+        TrollTensor* tensor = object.asTensor();
+        if (tensor->buffer->readOnly()) {
+            throw RuntimeError(bracket, "Tensor is read-only.");
+        }
+        size_t i = checkIndex(bracket, tensor->shape[0], index);
+        // Deferred results must see the elements as they were
+        if (tensor->buffer->lazyReaders > 0) forcePendingTensors();
+        if (tensor->rank() == 1) {
+            if (!value.isNumber()) {
+                throw RuntimeError(bracket, "Tensor elements must be numbers.");
+            }
+            tensor->set(i * tensor->strides[0], value.asNumber());
+            return;
+        }
+        Ref<TrollTensor> row = tensor->row(i);
+        Ref<TrollTensor> source = toTensor(value);
+        if (!source || source->shape != row->shape) {
+            throw RuntimeError(bracket, "Assigned row must match the tensor's row shape.");
+        }
+        row->copyFrom(*source);
+        return;
+    }
+    if (!object.isArray()) {
+        throw RuntimeError(bracket, "Only arrays can be indexed.");
+    }
+    auto& array = *object.asArray();
+    array.elements[checkIndex(bracket, array.elements.size(), index)] = value;
+}
+
+static size_t checkBound(const Token& bracket, size_t size, const RuntimeValue& bound, size_t missing) {
+    if (bound.isNil()) return missing;
+    if (!bound.isNumber()) {
+        throw RuntimeError(bracket, "Slice bounds must be numbers.");
+    }
+    double i = bound.asNumber();
+    if (i < 0 || i > static_cast<double>(size) || i != std::floor(i)) {
+        throw RuntimeError(bracket, "Slice bounds out of range.");
+    }
+    return static_cast<size_t>(i);
+}
+
+RuntimeValue sliceGet(const Token& bracket, const RuntimeValue& object, const RuntimeValue& start, const RuntimeValue& end) {
+    if (object.isTapeValue() || start.isTapeValue() || end.isTapeValue()) {
+        return recordSlice(bracket, object, start, end);
+    }
+    size_t size;
+    if (object.isTensor() && object.asTensor()->rank() > 0) {
+        size = object.asTensor()->shape[0];
+    } else if (object.isArray()) {
+        size = object.asArray()->elements.size();
+    } else {
+        throw RuntimeError(bracket, "Only arrays can be sliced.");
+    }
+    size_t from = checkBound(bracket, size, start, 0);
+    size_t to = checkBound(bracket, size, end, size);
+    if (to < from) {
+        throw RuntimeError(bracket, "Slice end comes before its start.");
+    }
+    if (object.isTensor()) return RuntimeValue(object.asTensor()->slice(from, to));
+    const auto& elements = object.asArray()->elements;
+    return RuntimeValue(makeRef<TrollArray>(std::vector<RuntimeValue>(elements.begin() + from, elements.begin() + to)));
+}
+
+RuntimeValue propertyGet(const Token& name, const RuntimeValue& object) {
+    if (object.isTapeValue()) return recordProperty(name, object);
+    if (object.isTensor()) {
+        if (name.lexeme == "T") return RuntimeValue(object.asTensor()->transpose());
+        throw RuntimeError(name, "Tensors have no property '" + name.lexeme + "'.");
+    }
+    throw RuntimeError(name, "Only instances have properties.");
+}
+
+RuntimeValue arrayLiteral(std::vector<RuntimeValue> elements) {
+    if (Ref<TrollTensor> tensor = packTensor(elements)) {
+        return RuntimeValue(tensor);
+    }
+    return RuntimeValue(makeRef<TrollArray>(std::move(elements)));
+}
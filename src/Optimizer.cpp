@@ -0,0 +1,260 @@
+#include "../include/Optimizer.h"
+#include "../include/Operators.h"
+#include "../include/Environment.h"
+
+static RuntimeValue boxLiteral(const LiteralExpr& expr) {
+    if (std::holds_alternative<int>(expr.value)) {
+        return RuntimeValue(static_cast<double>(std::get<int>(expr.value))); // Treat ints as doubles runtime
+    }
+    if (std::holds_alternative<double>(expr.value)) {
+        return RuntimeValue(std::get<double>(expr.value));
+    }
+    if (std::holds_alternative<std::string>(expr.value)) {
+        return RuntimeValue(std::get<std::string>(expr.value));
+    }
+    if (std::holds_alternative<bool>(expr.value)) {
+        return RuntimeValue(std::get<bool>(expr.value));
+    }
+    return RuntimeValue(std::monostate{}); // Nil
+}
+
+// Only values a literal can spell are folded; anything else stays a runtime
+// operation.
+static std::shared_ptr<Expr> makeLiteral(const RuntimeValue& value) {
+    std::shared_ptr<LiteralExpr> literal;
+    if (value.isNumber()) {
+        literal = std::make_shared<LiteralExpr>(value.asNumber());
+    } else if (value.isBool()) {
+        literal = std::make_shared<LiteralExpr>(value.asBool());
+    } else if (value.isString()) {
+        literal = std::make_shared<LiteralExpr>(value.asString());
+    } else if (value.isNil()) {
+        literal = std::make_shared<LiteralExpr>(std::monostate{});
+    } else {
+        return nullptr;
+    }
+    literal->constant = value;
+    return literal;
+}
+
+static LiteralExpr* asLiteral(const std::shared_ptr<Expr>& expr) {
+    return dynamic_cast<LiteralExpr*>(expr.get());
+}
+
+// A declaration directly under an if/while (no block) binds in the enclosing
+// scope, so removing it would change what the Resolver sees.
+static bool isDeclaration(const std::shared_ptr<Stmt>& stmt) {
+    return dynamic_cast<LetStmt*>(stmt.get()) || dynamic_cast<FunctionStmt*>(stmt.get()) ||
+           dynamic_cast<ModelStmt*>(stmt.get());
+}
+
+std::vector<std::shared_ptr<Stmt>> Optimizer::optimize(const std::vector<std::shared_ptr<Stmt>>& statements) {
+    std::vector<std::shared_ptr<Stmt>> result = statements;
+    optimizeStatements(result);
+    return result;
+}
+
+std::shared_ptr<Expr> Optimizer::optimize(const std::shared_ptr<Expr>& expr) {
+    if (!expr) return nullptr;
+    return std::any_cast<std::shared_ptr<Expr>>(expr->accept(this));
+}
+
+std::shared_ptr<Stmt> Optimizer::optimize(const std::shared_ptr<Stmt>& stmt) {
+    if (!stmt) return nullptr;
+    return std::any_cast<std::shared_ptr<Stmt>>(stmt->accept(this));
+}
+
+// Branches and loop bodies must stay statements, so a removed one becomes an
+// empty block.
+std::shared_ptr<Stmt> Optimizer::optimizeBranch(const std::shared_ptr<Stmt>& stmt) {
+    if (!stmt) return nullptr;
+    std::shared_ptr<Stmt> result = optimize(stmt);
+    if (!result) return std::make_shared<BlockStmt>(std::vector<std::shared_ptr<Stmt>>{});
+    return result;
+}
+
+void Optimizer::optimizeStatements(std::vector<std::shared_ptr<Stmt>>& statements) {
+    std::vector<std::shared_ptr<Stmt>> result;
+    result.reserve(statements.size());
+    for (const auto& stmt : statements) {
+        if (auto optimized = optimize(stmt)) {
+            result.push_back(std::move(optimized));
+        }
+    }
+    statements = std::move(result);
+}
+
+// Expressions
+
+std::any Optimizer::visitLiteralExpr(std::shared_ptr<LiteralExpr> expr) {
+    expr->constant = boxLiteral(*expr);
+    return std::shared_ptr<Expr>(expr);
+}
+
+std::any Optimizer::visitVariableExpr(std::shared_ptr<VariableExpr> expr) {
+    return std::shared_ptr<Expr>(expr);
+}
+
+std::any Optimizer::visitBinaryExpr(std::shared_ptr<BinaryExpr> expr) {
+    expr->left = optimize(expr->left);
+    expr->right = optimize(expr->right);
+
+    LiteralExpr* left = asLiteral(expr->left);
+    LiteralExpr* right = asLiteral(expr->right);
+    if (left && right) {
+        // Operators.cpp is the single source of truth for the semantics; an
+        // operation that would fail is left for the back end to report.
+        try {
+            if (auto folded = makeLiteral(binaryOp(expr->op, left->constant, right->constant))) {
+                return folded;
+            }
+        } catch (const RuntimeError&) {
+        }
+    }
+    return std::shared_ptr<Expr>(expr);
+}
+
+std::any Optimizer::visitUnaryExpr(std::shared_ptr<UnaryExpr> expr) {
+    expr->right = optimize(expr->right);
+
+    if (LiteralExpr* right = asLiteral(expr->right)) {
+        try {
+            if (auto folded = makeLiteral(unaryOp(expr->op, right->constant))) {
+                return folded;
+            }
+        } catch (const RuntimeError&) {
+        }
+    }
+    return std::shared_ptr<Expr>(expr);
+}
+
+std::any Optimizer::visitAssignmentExpr(std::shared_ptr<AssignmentExpr> expr) {
+    expr->value = optimize(expr->value);
+    return std::shared_ptr<Expr>(expr);
+}
+
+std::any Optimizer::visitLogicalExpr(std::shared_ptr<LogicalExpr> expr) {
+    expr->left = optimize(expr->left);
+    expr->right = optimize(expr->right);
+
+    // Short-circuiting yields one of the operands, so a constant left side
+    // decides which one.
+    if (LiteralExpr* left = asLiteral(expr->left)) {
+        bool truthy = isTruthy(left->constant);
+        bool shortCircuits = expr->op.type == TokenType::PIPE_PIPE ? truthy : !truthy;
+        return shortCircuits ? expr->left : expr->right;
+    }
+    return std::shared_ptr<Expr>(expr);
+}
+
+std::any Optimizer::visitCallExpr(std::shared_ptr<CallExpr> expr) {
+    expr->callee = optimize(expr->callee);
+    for (auto& argument : expr->arguments) {
+        argument = optimize(argument);
+    }
+    return std::shared_ptr<Expr>(expr);
+}
+
+std::any Optimizer::visitGetExpr(std::shared_ptr<GetExpr> expr) {
+    expr->object = optimize(expr->object);
+    return std::shared_ptr<Expr>(expr);
+}
+
+std::any Optimizer::visitArrayLiteralExpr(std::shared_ptr<ArrayLiteralExpr> expr) {
+    for (auto& element : expr->elements) {
+        element = optimize(element);
+    }
+    return std::shared_ptr<Expr>(expr);
+}
+
+std::any Optimizer::visitIndexExpr(std::shared_ptr<IndexExpr> expr) {
+    expr->object = optimize(expr->object);
+    expr->index = optimize(expr->index);
+    return std::shared_ptr<Expr>(expr);
+}
+
+std::any Optimizer::visitSliceExpr(std::shared_ptr<SliceExpr> expr) {
+    expr->object = optimize(expr->object);
+    if (expr->start) expr->start = optimize(expr->start);
+    if (expr->end) expr->end = optimize(expr->end);
+    return std::shared_ptr<Expr>(expr);
+}
+
+std::any Optimizer::visitArrayAssignmentExpr(std::shared_ptr<ArrayAssignmentExpr> expr) {
+    expr->object = optimize(expr->object);
+    expr->index = optimize(expr->index);
+    expr->value = optimize(expr->value);
+    return std::shared_ptr<Expr>(expr);
+}
+
+// Statements
+
+std::any Optimizer::visitExprStmt(std::shared_ptr<ExprStmt> stmt) {
+    stmt->expression = optimize(stmt->expression);
+    return std::shared_ptr<Stmt>(stmt);
+}
+
+std::any Optimizer::visitPrintStmt(std::shared_ptr<PrintStmt> stmt) {
+    stmt->expression = optimize(stmt->expression);
+    return std::shared_ptr<Stmt>(stmt);
+}
+
+std::any Optimizer::visitLetStmt(std::shared_ptr<LetStmt> stmt) {
+    stmt->initializer = optimize(stmt->initializer);
+    return std::shared_ptr<Stmt>(stmt);
+}
+
+std::any Optimizer::visitBlockStmt(std::shared_ptr<BlockStmt> stmt) {
+    optimizeStatements(stmt->statements);
+    return std::shared_ptr<Stmt>(stmt);
+}
+
+std::any Optimizer::visitIfStmt(std::shared_ptr<IfStmt> stmt) {
+    stmt->condition = optimize(stmt->condition);
+    stmt->thenBranch = optimizeBranch(stmt->thenBranch);
+    stmt->elseBranch = optimizeBranch(stmt->elseBranch);
+
+    LiteralExpr* condition = asLiteral(stmt->condition);
+    if (condition && !isDeclaration(stmt->thenBranch) && !isDeclaration(stmt->elseBranch)) {
+        return isTruthy(condition->constant) ? stmt->thenBranch : stmt->elseBranch;
+    }
+    return std::shared_ptr<Stmt>(stmt);
+}
+
+std::any Optimizer::visitWhileStmt(std::shared_ptr<WhileStmt> stmt) {
+    stmt->condition = optimize(stmt->condition);
+    stmt->body = optimizeBranch(stmt->body);
+
+    LiteralExpr* condition = asLiteral(stmt->condition);
+    if (condition && !isTruthy(condition->constant) && !isDeclaration(stmt->body)) {
+        return std::shared_ptr<Stmt>();
+    }
+    return std::shared_ptr<Stmt>(stmt);
+}
+
+std::any Optimizer::visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt) {
+    ++functionDepth;
+    optimizeStatements(stmt->body);
+    --functionDepth;
+    return std::shared_ptr<Stmt>(stmt);
+}
+
+std::any Optimizer::visitReturnStmt(std::shared_ptr<ReturnStmt> stmt) {
+    stmt->value = optimize(stmt->value);
+    // A top-level return ends the script, which has no frame to reuse
+    if (functionDepth > 0) {
+        if (auto call = dynamic_cast<CallExpr*>(stmt->value.get())) {
+            call->tail = true;
+        }
+    }
+    return std::shared_ptr<Stmt>(stmt);
+}
+
+std::any Optimizer::visitModelStmt(std::shared_ptr<ModelStmt> stmt) {
+    // The model body runs as a constructor, not as a call of the enclosing function
+    int enclosingDepth = functionDepth;
+    functionDepth = 0;
+    optimizeStatements(stmt->methods);
+    functionDepth = enclosingDepth;
+    return std::shared_ptr<Stmt>(stmt);
+}
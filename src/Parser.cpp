@@ -264,9 +264,17 @@ std::shared_ptr<Expr> Parser::call() {
             Token name = consume(TokenType::IDENTIFIER, "Expect property name after '.'.");
             expr = std::make_shared<GetExpr>(expr, name);
         } else if (match({TokenType::LEFT_BRACKET})) {
-            std::shared_ptr<Expr> index = expression();
-            Token bracket = consume(TokenType::RIGHT_BRACKET, "Expected ']' after index.");
-            expr = std::make_shared<IndexExpr>(expr, index, bracket);
+            std::shared_ptr<Expr> index;
+            if (!check(TokenType::COLON)) index = expression();
+            if (match({TokenType::COLON})) {
+                std::shared_ptr<Expr> end;
+                if (!check(TokenType::RIGHT_BRACKET)) end = expression();
+                Token bracket = consume(TokenType::RIGHT_BRACKET, "Expected ']' after slice.");
+                expr = std::make_shared<SliceExpr>(expr, index, end, bracket);
+            } else {
+                Token bracket = consume(TokenType::RIGHT_BRACKET, "Expected ']' after index.");
+                expr = std::make_shared<IndexExpr>(expr, index, bracket);
+            }
         } else {
             break;
         }
@@ -0,0 +1,281 @@
+#include "../include/Resolver.h"
+
+void Resolver::resolve(const std::vector<std::shared_ptr<Stmt>>& statements) {
+    resolveStatements(statements);
+}
+
+void Resolver::resolve(const std::shared_ptr<Stmt>& stmt) {
+    if (stmt) stmt->accept(this);
+}
+
+void Resolver::resolve(const std::shared_ptr<Expr>& expr) {
+    if (expr) expr->accept(this);
+}
+
+void Resolver::resolveStatements(const std::vector<std::shared_ptr<Stmt>>& statements) {
+    for (const auto& stmt : statements) {
+        resolve(stmt);
+    }
+    // Function bodies declared here run later, when every local of the
+    // scope has been declared; resolve them against all of it, remembering
+    // which slots were declared after the function (see resolveLocal).
+    if (scopes.empty()) return;
+    std::vector<Deferred> deferred = std::move(scopes.back().deferred);
+    for (const auto& entry : deferred) {
+        std::vector<int> saved;
+        for (size_t i = 0; i < scopes.size(); ++i) {
+            saved.push_back(scopes[i].visible);
+            scopes[i].visible = entry.visible[i];
+        }
+        resolveFunction(entry.function);
+        for (size_t i = 0; i < scopes.size(); ++i) {
+            scopes[i].visible = saved[i];
+        }
+    }
+}
+
+void Resolver::beginScope() {
+    scopes.emplace_back();
+}
+
+int Resolver::endScope() {
+    int count = static_cast<int>(scopes.back().slots.size());
+    scopes.pop_back();
+    return count;
+}
+
+int Resolver::declare(const std::string& name) {
+    if (scopes.empty()) return -1;
+
+    auto& scope = scopes.back().slots;
+    auto it = scope.find(name);
+    if (it != scope.end()) {
+        return it->second; // Redeclaration reuses the slot, like define() overwrote the map entry
+    }
+    int slot = static_cast<int>(scope.size());
+    scope[name] = slot;
+    return slot;
+}
+
+// A closure keeps every enclosing scope reachable, so none of them can live
+// in the Interpreter's frame arena.
+void Resolver::markCaptured() {
+    for (auto& scope : scopes) {
+        scope.captured = true;
+    }
+}
+
+// Functions and models are visible to the whole block they are declared in,
+// so siblings can call each other regardless of declaration order.
+void Resolver::hoistDeclarations(const std::vector<std::shared_ptr<Stmt>>& statements) {
+    for (const auto& stmt : statements) {
+        if (auto function = std::dynamic_pointer_cast<FunctionStmt>(stmt)) {
+            declare(function->name.lexeme);
+        } else if (auto model = std::dynamic_pointer_cast<ModelStmt>(stmt)) {
+            declare(model->name.lexeme);
+        }
+    }
+}
+
+// A slot declared after the function being resolved is late: its let may not
+// have run when the function is called, and until it does the name still
+// means whatever it meant where the function was declared. Record those outer
+// bindings too, up to the first one that was already declared there.
+void Resolver::resolveLocal(const Token& name, int& depth, int& slot, std::vector<SlotRef>& fallbacks, bool& globalFallback) {
+    depth = -1;
+    slot = -1;
+    fallbacks.clear();
+    globalFallback = false;
+    for (int i = static_cast<int>(scopes.size()) - 1; i >= 0; --i) {
+        auto it = scopes[i].slots.find(name.lexeme);
+        if (it == scopes[i].slots.end()) continue;
+
+        int hops = static_cast<int>(scopes.size()) - 1 - i;
+        bool declared = scopes[i].visible < 0 || it->second < scopes[i].visible;
+        if (depth < 0) {
+            depth = hops;
+            slot = it->second;
+        } else {
+            fallbacks.push_back(SlotRef{hops, it->second});
+        }
+        if (declared) return;
+    }
+    // Not found, or every binding is late: the global is the last resort
+    globalFallback = depth >= 0;
+}
+
+void Resolver::resolveFunction(const std::shared_ptr<FunctionStmt>& function) {
+    beginScope();
+    for (const auto& param : function->params) {
+        declare(param.lexeme);
+    }
+    hoistDeclarations(function->body);
+    resolveStatements(function->body);
+    function->captured = scopes.back().captured;
+    function->localCount = endScope();
+}
+
+// Expressions
+
+std::any Resolver::visitLiteralExpr(std::shared_ptr<LiteralExpr> expr) {
+    return std::any();
+}
+
+std::any Resolver::visitVariableExpr(std::shared_ptr<VariableExpr> expr) {
+    resolveLocal(expr->name, expr->depth, expr->slot, expr->fallbacks, expr->globalFallback);
+    if (expr->depth >= 0) {
+        const Scope& scope = scopes[scopes.size() - 1 - expr->depth];
+        expr->method = scope.methods.count(expr->name.lexeme) > 0;
+    }
+    return std::any();
+}
+
+std::any Resolver::visitBinaryExpr(std::shared_ptr<BinaryExpr> expr) {
+    resolve(expr->left);
+    resolve(expr->right);
+    return std::any();
+}
+
+std::any Resolver::visitUnaryExpr(std::shared_ptr<UnaryExpr> expr) {
+    resolve(expr->right);
+    return std::any();
+}
+
+std::any Resolver::visitAssignmentExpr(std::shared_ptr<AssignmentExpr> expr) {
+    resolve(expr->value);
+    resolveLocal(expr->name, expr->depth, expr->slot, expr->fallbacks, expr->globalFallback);
+    return std::any();
+}
+
+std::any Resolver::visitLogicalExpr(std::shared_ptr<LogicalExpr> expr) {
+    resolve(expr->left);
+    resolve(expr->right);
+    return std::any();
+}
+
+std::any Resolver::visitCallExpr(std::shared_ptr<CallExpr> expr) {
+    resolve(expr->callee);
+    if (std::dynamic_pointer_cast<GetExpr>(expr->callee)) {
+        expr->hasReceiver = true;
+    } else if (auto variable = std::dynamic_pointer_cast<VariableExpr>(expr->callee)) {
+        expr->hasReceiver = variable->method;
+    }
+    for (const auto& argument : expr->arguments) {
+        resolve(argument);
+    }
+    return std::any();
+}
+
+std::any Resolver::visitGetExpr(std::shared_ptr<GetExpr> expr) {
+    resolve(expr->object);
+    return std::any();
+}
+
+std::any Resolver::visitArrayLiteralExpr(std::shared_ptr<ArrayLiteralExpr> expr) {
+    for (const auto& el : expr->elements) {
+        resolve(el);
+    }
+    return std::any();
+}
+
+std::any Resolver::visitIndexExpr(std::shared_ptr<IndexExpr> expr) {
+    resolve(expr->object);
+    resolve(expr->index);
+    return std::any();
+}
+
+std::any Resolver::visitSliceExpr(std::shared_ptr<SliceExpr> expr) {
+    resolve(expr->object);
+    if (expr->start) resolve(expr->start);
+    if (expr->end) resolve(expr->end);
+    return std::any();
+}
+
+std::any Resolver::visitArrayAssignmentExpr(std::shared_ptr<ArrayAssignmentExpr> expr) {
+    resolve(expr->object);
+    resolve(expr->index);
+    resolve(expr->value);
+    return std::any();
+}
+
+// Statements
+
+std::any Resolver::visitExprStmt(std::shared_ptr<ExprStmt> stmt) {
+    resolve(stmt->expression);
+    return std::any();
+}
+
+std::any Resolver::visitPrintStmt(std::shared_ptr<PrintStmt> stmt) {
+    resolve(stmt->expression);
+    return std::any();
+}
+
+std::any Resolver::visitLetStmt(std::shared_ptr<LetStmt> stmt) {
+    // The initializer still sees any outer variable of the same name.
+    resolve(stmt->initializer);
+    stmt->slot = declare(stmt->name.lexeme);
+    return std::any();
+}
+
+std::any Resolver::visitBlockStmt(std::shared_ptr<BlockStmt> stmt) {
+    beginScope();
+    hoistDeclarations(stmt->statements);
+    resolveStatements(stmt->statements);
+    stmt->captured = scopes.back().captured;
+    stmt->localCount = endScope();
+    return std::any();
+}
+
+std::any Resolver::visitIfStmt(std::shared_ptr<IfStmt> stmt) {
+    resolve(stmt->condition);
+    resolve(stmt->thenBranch);
+    resolve(stmt->elseBranch);
+    return std::any();
+}
+
+std::any Resolver::visitWhileStmt(std::shared_ptr<WhileStmt> stmt) {
+    resolve(stmt->condition);
+    resolve(stmt->body);
+    return std::any();
+}
+
+std::any Resolver::visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt) {
+    stmt->slot = declare(stmt->name.lexeme);
+    markCaptured();
+    // Globals are looked up by name, so a top-level body can be resolved now
+    if (scopes.empty()) {
+        resolveFunction(stmt);
+    } else {
+        Deferred entry{stmt, {}};
+        for (const Scope& scope : scopes) {
+            entry.visible.push_back(scope.visible >= 0 ? scope.visible : static_cast<int>(scope.slots.size()));
+        }
+        scopes.back().deferred.push_back(std::move(entry));
+    }
+    return std::any();
+}
+
+std::any Resolver::visitReturnStmt(std::shared_ptr<ReturnStmt> stmt) {
+    resolve(stmt->value);
+    return std::any();
+}
+
+std::any Resolver::visitModelStmt(std::shared_ptr<ModelStmt> stmt) {
+    stmt->slot = declare(stmt->name.lexeme);
+    markCaptured();
+
+    // The model body runs in the instance environment. Every field and method
+    // gets a slot up front so methods can refer to members declared after them.
+    beginScope();
+    for (const auto& member : stmt->methods) {
+        if (auto let = std::dynamic_pointer_cast<LetStmt>(member)) {
+            stmt->fieldSlots[let->name.lexeme] = declare(let->name.lexeme);
+        } else if (auto function = std::dynamic_pointer_cast<FunctionStmt>(member)) {
+            stmt->fieldSlots[function->name.lexeme] = declare(function->name.lexeme);
+            scopes.back().methods.insert(function->name.lexeme);
+        }
+    }
+    resolveStatements(stmt->methods);
+    stmt->localCount = endScope();
+    return std::any();
+}
@@ -1,26 +1,29 @@
 #include "../include/RuntimeValue.h"
+#include "../include/Autodiff.h"
 #include "../include/Callable.h"
 #include "../include/TrollFunction.h"
 #include "../include/TrollArray.h"
+#include "../include/SparseTensor.h"
+#include "../include/TrollTensor.h"
 #include "../include/TrollInstance.h"
 #include "../include/TrollModel.h"
 #include <cmath>
 
 std::string to_string(const RuntimeValue& value) {
-    if (std::holds_alternative<std::monostate>(value)) return "nil";
-    if (std::holds_alternative<double>(value)) {
-        double d = std::get<double>(value);
+    if (value.isNil()) return "nil";
+    if (value.isNumber()) {
+        double d = value.asNumber();
         // Remove trailing zeros logic could go here
         std::string s = std::to_string(d);
         return s;
     }
-    if (std::holds_alternative<bool>(value)) return std::get<bool>(value) ? "true" : "false";
-    if (std::holds_alternative<std::string>(value)) return std::get<std::string>(value);
-    if (std::holds_alternative<std::shared_ptr<Callable>>(value)) {
-        return std::get<std::shared_ptr<Callable>>(value)->toString();
+    if (value.isBool()) return value.asBool() ? "true" : "false";
+    if (value.isString()) return value.asString();
+    if (value.isCallable()) {
+        return value.asCallable()->toString();
     }
-    if (std::holds_alternative<std::shared_ptr<TrollArray>>(value)) {
-        auto arr = std::get<std::shared_ptr<TrollArray>>(value);
+    if (value.isArray()) {
+        TrollArray* arr = value.asArray();
         std::string s = "[";
         for (size_t i = 0; i < arr->elements.size(); ++i) {
             s += to_string(arr->elements[i]);
@@ -29,8 +32,17 @@ std::string to_string(const RuntimeValue& value) {
         s += "]";
         return s;
     }
-    if (std::holds_alternative<std::shared_ptr<TrollInstance>>(value)) {
-        auto inst = std::get<std::shared_ptr<TrollInstance>>(value);
+    if (value.isTensor()) {
+        return value.asTensor()->toString();
+    }
+    if (value.isSparse()) {
+        return value.asSparse()->toString();
+    }
+    if (value.isTapeValue()) {
+        return to_string(untracked(value));
+    }
+    if (value.isInstance()) {
+        TrollInstance* inst = value.asInstance();
         return "instance of " + inst->model->name;
     }
     return "";
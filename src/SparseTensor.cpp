@@ -0,0 +1,161 @@
+#include "../include/SparseTensor.h"
+#include "../include/ThreadPool.h"
+#include <algorithm>
+
+SparseTensor::SparseTensor(size_t rows, size_t cols)
+    : Object(ObjectType::Sparse), rows(rows), cols(cols), rowStart(rows + 1, 0) {}
+
+Ref<SparseTensor> SparseTensor::fromTriplets(size_t rows, size_t cols, const std::vector<size_t>& rowIndex,
+                                             const std::vector<size_t>& columnIndex,
+                                             const std::vector<double>& values) {
+    auto sparse = makeRef<SparseTensor>(rows, cols);
+    size_t count = values.size();
+    // Counting sort by row
+    std::vector<size_t>& start = sparse->rowStart;
+    for (size_t e = 0; e < count; ++e) ++start[rowIndex[e] + 1];
+    for (size_t i = 0; i < rows; ++i) start[i + 1] += start[i];
+    std::vector<std::pair<uint32_t, double>> entries(count);
+    std::vector<size_t> next(start.begin(), start.end() - 1);
+    for (size_t e = 0; e < count; ++e) {
+        entries[next[rowIndex[e]]++] = {static_cast<uint32_t>(columnIndex[e]), values[e]};
+    }
+
+    // Then by column within each row, summing duplicates
+    sparse->columns.reserve(count);
+    sparse->values.reserve(count);
+    size_t from = 0;
+    for (size_t i = 0; i < rows; ++i) {
+        size_t end = start[i + 1];
+        std::sort(entries.begin() + from, entries.begin() + end,
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
+        start[i] = sparse->values.size();
+        for (size_t e = from; e < end; ++e) {
+            if (e > from && entries[e].first == entries[e - 1].first) {
+                sparse->values.back() += entries[e].second;
+            } else {
+                sparse->columns.push_back(entries[e].first);
+                sparse->values.push_back(entries[e].second);
+            }
+        }
+        from = end;
+    }
+    start[rows] = sparse->values.size();
+    return sparse;
+}
+
+Ref<SparseTensor> SparseTensor::fromDense(const TrollTensor& matrix) {
+    auto sparse = makeRef<SparseTensor>(matrix.shape[0], matrix.shape[1]);
+    for (size_t i = 0; i < sparse->rows; ++i) {
+        for (size_t j = 0; j < sparse->cols; ++j) {
+            double value = matrix.get(static_cast<ptrdiff_t>(i) * matrix.strides[0] +
+                                      static_cast<ptrdiff_t>(j) * matrix.strides[1]);
+            if (value == 0.0) continue;
+            sparse->columns.push_back(static_cast<uint32_t>(j));
+            sparse->values.push_back(value);
+        }
+        sparse->rowStart[i + 1] = sparse->values.size();
+    }
+    return sparse;
+}
+
+Ref<TrollTensor> SparseTensor::toDense() const {
+    auto dense = makeRef<TrollTensor>(std::vector<size_t>{rows, cols});
+    double* out = dense->data();
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t e = rowStart[i]; e < rowStart[i + 1]; ++e) {
+            out[i * cols + columns[e]] = values[e];
+        }
+    }
+    return dense;
+}
+
+// Counting sort by column; visiting rows in order leaves each new row
+// sorted
+Ref<SparseTensor> SparseTensor::transpose() const {
+    auto result = makeRef<SparseTensor>(cols, rows);
+    std::vector<size_t>& start = result->rowStart;
+    for (uint32_t column : columns) ++start[column + 1];
+    for (size_t j = 0; j < cols; ++j) start[j + 1] += start[j];
+    result->columns.resize(nonzeros());
+    result->values.resize(nonzeros());
+    std::vector<size_t> next(start.begin(), start.end() - 1);
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t e = rowStart[i]; e < rowStart[i + 1]; ++e) {
+            size_t to = next[columns[e]]++;
+            result->columns[to] = static_cast<uint32_t>(i);
+            result->values[to] = values[e];
+        }
+    }
+    return result;
+}
+
+std::string SparseTensor::toString() const {
+    return "sparse " + std::to_string(rows) + " x " + std::to_string(cols) + " with " +
+           std::to_string(nonzeros()) + " nonzeros";
+}
+
+Ref<TrollTensor> sparseDenseMatmul(const SparseTensor& a, const TrollTensor& b) {
+    size_t n = b.shape[1];
+    auto result = makeRef<TrollTensor>(std::vector<size_t>{a.rows, n});
+    if (a.rows == 0 || n == 0 || a.nonzeros() == 0) return result;
+    const double* in = b.data();
+    double* out = result->data();
+
+    auto runRows = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            double* row = out + i * n;
+            for (size_t e = a.rowStart[i]; e < a.rowStart[i + 1]; ++e) {
+                double value = a.values[e];
+                const double* source = in + a.columns[e] * n;
+                for (size_t j = 0; j < n; ++j) row[j] += value * source[j];
+            }
+        }
+    };
+
+    size_t work = a.nonzeros() * n;
+    ThreadPool& pool = ThreadPool::get();
+    if (pool.threadCount() == 1 || work < ThreadPool::PARALLEL_ELEMENTS) {
+        runRows(0, a.rows);
+        return result;
+    }
+    // Chunk c starts at the row holding nonzero c * nonzeros / chunks; any
+    // empty rows before the first chunk are left as they are, zero
+    size_t chunks = std::min(a.rows, std::max<size_t>(1, work / ThreadPool::GRAIN));
+    std::vector<size_t> firstRow(chunks + 1, a.rows);
+    for (size_t c = 0; c < chunks; ++c) {
+        size_t nonzero = c * a.nonzeros() / chunks;
+        firstRow[c] = static_cast<size_t>(
+            std::upper_bound(a.rowStart.begin(), a.rowStart.end() - 1, nonzero) - a.rowStart.begin() - 1);
+    }
+    pool.parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) runRows(firstRow[c], firstRow[c + 1]);
+    });
+    return result;
+}
+
+Ref<TrollTensor> denseSparseMatmul(const TrollTensor& a, const SparseTensor& b) {
+    size_t m = a.shape[0];
+    size_t k = b.rows;
+    size_t n = b.cols;
+    auto result = makeRef<TrollTensor>(std::vector<size_t>{m, n});
+    if (m == 0 || n == 0 || b.nonzeros() == 0) return result;
+    const double* in = a.data();
+    ptrdiff_t rowStride = a.strides[0];
+    ptrdiff_t colStride = a.strides[1];
+    double* out = result->data();
+
+    ThreadPool::forEach(m, b.nonzeros() + k, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const double* source = in + static_cast<ptrdiff_t>(i) * rowStride;
+            double* row = out + i * n;
+            for (size_t p = 0; p < k; ++p) {
+                double scale = source[static_cast<ptrdiff_t>(p) * colStride];
+                if (scale == 0.0) continue;
+                for (size_t e = b.rowStart[p]; e < b.rowStart[p + 1]; ++e) {
+                    row[b.columns[e]] += scale * b.values[e];
+                }
+            }
+        }
+    });
+    return result;
+}
@@ -0,0 +1,132 @@
+#include "../include/TensorAllocator.h"
+#include <atomic>
+#include <new>
+
+namespace {
+
+constexpr size_t MIN_BYTES = 64;
+constexpr size_t CLASSES = 89; // Up to MAX_CACHED_BYTES
+constexpr std::align_val_t ALIGNMENT{64};
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+// Per-thread free lists, linked through the cached blocks themselves. Plain
+// thread_local arrays have no destructor, so buffers freed during static
+// teardown still find them.
+thread_local FreeBlock* freeLists[CLASSES];
+thread_local size_t threadCachedBytes = 0;
+
+// Statistics for --gc-stats, over all threads
+std::atomic<size_t> requests{0};
+std::atomic<size_t> hits{0};
+std::atomic<size_t> liveBytes{0};
+std::atomic<size_t> peakLiveBytes{0};
+std::atomic<size_t> heldBytes{0}; // Live plus cached: what the system has handed out
+std::atomic<size_t> peakHeldBytes{0};
+
+// Classes are 64 bytes, then four per power of two: 80, 96, 112, 128,
+// 160, ... so rounding wastes at most a quarter of a block
+size_t classOf(size_t bytes) {
+    if (bytes <= MIN_BYTES) return 0;
+    int exponent = 63 - __builtin_clzll(bytes - 1); // bytes is in (2^e, 2^(e+1)]
+    int shift = exponent - 2;
+    size_t steps = (bytes + (size_t(1) << shift) - 1) >> shift; // 5 to 8
+    return 1 + (exponent - 6) * 4 + (steps - 5);
+}
+
+size_t classBytes(size_t sizeClass) {
+    if (sizeClass == 0) return MIN_BYTES;
+    size_t exponent = 6 + (sizeClass - 1) / 4;
+    size_t steps = 5 + (sizeClass - 1) % 4;
+    return steps << (exponent - 2);
+}
+
+// Bytes actually reserved for a request
+size_t blockBytes(size_t bytes) {
+    return bytes > TensorAllocator::MAX_CACHED_BYTES ? bytes : classBytes(classOf(bytes));
+}
+
+void raise(std::atomic<size_t>& peak, size_t value) {
+    size_t current = peak.load(std::memory_order_relaxed);
+    while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace
+
+void* TensorAllocator::allocate(size_t size) {
+    size_t bytes = blockBytes(size);
+    requests.fetch_add(1, std::memory_order_relaxed);
+    raise(peakLiveBytes, liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+
+    if (bytes <= MAX_CACHED_BYTES) {
+        FreeBlock*& list = freeLists[classOf(bytes)];
+        if (list) {
+            FreeBlock* block = list;
+            list = block->next;
+            threadCachedBytes -= bytes;
+            hits.fetch_add(1, std::memory_order_relaxed);
+            return block;
+        }
+    }
+    void* block;
+    try {
+        block = ::operator new(bytes, ALIGNMENT);
+    } catch (const std::bad_alloc&) {
+        liveBytes.fetch_sub(bytes, std::memory_order_relaxed); // Never handed out
+        throw;
+    }
+    raise(peakHeldBytes, heldBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+    return block;
+}
+
+void TensorAllocator::deallocate(void* data, size_t size) {
+    if (!data) return;
+    size_t bytes = blockBytes(size);
+    liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+
+    if (bytes <= MAX_CACHED_BYTES && threadCachedBytes + bytes <= MAX_THREAD_CACHE_BYTES) {
+        FreeBlock* block = static_cast<FreeBlock*>(data);
+        FreeBlock*& list = freeLists[classOf(bytes)];
+        block->next = list;
+        list = block;
+        threadCachedBytes += bytes;
+        return;
+    }
+    ::operator delete(data, ALIGNMENT);
+    heldBytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+size_t TensorAllocator::release() {
+    size_t freed = 0;
+    for (size_t sizeClass = 0; sizeClass < CLASSES; ++sizeClass) {
+        size_t bytes = classBytes(sizeClass);
+        for (FreeBlock* block = freeLists[sizeClass]; block;) {
+            FreeBlock* next = block->next;
+            ::operator delete(block, ALIGNMENT);
+            freed += bytes;
+            block = next;
+        }
+        freeLists[sizeClass] = nullptr;
+    }
+    threadCachedBytes = 0;
+    heldBytes.fetch_sub(freed, std::memory_order_relaxed);
+    return freed;
+}
+
+void TensorAllocator::printStats(std::ostream& out) {
+    size_t total = requests.load(std::memory_order_relaxed);
+    size_t reused = hits.load(std::memory_order_relaxed);
+    size_t live = liveBytes.load(std::memory_order_relaxed);
+    size_t held = heldBytes.load(std::memory_order_relaxed);
+
+    out << "[alloc] tensor buffers: " << total << " requests, " << reused << " from cache";
+    if (total > 0) {
+        out << " (hit rate " << 100.0 * reused / total << "%)";
+    }
+    out << "\n";
+    out << "[alloc] bytes: " << live << " live (peak " << peakLiveBytes.load(std::memory_order_relaxed)
+        << "), " << held - live << " cached, peak held " << peakHeldBytes.load(std::memory_order_relaxed) << "\n";
+}
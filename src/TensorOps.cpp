@@ -0,0 +1,588 @@
+#include "../include/TensorOps.h"
+#include "../include/ThreadPool.h"
+#include "../include/Gemm.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TROLL_ELEMENTWISE_X86
+#endif
+
+// -O2 only vectorizes loops with a known trip count; these need the
+// dynamic cost model to get vector bodies plus a scalar tail
+#define VECTORIZE optimize("vect-cost-model=dynamic")
+
+bool broadcastShapes(const std::vector<size_t>& a, const std::vector<size_t>& b, std::vector<size_t>& out) {
+    size_t rank = std::max(a.size(), b.size());
+    out.assign(rank, 1);
+    for (size_t i = 0; i < rank; ++i) {
+        size_t x = i < a.size() ? a[a.size() - 1 - i] : 1;
+        size_t y = i < b.size() ? b[b.size() - 1 - i] : 1;
+        if (x != y && x != 1 && y != 1) return false;
+        out[rank - 1 - i] = x == 1 ? y : x;
+    }
+    return true;
+}
+
+Operand Operand::of(const TrollTensor& tensor, const std::vector<size_t>& shape) {
+    return of(tensor.raw(), tensor.shape, tensor.strides, shape);
+}
+
+Operand Operand::of(const void* data, const std::vector<size_t>& from, const std::vector<ptrdiff_t>& strides,
+                    const std::vector<size_t>& shape) {
+    Operand operand{data, std::vector<ptrdiff_t>(shape.size(), 0)};
+    size_t skipped = shape.size() - from.size();
+    for (size_t d = 0; d < from.size(); ++d) {
+        if (from[d] != 1) operand.strides[skipped + d] = strides[d];
+    }
+    return operand;
+}
+
+Operand Operand::of(double number, const std::vector<size_t>& shape) {
+    return Operand{nullptr, std::vector<ptrdiff_t>(shape.size(), 0), number};
+}
+
+namespace {
+
+template <ElementOp Op, typename C>
+inline C apply(C x, C y) {
+    switch (Op) {
+        case ElementOp::Add: return x + y;
+        case ElementOp::Subtract: return x - y;
+        case ElementOp::Multiply: return x * y;
+        case ElementOp::Divide: return x / y;
+    }
+    return C(0);
+}
+
+// One run of n outputs, computed in T's compute type. The unit-stride and
+// broadcast-scalar cases get their own loops so the compiler vectorizes them.
+template <ElementOp Op, typename T>
+__attribute__((always_inline, VECTORIZE))
+inline void runLoops(const T* a, ptrdiff_t sa, const T* b, ptrdiff_t sb, T* __restrict out, size_t n) {
+    using C = typename ComputeType<T>::type;
+    if (sa == 1 && sb == 1) {
+        for (size_t i = 0; i < n; ++i) out[i] = T(apply<Op, C>(a[i], b[i]));
+    } else if (sa == 1 && sb == 0) {
+        const C y = *b;
+        for (size_t i = 0; i < n; ++i) out[i] = T(apply<Op, C>(a[i], y));
+    } else if (sa == 0 && sb == 1) {
+        const C x = *a;
+        for (size_t i = 0; i < n; ++i) out[i] = T(apply<Op, C>(x, b[i]));
+    } else {
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = T(apply<Op, C>(a[static_cast<ptrdiff_t>(i) * sa], b[static_cast<ptrdiff_t>(i) * sb]));
+        }
+    }
+}
+
+template <ElementOp Op, typename T>
+__attribute__((VECTORIZE))
+void scalarRun(const T* a, ptrdiff_t sa, const T* b, ptrdiff_t sb, T* __restrict out, size_t n) {
+    runLoops<Op>(a, sa, b, sb, out, n);
+}
+
+#ifdef TROLL_ELEMENTWISE_X86
+template <ElementOp Op, typename T>
+__attribute__((target("avx2"), VECTORIZE))
+void avx2Run(const T* a, ptrdiff_t sa, const T* b, ptrdiff_t sb, T* __restrict out, size_t n) {
+    runLoops<Op>(a, sa, b, sb, out, n);
+}
+
+template <ElementOp Op, typename T>
+__attribute__((target("avx512f"), VECTORIZE))
+void avx512Run(const T* a, ptrdiff_t sa, const T* b, ptrdiff_t sb, T* __restrict out, size_t n) {
+    runLoops<Op>(a, sa, b, sb, out, n);
+}
+#endif
+
+template <typename T>
+using RunFunction = void (*)(const T*, ptrdiff_t, const T*, ptrdiff_t, T*, size_t);
+
+template <ElementOp Op, typename T>
+RunFunction<T> selectRun() {
+#ifdef TROLL_ELEMENTWISE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return avx512Run<Op, T>;
+    if (__builtin_cpu_supports("avx2")) return avx2Run<Op, T>;
+#endif
+    return scalarRun<Op, T>;
+}
+
+template <typename T>
+RunFunction<T> runFor(ElementOp op) {
+    static const RunFunction<T> runs[] = {
+        selectRun<ElementOp::Add, T>(),
+        selectRun<ElementOp::Subtract, T>(),
+        selectRun<ElementOp::Multiply, T>(),
+        selectRun<ElementOp::Divide, T>(),
+    };
+    return runs[static_cast<int>(op)];
+}
+
+} // namespace
+
+void elementwiseRun(ElementOp op, const double* a, ptrdiff_t sa, const double* b, ptrdiff_t sb, double* out, size_t n) {
+    runFor<double>(op)(a, sa, b, sb, out, n);
+}
+
+template <typename T>
+static void typedElementwise(ElementOp op, const Operand& a, const Operand& b, TrollTensor& out) {
+    const std::vector<size_t>& shape = out.shape;
+    size_t count = out.size();
+    if (count == 0) return;
+    RunFunction<T> run = runFor<T>(op);
+    T* result = out.elements<T>();
+    // Numbers are rounded to the dtype, as NumPy does for scalars
+    const T numberA = static_cast<T>(a.number);
+    const T numberB = static_cast<T>(b.number);
+    const T* dataA = a.data ? static_cast<const T*>(a.data) : &numberA;
+    const T* dataB = b.data ? static_cast<const T*>(b.data) : &numberB;
+    if (shape.empty()) {
+        run(dataA, 0, dataB, 0, result, 1);
+        return;
+    }
+
+    // Outputs are split into runs along the last dimension; a chunk may
+    // start or end partway through one
+    size_t inner = shape.back();
+    ptrdiff_t sa = a.strides.back();
+    ptrdiff_t sb = b.strides.back();
+    auto runRange = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end;) {
+            size_t row = i / inner;
+            size_t col = i % inner;
+            size_t length = std::min(inner - col, end - i);
+            ptrdiff_t offsetA = static_cast<ptrdiff_t>(col) * sa;
+            ptrdiff_t offsetB = static_cast<ptrdiff_t>(col) * sb;
+            for (size_t d = shape.size() - 1; d-- > 0;) {
+                ptrdiff_t index = static_cast<ptrdiff_t>(row % shape[d]);
+                row /= shape[d];
+                offsetA += index * a.strides[d];
+                offsetB += index * b.strides[d];
+            }
+            run(dataA + offsetA, sa, dataB + offsetB, sb, result + i, length);
+            i += length;
+        }
+    };
+
+    ThreadPool::forEach(count, 1, runRange);
+}
+
+void elementwise(ElementOp op, const Operand& a, const Operand& b, TrollTensor& out) {
+    dispatchDType(out.dtype(), [&](auto type) { typedElementwise<decltype(type)>(op, a, b, out); });
+}
+
+template <typename C>
+static C applyAs(ElementFunction function, C x) {
+    switch (function) {
+        case ElementFunction::Exp: return std::exp(x);
+        case ElementFunction::Log: return std::log(x);
+        case ElementFunction::Tanh: return std::tanh(x);
+        case ElementFunction::Relu: return x > C(0) ? x : C(0);
+        case ElementFunction::Step: return x > C(0) ? C(1) : C(0);
+    }
+    return x;
+}
+
+double apply(ElementFunction function, double x) {
+    return applyAs(function, x);
+}
+
+void mapRun(ElementFunction function, const double* x, ptrdiff_t stride, double* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) out[i] = apply(function, x[static_cast<ptrdiff_t>(i) * stride]);
+}
+
+void map(ElementFunction function, const TrollTensor& in, TrollTensor& out) {
+    out.copyFrom(in);
+    dispatchDType(out.dtype(), [&](auto type) {
+        using T = decltype(type);
+        using C = typename ComputeType<T>::type;
+        T* values = out.elements<T>();
+        auto runRange = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) values[i] = T(applyAs<C>(function, values[i]));
+        };
+        size_t count = out.size();
+        ThreadPool::forEach(count, 1, runRange);
+    });
+}
+
+void matmul(const TrollTensor& left, const TrollTensor& right, void* out) {
+    size_t m = left.rank() == 2 ? left.shape[0] : 1;
+    size_t k = left.shape.back();
+    size_t n = right.rank() == 2 ? right.shape[1] : 1;
+    dispatchDType(left.dtype(), [&](auto type) {
+        using T = decltype(type);
+        // Strided inputs are read in place; gemm packs them anyway
+        StridedMatrix<T> a{left.elements<T>(), left.rank() == 2 ? left.strides[0] : 0, left.strides.back()};
+        StridedMatrix<T> b{right.elements<T>(), right.strides[0], right.rank() == 2 ? right.strides[1] : 0};
+        using C = typename ComputeType<T>::type;
+        if (std::is_same<T, C>::value) {
+            gemm(m, n, k, a, b, static_cast<C*>(out), n);
+            return;
+        }
+        // bf16 accumulates in f32 and is rounded once at the end
+        std::vector<C> product(m * n);
+        gemm(m, n, k, a, b, product.data(), n);
+        T* result = static_cast<T*>(out);
+        for (size_t i = 0; i < m * n; ++i) result[i] = T(product[i]);
+    });
+}
+
+// The matrices of one side of a batched product: its last two dimensions
+// (a vector is a row on the left, a column on the right), and how far
+// apart its samples are, 0 if it has none or only one
+template <typename T>
+static StridedMatrix<T> batchMatrix(const TrollTensor& tensor, bool left, ptrdiff_t& batchStride) {
+    size_t rank = tensor.rank();
+    batchStride = rank == 3 && tensor.shape[0] > 1 ? tensor.strides[0] : 0;
+    const T* data = tensor.elements<T>();
+    if (rank == 1) {
+        return left ? StridedMatrix<T>{data, 0, tensor.strides[0]} : StridedMatrix<T>{data, tensor.strides[0], 0};
+    }
+    return StridedMatrix<T>{data, tensor.strides[rank - 2], tensor.strides[rank - 1]};
+}
+
+void batchedMatmul(const TrollTensor& left, const TrollTensor& right, size_t batch, void* out) {
+    size_t m = left.rank() >= 2 ? left.shape[left.rank() - 2] : 1;
+    size_t k = left.shape.back();
+    size_t n = right.rank() >= 2 ? right.shape.back() : 1;
+    dispatchDType(left.dtype(), [&](auto type) {
+        using T = decltype(type);
+        ptrdiff_t aBatch, bBatch;
+        StridedMatrix<T> a = batchMatrix<T>(left, true, aBatch);
+        StridedMatrix<T> b = batchMatrix<T>(right, false, bBatch);
+        using C = typename ComputeType<T>::type;
+        if (std::is_same<T, C>::value) {
+            batchedGemm(batch, m, n, k, a, aBatch, b, bBatch, static_cast<C*>(out), n, m * n);
+            return;
+        }
+        std::vector<C> product(batch * m * n);
+        batchedGemm(batch, m, n, k, a, aBatch, b, bBatch, product.data(), n, m * n);
+        T* result = static_cast<T*>(out);
+        for (size_t i = 0; i < product.size(); ++i) result[i] = T(product[i]);
+    });
+}
+
+Ref<TrollTensor> sumTo(const TrollTensor& in, const std::vector<size_t>& shape) {
+    auto out = makeRef<TrollTensor>(shape, in.dtype());
+    // Output strides over in's shape; 0 along the summed dimensions
+    std::vector<ptrdiff_t> strides = Operand::of(*out, in.shape).strides;
+    std::vector<double> values(in.size());
+    in.copyTo(values.data());
+
+    std::vector<size_t> index(in.rank(), 0);
+    std::vector<double> sums(out->size());
+    double* target = sums.data();
+    for (double value : values) {
+        *target += value;
+        for (size_t d = in.rank(); d-- > 0;) {
+            target += strides[d];
+            if (++index[d] < in.shape[d]) break;
+            target -= strides[d] * static_cast<ptrdiff_t>(in.shape[d]);
+            index[d] = 0;
+        }
+    }
+    out->copyFrom(sums.data());
+    return out;
+}
+
+namespace {
+
+constexpr size_t PAIRWISE_BLOCK = 128; // Elements (or rows) reduced in one pass before pairing
+constexpr size_t LANES = 16;           // Independent accumulators per pass
+constexpr size_t COLUMN_TILE = 512;    // Columns reduced together along an inner axis
+
+template <typename C>
+inline C identity(Reduction reduction) {
+    bool maximum = reduction == Reduction::Max || reduction == Reduction::ArgMax;
+    return maximum ? -std::numeric_limits<C>::infinity() : C(0);
+}
+
+template <typename C>
+inline C combine(Reduction reduction, C x, C y) {
+    if (reduction == Reduction::Max || reduction == Reduction::ArgMax) return y > x ? y : x;
+    return x + y;
+}
+
+// One block of at most PAIRWISE_BLOCK elements: a sum (of squares for
+// Norm) or a maximum, over LANES accumulators so the loop vectorizes
+// without reassociating. NaNs never win a maximum.
+template <typename T, typename C = typename ComputeType<T>::type>
+__attribute__((always_inline, VECTORIZE))
+inline C blockLoops(Reduction reduction, const T* x, size_t n) {
+    C lanes[LANES];
+    for (size_t j = 0; j < LANES; ++j) lanes[j] = identity<C>(reduction);
+    size_t whole = n - n % LANES;
+    if (reduction == Reduction::Max || reduction == Reduction::ArgMax) {
+        for (size_t i = 0; i < whole; i += LANES) {
+            for (size_t j = 0; j < LANES; ++j) {
+                C v = C(x[i + j]);
+                lanes[j] = v > lanes[j] ? v : lanes[j];
+            }
+        }
+        for (size_t i = whole; i < n; ++i) {
+            C v = C(x[i]);
+            lanes[i - whole] = v > lanes[i - whole] ? v : lanes[i - whole];
+        }
+    } else if (reduction == Reduction::Norm) {
+        for (size_t i = 0; i < whole; i += LANES) {
+            for (size_t j = 0; j < LANES; ++j) lanes[j] += C(x[i + j]) * C(x[i + j]);
+        }
+        for (size_t i = whole; i < n; ++i) lanes[i - whole] += C(x[i]) * C(x[i]);
+    } else {
+        for (size_t i = 0; i < whole; i += LANES) {
+            for (size_t j = 0; j < LANES; ++j) lanes[j] += C(x[i + j]);
+        }
+        for (size_t i = whole; i < n; ++i) lanes[i - whole] += C(x[i]);
+    }
+    for (size_t width = LANES / 2; width > 0; width /= 2) {
+        for (size_t j = 0; j < width; ++j) lanes[j] = combine(reduction, lanes[j], lanes[j + width]);
+    }
+    return lanes[0];
+}
+
+// acc[j] = the reduction of x[k * stride + j] over k < rows, for j < width
+template <typename T, typename C = typename ComputeType<T>::type>
+__attribute__((always_inline, VECTORIZE))
+inline void columnLoops(Reduction reduction, const T* x, size_t rows, size_t stride, size_t width, C* __restrict acc) {
+    for (size_t j = 0; j < width; ++j) acc[j] = identity<C>(reduction);
+    for (size_t k = 0; k < rows; ++k) {
+        const T* row = x + k * stride;
+        if (reduction == Reduction::Max || reduction == Reduction::ArgMax) {
+            for (size_t j = 0; j < width; ++j) {
+                C v = C(row[j]);
+                acc[j] = v > acc[j] ? v : acc[j];
+            }
+        } else if (reduction == Reduction::Norm) {
+            for (size_t j = 0; j < width; ++j) acc[j] += C(row[j]) * C(row[j]);
+        } else {
+            for (size_t j = 0; j < width; ++j) acc[j] += C(row[j]);
+        }
+    }
+}
+
+template <typename T, typename C = typename ComputeType<T>::type>
+__attribute__((VECTORIZE))
+C scalarBlock(Reduction reduction, const T* x, size_t n) {
+    return blockLoops(reduction, x, n);
+}
+
+template <typename T, typename C = typename ComputeType<T>::type>
+__attribute__((VECTORIZE))
+void scalarColumns(Reduction reduction, const T* x, size_t rows, size_t stride, size_t width, C* acc) {
+    columnLoops(reduction, x, rows, stride, width, acc);
+}
+
+#ifdef TROLL_ELEMENTWISE_X86
+template <typename T, typename C = typename ComputeType<T>::type>
+__attribute__((target("avx2"), VECTORIZE))
+C avx2Block(Reduction reduction, const T* x, size_t n) {
+    return blockLoops(reduction, x, n);
+}
+
+template <typename T, typename C = typename ComputeType<T>::type>
+__attribute__((target("avx2"), VECTORIZE))
+void avx2Columns(Reduction reduction, const T* x, size_t rows, size_t stride, size_t width, C* acc) {
+    columnLoops(reduction, x, rows, stride, width, acc);
+}
+
+template <typename T, typename C = typename ComputeType<T>::type>
+__attribute__((target("avx512f"), VECTORIZE))
+C avx512Block(Reduction reduction, const T* x, size_t n) {
+    return blockLoops(reduction, x, n);
+}
+
+template <typename T, typename C = typename ComputeType<T>::type>
+__attribute__((target("avx512f"), VECTORIZE))
+void avx512Columns(Reduction reduction, const T* x, size_t rows, size_t stride, size_t width, C* acc) {
+    columnLoops(reduction, x, rows, stride, width, acc);
+}
+#endif
+
+template <typename T>
+struct ReduceKernels {
+    using C = typename ComputeType<T>::type;
+    C (*block)(Reduction, const T*, size_t);
+    void (*columns)(Reduction, const T*, size_t, size_t, size_t, C*);
+};
+
+template <typename T>
+const ReduceKernels<T>& reduceKernels() {
+    static const ReduceKernels<T> kernels = [] {
+#ifdef TROLL_ELEMENTWISE_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return ReduceKernels<T>{avx512Block<T>, avx512Columns<T>};
+        if (__builtin_cpu_supports("avx2")) return ReduceKernels<T>{avx2Block<T>, avx2Columns<T>};
+#endif
+        return ReduceKernels<T>{scalarBlock<T>, scalarColumns<T>};
+    }();
+    return kernels;
+}
+
+// Pairwise over blocks: the rounding error grows with log n, not n
+template <typename T, typename C = typename ComputeType<T>::type>
+C reduceRun(const ReduceKernels<T>& kernels, Reduction reduction, const T* x, size_t n) {
+    if (n <= PAIRWISE_BLOCK) return kernels.block(reduction, x, n);
+    size_t half = (n / 2 + LANES - 1) / LANES * LANES;
+    return combine(reduction, reduceRun(kernels, reduction, x, half), reduceRun(kernels, reduction, x + half, n - half));
+}
+
+template <typename C>
+C combineAll(Reduction reduction, const C* values, size_t n) {
+    if (n == 0) return identity<C>(reduction);
+    if (n == 1) return values[0];
+    size_t half = n / 2;
+    return combine(reduction, combineAll(reduction, values, half), combineAll(reduction, values + half, n - half));
+}
+
+// The same, pairwise over rows, for `width` columns at once
+template <typename T, typename C = typename ComputeType<T>::type>
+void reduceColumns(const ReduceKernels<T>& kernels, Reduction reduction, const T* x, size_t rows, size_t stride,
+                   size_t width, C* acc) {
+    if (rows <= PAIRWISE_BLOCK) {
+        kernels.columns(reduction, x, rows, stride, width, acc);
+        return;
+    }
+    size_t half = rows / 2;
+    reduceColumns(kernels, reduction, x, half, stride, width, acc);
+    std::vector<C> rest(width);
+    reduceColumns(kernels, reduction, x + half * stride, rows - half, stride, width, rest.data());
+    for (size_t j = 0; j < width; ++j) acc[j] = combine(reduction, acc[j], rest[j]);
+}
+
+template <typename C>
+double finish(Reduction reduction, C value, size_t count) {
+    if (reduction == Reduction::Mean) return static_cast<double>(value) / static_cast<double>(count);
+    if (reduction == Reduction::Norm) return std::sqrt(static_cast<double>(value));
+    return static_cast<double>(value);
+}
+
+// The reduction of n contiguous elements (an index for ArgMax), in
+// GRAIN-sized chunks whatever the thread count
+template <typename T>
+double reduceContiguous(Reduction reduction, const T* x, size_t n) {
+    constexpr size_t GRAIN = ThreadPool::GRAIN;
+    using C = typename ComputeType<T>::type;
+    const ReduceKernels<T>& kernels = reduceKernels<T>();
+    std::vector<C> partials((n + GRAIN - 1) / GRAIN);
+    auto runRange = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i += GRAIN) {
+            partials[i / GRAIN] = reduceRun(kernels, reduction, x + i, std::min(GRAIN, end - i));
+        }
+    };
+    ThreadPool::forEach(n, 1, runRange);
+
+    C total = combineAll(reduction, partials.data(), partials.size());
+    if (reduction != Reduction::ArgMax) return finish(reduction, total, n);
+    // Only the first chunk holding the maximum is searched
+    for (size_t chunk = 0; chunk < partials.size(); ++chunk) {
+        if (partials[chunk] != total) continue;
+        for (size_t i = chunk * GRAIN; i < n; ++i) {
+            if (C(x[i]) == total) return static_cast<double>(i);
+        }
+    }
+    return 0.0; // Nothing but NaNs
+}
+
+template <typename T>
+void reduceAlong(Reduction reduction, const T* x, size_t outer, size_t extent, size_t inner, TrollTensor& out) {
+    using C = typename ComputeType<T>::type;
+    auto store = [&](size_t i, double value) {
+        if (reduction == Reduction::ArgMax) {
+            out.data()[i] = value;
+        } else {
+            out.elements<T>()[i] = T(static_cast<C>(value));
+        }
+    };
+
+    if (inner == 1) {
+        // Rows are contiguous runs
+        if (outer == 1) {
+            store(0, reduceContiguous(reduction, x, extent));
+            return;
+        }
+        auto runRange = [&](size_t begin, size_t end) {
+            for (size_t o = begin; o < end; ++o) store(o, reduceContiguous(reduction, x + o * extent, extent));
+        };
+        ThreadPool::forEach(outer, extent, runRange);
+        return;
+    }
+
+    // Otherwise each step along the axis is a row of `inner` contiguous
+    // columns, reduced a tile of columns at a time
+    const ReduceKernels<T>& kernels = reduceKernels<T>();
+    size_t tiles = (inner + COLUMN_TILE - 1) / COLUMN_TILE;
+    auto runRange = [&](size_t begin, size_t end) {
+        std::vector<C> acc(COLUMN_TILE);
+        for (size_t task = begin; task < end; ++task) {
+            size_t o = task / tiles;
+            size_t first = task % tiles * COLUMN_TILE;
+            size_t width = std::min(COLUMN_TILE, inner - first);
+            const T* block = x + o * extent * inner + first;
+            reduceColumns(kernels, reduction, block, extent, inner, width, acc.data());
+            size_t base = o * inner + first;
+            if (reduction != Reduction::ArgMax) {
+                for (size_t j = 0; j < width; ++j) store(base + j, finish(reduction, acc[j], extent));
+                continue;
+            }
+            // The first row holding each column's maximum
+            std::vector<bool> found(width, false);
+            size_t remaining = width;
+            for (size_t j = 0; j < width; ++j) store(base + j, 0.0);
+            for (size_t k = 0; k < extent && remaining > 0; ++k) {
+                const T* row = block + k * inner;
+                for (size_t j = 0; j < width; ++j) {
+                    if (!found[j] && C(row[j]) == acc[j]) {
+                        found[j] = true;
+                        --remaining;
+                        store(base + j, static_cast<double>(k));
+                    }
+                }
+            }
+        }
+    };
+    ThreadPool::forEach(outer * tiles, extent * std::min(inner, COLUMN_TILE), runRange);
+}
+
+} // namespace
+
+// in's elements in row-major order: in place when it is contiguous,
+// otherwise copied into `copy`
+static const void* contiguousElements(const TrollTensor& in, Ref<TrollTensor>& copy) {
+    if (in.isContiguous()) return in.raw();
+    copy = makeRef<TrollTensor>(in.shape, in.dtype());
+    copy->copyFrom(in);
+    return copy->raw();
+}
+
+double reduceAll(Reduction reduction, const TrollTensor& in) {
+    Ref<TrollTensor> copy;
+    const void* values = contiguousElements(in, copy);
+    return dispatchDType(in.dtype(), [&](auto type) {
+        using T = decltype(type);
+        return reduceContiguous(reduction, static_cast<const T*>(values), in.size());
+    });
+}
+
+Ref<TrollTensor> reduceAxis(Reduction reduction, const TrollTensor& in, size_t axis) {
+    Ref<TrollTensor> copy;
+    const void* values = contiguousElements(in, copy);
+    std::vector<size_t> shape = in.shape;
+    size_t extent = shape[axis];
+    shape.erase(shape.begin() + static_cast<ptrdiff_t>(axis));
+    size_t outer = 1;
+    for (size_t d = 0; d < axis; ++d) outer *= in.shape[d];
+    size_t inner = 1;
+    for (size_t d = axis + 1; d < in.rank(); ++d) inner *= in.shape[d];
+
+    auto out = makeRef<TrollTensor>(std::move(shape), reduction == Reduction::ArgMax ? DType::F64 : in.dtype());
+    if (out->size() == 0) return out;
+    dispatchDType(in.dtype(), [&](auto type) {
+        using T = decltype(type);
+        reduceAlong(reduction, static_cast<const T*>(values), outer, extent, inner, *out);
+    });
+    return out;
+}
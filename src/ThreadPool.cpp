@@ -0,0 +1,144 @@
+#include "../include/ThreadPool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+
+static size_t requestedThreads = 0;
+static thread_local size_t currentQueue = 0; // Workers set their own; everyone else shares queue 0
+
+void ThreadPool::setThreadCount(size_t count) {
+    requestedThreads = count;
+}
+
+ThreadPool& ThreadPool::get() {
+    static ThreadPool* pool = [] {
+        size_t count = requestedThreads;
+        if (count == 0) {
+            if (const char* env = std::getenv("TROLL_NUM_THREADS")) {
+                count = std::strtoul(env, nullptr, 10);
+            }
+        }
+        if (count == 0) count = std::thread::hardware_concurrency();
+        return new ThreadPool(count == 0 ? 1 : count);
+    }();
+    return *pool;
+}
+
+ThreadPool::ThreadPool(size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 1; i < count; ++i) {
+        workers.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+void ThreadPool::push(size_t queue, std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+        queues[queue]->tasks.push_back(std::move(task));
+    }
+    queued.fetch_add(1, std::memory_order_release);
+}
+
+bool ThreadPool::runOne(size_t queue) {
+    std::function<void()> task;
+    {
+        Queue& own = *queues[queue];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+        }
+    }
+    for (size_t i = 1; !task && i < queues.size(); ++i) {
+        Queue& victim = *queues[(queue + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+    if (!task) return false;
+    queued.fetch_sub(1, std::memory_order_relaxed);
+    task();
+    return true;
+}
+
+void ThreadPool::workerLoop(size_t queue) {
+    currentQueue = queue;
+    while (true) {
+        if (runOne(queue)) continue;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this] { return stopping || queued.load(std::memory_order_acquire) > 0; });
+        if (stopping) return;
+    }
+}
+
+void ThreadPool::forEach(size_t count, size_t unit, const std::function<void(size_t, size_t)>& body) {
+    if (unit == 0) unit = 1;
+    if (count * unit >= PARALLEL_ELEMENTS) {
+        get().parallelFor(count, std::max<size_t>(1, GRAIN / unit), body);
+    } else if (count > 0) {
+        body(0, count);
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body) {
+    if (grain == 0) grain = 1;
+    if (queues.size() == 1 || count <= grain) {
+        if (count > 0) body(0, count);
+        return;
+    }
+
+    struct Job {
+        std::atomic<size_t> remaining;
+        std::mutex errorMutex;
+        std::exception_ptr error;
+    };
+    auto job = std::make_shared<Job>();
+    size_t chunks = (count + grain - 1) / grain;
+    job->remaining.store(chunks);
+
+    size_t queue = currentQueue;
+    // Pushed last-first so the owner pops chunk 0 first and thieves take the far end
+    for (size_t chunk = chunks; chunk-- > 1;) {
+        size_t begin = chunk * grain;
+        size_t end = begin + grain < count ? begin + grain : count;
+        push(queue, [job, &body, begin, end] {
+            try {
+                body(begin, end);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(job->errorMutex);
+                if (!job->error) job->error = std::current_exception();
+            }
+            job->remaining.fetch_sub(1, std::memory_order_acq_rel);
+        });
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_all();
+
+    try {
+        body(0, grain < count ? grain : count);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(job->errorMutex);
+        if (!job->error) job->error = std::current_exception();
+    }
+    job->remaining.fetch_sub(1, std::memory_order_acq_rel);
+
+    while (job->remaining.load(std::memory_order_acquire) > 0) {
+        if (!runOne(queue)) std::this_thread::yield();
+    }
+    if (job->error) std::rethrow_exception(job->error);
+}
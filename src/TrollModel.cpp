@@ -3,11 +3,45 @@
 #include "../include/Interpreter.h"
 
 // TrollInstance implementation
-TrollInstance::TrollInstance(std::shared_ptr<TrollModel> model) : model(std::move(model)) {}
+TrollInstance::TrollInstance(Ref<TrollModel> model)
+    : Object(ObjectType::Instance), model(std::move(model)), shape(this->model->shape.get()) {}
+
+TrollInstance::~TrollInstance() = default;
+
+void TrollInstance::setEnvironment(Ref<Environment> environment) {
+    env = std::move(environment);
+    fields = env->slots;
+}
+
+void TrollInstance::trace(GcVisitor& visitor) {
+    visitor.visit(model.get());
+    if (env) visitor.visit(env.get());
+}
+
+void TrollInstance::clearReferences() {
+    fields = nullptr;
+    env.reset();
+    model.reset();
+}
+
+RuntimeValue TrollInstance::getUncached(const Token& name, PropertyCache& cache) {
+    int slot = shape->slotOf(name.lexeme);
+    if (slot >= 0) {
+        cache.shape = model->shape;
+        cache.slot = slot;
+        return fields[slot];
+    }
+    return get(name);
+}
 
 RuntimeValue TrollInstance::get(Token name) {
+    int slot = shape->slotOf(name.lexeme);
+    if (slot >= 0) {
+        return fields[slot];
+    }
+
     RuntimeValue val = env->getAt(name.lexeme);
-    if (!std::holds_alternative<std::monostate>(val)) {
+    if (!val.isNil()) {
         return val;
     }
     // TODO: Look up methods in model? For now we define methods in instance env as closures.
@@ -16,18 +50,50 @@ RuntimeValue TrollInstance::get(Token name) {
 }
 
 void TrollInstance::set(Token name, RuntimeValue value) {
+    int slot = shape->slotOf(name.lexeme);
+    if (slot >= 0) {
+        fields[slot] = value;
+        return;
+    }
     env->define(name.lexeme, value); // Or assign? define allows creating new fields?
     // For now, allow defining new fields or overwriting.
 }
 
 // TrollModel implementation
+TrollModel::TrollModel(std::shared_ptr<ModelStmt> declaration, Ref<Environment> closure)
+    : name(declaration->name.lexeme), declaration(std::move(declaration)), closure(std::move(closure)),
+      shape(std::make_shared<Shape>(this->declaration->fieldSlots)) {
+    for (const auto& member : this->declaration->methods) {
+        if (!std::dynamic_pointer_cast<FunctionStmt>(member)) {
+            initializers.push_back(member);
+        }
+    }
+}
+
+void TrollModel::trace(GcVisitor& visitor) {
+    if (closure) visitor.visit(closure.get());
+    for (const auto& method : methods) ::trace(visitor, method.second);
+}
+
+void TrollModel::clearReferences() {
+    closure.reset();
+    methods.clear();
+}
+
+Ref<TrollInstance> TrollModel::instantiate() {
+    auto instance = makeRef<TrollInstance>(Ref<TrollModel>(this));
+    instance->setEnvironment(makeRef<Environment>(closure, declaration->localCount));
+    for (const auto& method : methods) {
+        instance->fields[method.first] = method.second;
+    }
+    return instance;
+}
+
 RuntimeValue TrollModel::call(Interpreter* interpreter, const std::vector<RuntimeValue>& arguments) {
-    auto instance = std::make_shared<TrollInstance>(std::make_shared<TrollModel>(*this));
-    
-    // Create instance environment
-    instance->env = std::make_shared<Environment>(closure);
-    
-    interpreter->executeBlock(declaration->methods, instance->env);
-    
-    return std::shared_ptr<TrollInstance>(instance);
+    Ref<TrollInstance> instance = instantiate();
+
+    // Only field initializers run per instance; methods are shared
+    interpreter->executeBlock(initializers, instance->env.get());
+
+    return RuntimeValue(instance);
 }
@@ -0,0 +1,265 @@
+#include "../include/TrollTensor.h"
+#include "../include/TrollArray.h"
+#include <algorithm>
+
+static std::vector<ptrdiff_t> rowMajorStrides(const std::vector<size_t>& shape) {
+    std::vector<ptrdiff_t> strides(shape.size());
+    ptrdiff_t stride = 1;
+    for (size_t d = shape.size(); d-- > 0;) {
+        strides[d] = stride;
+        stride *= static_cast<ptrdiff_t>(shape[d]);
+    }
+    return strides;
+}
+
+static size_t elementCount(const std::vector<size_t>& shape) {
+    size_t count = 1;
+    for (size_t extent : shape) count *= extent;
+    return count;
+}
+
+TrollTensor::TrollTensor(std::vector<size_t> shape, DType dtype)
+    : Object(ObjectType::Tensor),
+      buffer(std::make_shared<TensorBuffer>(elementCount(shape), dtype)),
+      shape(std::move(shape)) {
+    strides = rowMajorStrides(this->shape);
+}
+
+TrollTensor::TrollTensor(std::shared_ptr<TensorBuffer> buffer, size_t offset,
+                         std::vector<size_t> shape, std::vector<ptrdiff_t> strides)
+    : Object(ObjectType::Tensor), buffer(std::move(buffer)), offset(offset),
+      shape(std::move(shape)), strides(std::move(strides)) {}
+
+size_t TrollTensor::size() const {
+    return elementCount(shape);
+}
+
+bool TrollTensor::isContiguous() const {
+    ptrdiff_t expected = 1;
+    for (size_t d = shape.size(); d-- > 0;) {
+        if (shape[d] != 1 && strides[d] != expected) return false;
+        expected *= static_cast<ptrdiff_t>(shape[d]);
+    }
+    return true;
+}
+
+Ref<TrollTensor> TrollTensor::row(size_t i) {
+    std::vector<size_t> rowShape(shape.begin() + 1, shape.end());
+    std::vector<ptrdiff_t> rowStrides(strides.begin() + 1, strides.end());
+    return makeRef<TrollTensor>(buffer, offset + i * strides[0], std::move(rowShape), std::move(rowStrides));
+}
+
+Ref<TrollTensor> TrollTensor::slice(size_t start, size_t end) {
+    std::vector<size_t> sliceShape = shape;
+    sliceShape[0] = end - start;
+    return makeRef<TrollTensor>(buffer, offset + start * strides[0], std::move(sliceShape), strides);
+}
+
+Ref<TrollTensor> TrollTensor::contiguous() {
+    if (isContiguous()) return Ref<TrollTensor>(this);
+    auto copy = makeRef<TrollTensor>(shape, dtype());
+    copy->copyFrom(*this);
+    return copy;
+}
+
+Ref<TrollTensor> TrollTensor::astype(DType type) {
+    if (type == dtype()) return Ref<TrollTensor>(this);
+    auto copy = makeRef<TrollTensor>(shape, type);
+    copy->copyFrom(*this);
+    return copy;
+}
+
+// Strides that lay newShape over the elements of (shape, strides) in
+// row-major order, if there are any. Runs of old dimensions that map onto
+// runs of new ones must be contiguous among themselves.
+static bool viewStrides(const std::vector<size_t>& shape, const std::vector<ptrdiff_t>& strides,
+                        const std::vector<size_t>& newShape, std::vector<ptrdiff_t>& newStrides) {
+    std::vector<size_t> oldShape;
+    std::vector<ptrdiff_t> oldStrides;
+    for (size_t d = 0; d < shape.size(); ++d) {
+        if (shape[d] == 1) continue;
+        oldShape.push_back(shape[d]);
+        oldStrides.push_back(strides[d]);
+    }
+    newStrides.assign(newShape.size(), 1);
+
+    size_t oi = 0, oj = 1, ni = 0, nj = 1;
+    while (ni < newShape.size() && oi < oldShape.size()) {
+        size_t np = newShape[ni];
+        size_t op = oldShape[oi];
+        while (np != op) {
+            if (np < op) {
+                np *= newShape[nj++];
+            } else {
+                op *= oldShape[oj++];
+            }
+        }
+        for (size_t ok = oi; ok + 1 < oj; ++ok) {
+            if (oldStrides[ok] != static_cast<ptrdiff_t>(oldShape[ok + 1]) * oldStrides[ok + 1]) return false;
+        }
+        newStrides[nj - 1] = oldStrides[oj - 1];
+        for (size_t nk = nj - 1; nk > ni; --nk) {
+            newStrides[nk - 1] = newStrides[nk] * static_cast<ptrdiff_t>(newShape[nk]);
+        }
+        ni = nj++;
+        oi = oj++;
+    }
+    return true;
+}
+
+Ref<TrollTensor> TrollTensor::reshape(std::vector<size_t> newShape) {
+    std::vector<ptrdiff_t> newStrides;
+    if (size() == 0 || !viewStrides(shape, strides, newShape, newStrides)) {
+        Ref<TrollTensor> source = contiguous();
+        return makeRef<TrollTensor>(source->buffer, source->offset, newShape, rowMajorStrides(newShape));
+    }
+    return makeRef<TrollTensor>(buffer, offset, std::move(newShape), std::move(newStrides));
+}
+
+Ref<TrollTensor> TrollTensor::transpose() {
+    return makeRef<TrollTensor>(buffer, offset, std::vector<size_t>(shape.rbegin(), shape.rend()),
+                                std::vector<ptrdiff_t>(strides.rbegin(), strides.rend()));
+}
+
+// Visits elements in row-major order, calling f(element pointer) for each
+template <typename T, typename F>
+static void forEachElement(T* base, const std::vector<size_t>& shape, const std::vector<ptrdiff_t>& strides,
+                           size_t dim, F& f) {
+    if (dim == shape.size()) {
+        f(base);
+        return;
+    }
+    for (size_t i = 0; i < shape[dim]; ++i) {
+        forEachElement(base + static_cast<ptrdiff_t>(i) * strides[dim], shape, strides, dim + 1, f);
+    }
+}
+
+double TrollTensor::get(ptrdiff_t index) const {
+    return dispatchDType(dtype(), [&](auto type) {
+        using T = decltype(type);
+        return static_cast<double>(elements<T>()[index]);
+    });
+}
+
+void TrollTensor::set(ptrdiff_t index, double value) {
+    dispatchDType(dtype(), [&](auto type) {
+        using T = decltype(type);
+        elements<T>()[index] = static_cast<T>(value);
+    });
+}
+
+void TrollTensor::copyTo(double* out) const {
+    dispatchDType(dtype(), [&](auto type) {
+        using T = decltype(type);
+        T* values = elements<T>();
+        if (isContiguous()) {
+            for (size_t i = 0; i < size(); ++i) out[i] = static_cast<double>(values[i]);
+            return;
+        }
+        auto write = [&](T* element) { *out++ = static_cast<double>(*element); };
+        forEachElement(values, shape, strides, 0, write);
+    });
+}
+
+void TrollTensor::copyFrom(const double* in) {
+    dispatchDType(dtype(), [&](auto type) {
+        using T = decltype(type);
+        T* values = elements<T>();
+        if (isContiguous()) {
+            for (size_t i = 0; i < size(); ++i) values[i] = static_cast<T>(in[i]);
+            return;
+        }
+        auto read = [&](T* element) { *element = static_cast<T>(*in++); };
+        forEachElement(values, shape, strides, 0, read);
+    });
+}
+
+void TrollTensor::copyFrom(const TrollTensor& source) {
+    if (dtype() == source.dtype() && isContiguous() && source.isContiguous()) {
+        std::memcpy(raw(), source.raw(), size() * dtypeSize(dtype()));
+        return;
+    }
+    dispatchDType(dtype(), [&](auto to) {
+        dispatchDType(source.dtype(), [&](auto from) {
+            using T = decltype(to);
+            using S = decltype(from);
+            std::vector<S> gathered;
+            const S* in = source.elements<S>();
+            if (!source.isContiguous()) {
+                gathered.reserve(source.size());
+                auto gather = [&](S* element) { gathered.push_back(*element); };
+                forEachElement(source.elements<S>(), source.shape, source.strides, 0, gather);
+                in = gathered.data();
+            }
+            auto read = [&](T* element) { *element = static_cast<T>(*in++); };
+            forEachElement(elements<T>(), shape, strides, 0, read);
+        });
+    });
+}
+
+static void appendElements(std::string& s, const TrollTensor& tensor, ptrdiff_t base, size_t dim) {
+    s += "[";
+    for (size_t i = 0; i < tensor.shape[dim]; ++i) {
+        if (i > 0) s += ", ";
+        ptrdiff_t element = base + static_cast<ptrdiff_t>(i) * tensor.strides[dim];
+        if (dim + 1 == tensor.shape.size()) {
+            s += std::to_string(tensor.get(element));
+        } else {
+            appendElements(s, tensor, element, dim + 1);
+        }
+    }
+    s += "]";
+}
+
+// Same layout as a nested TrollArray prints
+std::string TrollTensor::toString() const {
+    if (shape.empty()) return std::to_string(get(0));
+    std::string s;
+    appendElements(s, *this, 0, 0);
+    return s;
+}
+
+static Ref<TrollTensor> packElements(const std::vector<RuntimeValue>& elements) {
+    if (elements.empty()) return nullptr;
+
+    if (elements[0].isNumber()) {
+        for (const auto& element : elements) {
+            if (!element.isNumber()) return nullptr;
+        }
+        auto tensor = makeRef<TrollTensor>(std::vector<size_t>{elements.size()});
+        double* out = tensor->data();
+        for (const auto& element : elements) {
+            *out++ = element.asNumber();
+        }
+        return tensor;
+    }
+
+    std::vector<Ref<TrollTensor>> rows;
+    rows.reserve(elements.size());
+    for (const auto& element : elements) {
+        Ref<TrollTensor> row = toTensor(element);
+        if (!row || (!rows.empty() && row->shape != rows[0]->shape)) return nullptr;
+        rows.push_back(std::move(row));
+    }
+    const std::vector<size_t>& rowShape = rows[0]->shape;
+    std::vector<size_t> shape{rows.size()};
+    shape.insert(shape.end(), rowShape.begin(), rowShape.end());
+    DType dtype = rows[0]->dtype();
+    for (const auto& row : rows) dtype = promoteTypes(dtype, row->dtype());
+    auto tensor = makeRef<TrollTensor>(std::move(shape), dtype);
+    for (size_t i = 0; i < rows.size(); ++i) {
+        tensor->row(i)->copyFrom(*rows[i]);
+    }
+    return tensor;
+}
+
+Ref<TrollTensor> toTensor(const RuntimeValue& value) {
+    if (value.isTensor()) return Ref<TrollTensor>(value.asTensor());
+    if (value.isArray()) return packElements(value.asArray()->elements);
+    return nullptr;
+}
+
+Ref<TrollTensor> packTensor(const std::vector<RuntimeValue>& elements) {
+    if (elements.empty() || elements[0].isNumber()) return nullptr;
+    return packElements(elements);
+}
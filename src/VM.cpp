@@ -0,0 +1,473 @@
+#include "../include/VM.h"
+#include "../include/Compiler.h"
+#include "../include/Operators.h"
+#include "../include/Builtins.h"
+#include "../include/NativeFunction.h"
+#include "../include/TrollArray.h"
+#include "../include/TrollInstance.h"
+#include <iostream>
+
+// Labels-as-values dispatch is a GCC/Clang extension; fall back to a switch elsewhere.
+#if defined(__GNUC__) || defined(__clang__)
+#define TROLL_COMPUTED_GOTO 1
+#endif
+
+RuntimeValue VMFunction::call(Interpreter* interpreter, const std::vector<RuntimeValue>& arguments) {
+    return vm->callFunction(this, arguments);
+}
+
+RuntimeValue VMModel::call(Interpreter* interpreter, const std::vector<RuntimeValue>& arguments) {
+    return vm->construct(this);
+}
+
+VM::VM() : stack(STACK_SIZE), frames(MAX_FRAMES) {
+    for (auto& builtin : builtins()) {
+        int slot = globalSlot(builtin.first);
+        globals[slot] = std::move(builtin.second);
+        globalDefined[slot] = true;
+    }
+}
+
+void VM::interpret(const std::vector<std::shared_ptr<Stmt>>& statements) {
+    Compiler compiler(*this);
+    std::shared_ptr<FunctionProto> script = compiler.compile(statements);
+
+    try {
+        // Slot 0 stands in for the callee so the script frame looks like any other call
+        runFrom(script.get(), stack.data() + 1, nullptr);
+    } catch (RuntimeError& error) {
+        std::cerr << error.what() << "\n[line " << error.token.line << "]\n";
+    }
+}
+
+int VM::globalSlot(const std::string& name) {
+    auto it = globalIndex.find(name);
+    if (it != globalIndex.end()) return it->second;
+
+    int slot = static_cast<int>(globals.size());
+    globals.emplace_back();
+    globalDefined.push_back(false);
+    globalNames.push_back(name);
+    globalIndex[name] = slot;
+    return slot;
+}
+
+RuntimeValue VM::callFunction(VMFunction* function, const std::vector<RuntimeValue>& arguments) {
+    RuntimeValue* top = stackTop();
+    if (top + 1 + arguments.size() > stack.data() + stack.size()) {
+        throw RuntimeError(Token(TokenType::IDENTIFIER, function->proto->name, std::monostate{}, 0), "Stack overflow.");
+    }
+    top[0] = RuntimeValue(std::monostate{});
+    for (size_t i = 0; i < arguments.size(); ++i) {
+        top[1 + i] = arguments[i];
+    }
+    return runFrom(function->proto.get(), top + 1, function->closure);
+}
+
+RuntimeValue VM::construct(VMModel* model) {
+    Ref<TrollInstance> instance = model->instantiate();
+
+    RuntimeValue* top = stackTop();
+    top[0] = RuntimeValue(std::monostate{});
+    runFrom(model->constructor.get(), top + 1, instance->env);
+
+    return RuntimeValue(instance);
+}
+
+RuntimeValue* VM::stackTop() {
+    if (frameCount == 0) return stack.data();
+    const CallFrame& frame = frames[frameCount - 1];
+    return frame.base + frame.proto->maxRegisters;
+}
+
+void VM::pushFrame(FunctionProto* proto, RuntimeValue* base, Ref<Environment> env, const Token* callToken) {
+    if (frameCount == frames.size() || base + proto->maxRegisters > stack.data() + stack.size()) {
+        Token token = callToken ? *callToken : Token(TokenType::IDENTIFIER, proto->name, std::monostate{}, 0);
+        throw RuntimeError(token, "Stack overflow.");
+    }
+    CallFrame& frame = frames[frameCount++];
+    frame.proto = proto;
+    frame.pc = proto->code.data();
+    frame.base = base;
+    frame.env = std::move(env);
+}
+
+RuntimeValue VM::runFrom(FunctionProto* proto, RuntimeValue* base, Ref<Environment> env) {
+    pushFrame(proto, base, std::move(env), nullptr);
+    run(frameCount - 1);
+    return std::move(base[-1]);
+}
+
+const Token& VM::tokenAt(const CallFrame& frame, const Instruction* pc) {
+    return frame.proto->tokens[frame.proto->tokenAt[pc - frame.proto->code.data()]];
+}
+
+void VM::run(size_t baseFrame) {
+    CallFrame* frame;
+    const Instruction* code;
+    const Instruction* pc;
+    const Instruction* ip;
+    RuntimeValue* R;
+    const RuntimeValue* K;
+    RuntimeValue* callee;                  // CALL/INVOKE hand off to the shared call path
+    Ref<Environment> receiver; // Set when the callee is a method
+    bool tail = false;         // TAILCALL/TAILINVOKE reuse the caller's frame
+
+#define LOAD_FRAME() do { \
+        frame = &frames[frameCount - 1]; \
+        code = frame->proto->code.data(); \
+        pc = frame->pc; \
+        R = frame->base; \
+        K = frame->proto->constants.data(); \
+    } while (0)
+
+#define RK(x) (((x) & RK_CONSTANT) ? K[(x) & ~RK_CONSTANT] : R[(x)])
+#define TOKEN() tokenAt(*frame, ip)
+
+#ifdef TROLL_COMPUTED_GOTO
+    // Must follow the order of OpCode
+    static const void* dispatchTable[] = {
+        &&L_LOADK, &&L_LOADNIL, &&L_MOVE,
+        &&L_GETGLOBAL, &&L_SETGLOBAL, &&L_DEFGLOBAL, &&L_GETENV, &&L_GETMETHOD, &&L_SETENV, &&L_GETLATE, &&L_SETLATE, &&L_PUSHENV, &&L_POPENV,
+        &&L_ADD, &&L_SUB, &&L_MUL, &&L_DIV, &&L_MOD, &&L_MATMUL,
+        &&L_LT, &&L_LE, &&L_GT, &&L_GE, &&L_EQ, &&L_NE,
+        &&L_NEG, &&L_NOT,
+        &&L_JMP, &&L_JMPIF, &&L_JMPIFNOT, &&L_JNLT, &&L_JNLE, &&L_JNGT, &&L_JNGE,
+        &&L_CALL, &&L_INVOKE, &&L_TAILCALL, &&L_TAILINVOKE, &&L_RETURN, &&L_RETURNNIL,
+        &&L_CLOSURE, &&L_MODEL,
+        &&L_NEWARRAY, &&L_GETINDEX, &&L_GETSLICE, &&L_SETINDEX, &&L_GETPROP,
+        &&L_PRINT,
+    };
+#define DISPATCH() do { ip = pc++; goto *dispatchTable[static_cast<uint8_t>(ip->op)]; } while (0)
+#define CASE(name) L_##name:
+#define LOOP_BEGIN DISPATCH();
+#define LOOP_END
+#else
+#define DISPATCH() goto dispatch
+#define CASE(name) case OpCode::name:
+#define LOOP_BEGIN dispatch: ip = pc++; switch (ip->op) {
+#define LOOP_END }
+#endif
+
+#define ARITH(name, op) \
+    CASE(name) { \
+        const RuntimeValue& l = RK(ip->b); \
+        const RuntimeValue& r = RK(ip->c); \
+        if (l.isNumber() && r.isNumber()) { \
+            R[ip->a] = l.asNumber() op r.asNumber(); \
+        } else { \
+            R[ip->a] = binaryOp(TOKEN(), l, r); \
+        } \
+        DISPATCH(); \
+    }
+
+#define COMPARE_JUMP(name, op) \
+    CASE(name) { \
+        const RuntimeValue& l = RK(ip->b); \
+        const RuntimeValue& r = RK(ip->c); \
+        bool result = (l.isNumber() && r.isNumber()) ? (l.asNumber() op r.asNumber()) \
+                                                     : isTruthy(binaryOp(TOKEN(), l, r)); \
+        if (!result) pc = code + ip->a; \
+        DISPATCH(); \
+    }
+
+    LOAD_FRAME();
+
+    try {
+        LOOP_BEGIN
+
+        CASE(LOADK) {
+            R[ip->a] = K[ip->b];
+            DISPATCH();
+        }
+        CASE(LOADNIL) {
+            R[ip->a] = RuntimeValue(std::monostate{});
+            DISPATCH();
+        }
+        CASE(MOVE) {
+            R[ip->a] = R[ip->b];
+            DISPATCH();
+        }
+
+        CASE(GETGLOBAL) {
+            if (!globalDefined[ip->b]) {
+                throw RuntimeError(TOKEN(), "Undefined variable '" + globalNames[ip->b] + "'.");
+            }
+            R[ip->a] = globals[ip->b];
+            DISPATCH();
+        }
+        CASE(SETGLOBAL) {
+            if (!globalDefined[ip->b]) {
+                throw RuntimeError(TOKEN(), "Undefined variable '" + globalNames[ip->b] + "'.");
+            }
+            globals[ip->b] = R[ip->a];
+            DISPATCH();
+        }
+        CASE(DEFGLOBAL) {
+            globals[ip->b] = R[ip->a];
+            globalDefined[ip->b] = true;
+            DISPATCH();
+        }
+        CASE(GETENV) {
+            // Undefined only when a hoisted function runs ahead of a let it follows
+            const RuntimeValue& value = frame->env->getAt(ip->b, ip->c);
+            R[ip->a] = value.isUndefined() ? RuntimeValue() : value;
+            DISPATCH();
+        }
+        CASE(GETMETHOD) {
+            Environment* receiver = frame->env->ancestor(ip->b);
+            R[ip->a] = bindMethod(receiver->slots[ip->c], receiver);
+            DISPATCH();
+        }
+        CASE(SETENV) {
+            frame->env->assignAt(ip->b, ip->c, R[ip->a]);
+            DISPATCH();
+        }
+        CASE(GETLATE) {
+            const LateBinding& late = frame->proto->lateBindings[ip->b];
+            if (RuntimeValue* value = frame->env->firstDefined(late.bindings)) {
+                R[ip->a] = *value;
+            } else if (late.global < 0) {
+                R[ip->a] = RuntimeValue(std::monostate{});
+            } else if (globalDefined[late.global]) {
+                R[ip->a] = globals[late.global];
+            } else {
+                throw RuntimeError(TOKEN(), "Undefined variable '" + globalNames[late.global] + "'.");
+            }
+            DISPATCH();
+        }
+        CASE(SETLATE) {
+            const LateBinding& late = frame->proto->lateBindings[ip->b];
+            if (RuntimeValue* value = frame->env->firstDefined(late.bindings)) {
+                *value = R[ip->a];
+            } else if (late.global < 0) {
+                frame->env->assignAt(late.bindings.front().depth, late.bindings.front().slot, R[ip->a]);
+            } else if (globalDefined[late.global]) {
+                globals[late.global] = R[ip->a];
+            } else {
+                throw RuntimeError(TOKEN(), "Undefined variable '" + globalNames[late.global] + "'.");
+            }
+            DISPATCH();
+        }
+        CASE(PUSHENV) {
+            frame->env = makeRef<Environment>(frame->env, ip->a, RuntimeValue::undefined());
+            DISPATCH();
+        }
+        CASE(POPENV) {
+            frame->env = frame->env->enclosing;
+            DISPATCH();
+        }
+
+        ARITH(ADD, +)
+        ARITH(SUB, -)
+        ARITH(MUL, *)
+        ARITH(DIV, /)
+        ARITH(LT, <)
+        ARITH(LE, <=)
+        ARITH(GT, >)
+        ARITH(GE, >=)
+
+        CASE(MOD) {
+            R[ip->a] = binaryOp(TOKEN(), RK(ip->b), RK(ip->c));
+            DISPATCH();
+        }
+        CASE(MATMUL) {
+            R[ip->a] = binaryOp(TOKEN(), RK(ip->b), RK(ip->c));
+            DISPATCH();
+        }
+        CASE(EQ) {
+            R[ip->a] = isEqual(RK(ip->b), RK(ip->c));
+            DISPATCH();
+        }
+        CASE(NE) {
+            R[ip->a] = !isEqual(RK(ip->b), RK(ip->c));
+            DISPATCH();
+        }
+        CASE(NEG) {
+            if (R[ip->b].isNumber()) {
+                R[ip->a] = -R[ip->b].asNumber();
+            } else {
+                R[ip->a] = unaryOp(TOKEN(), R[ip->b]);
+            }
+            DISPATCH();
+        }
+        CASE(NOT) {
+            R[ip->a] = !isTruthy(R[ip->b]);
+            DISPATCH();
+        }
+
+        CASE(JMP) {
+            pc = code + ip->a;
+            Heap::get().maybeCollect(); // Loop back edges are GC safe points
+            DISPATCH();
+        }
+        CASE(JMPIF) {
+            if (isTruthy(R[ip->a])) pc = code + ip->b;
+            DISPATCH();
+        }
+        CASE(JMPIFNOT) {
+            if (!isTruthy(R[ip->a])) pc = code + ip->b;
+            DISPATCH();
+        }
+        COMPARE_JUMP(JNLT, <)
+        COMPARE_JUMP(JNLE, <=)
+        COMPARE_JUMP(JNGT, >)
+        COMPARE_JUMP(JNGE, >=)
+
+        CASE(TAILCALL) {
+            tail = true;
+            goto callRegister;
+        }
+        CASE(CALL) {
+            tail = false;
+        callRegister:
+            callee = R + ip->a;
+            if (ip->c > 0) {
+                receiver = Ref<Environment>(frame->env->ancestor(ip->c - 1));
+            }
+            goto call;
+        }
+        CASE(TAILINVOKE) {
+            tail = true;
+            goto invokeRegister;
+        }
+        CASE(INVOKE) {
+            tail = false;
+        invokeRegister:
+            callee = R + ip->a;
+            if (!callee->isInstance()) {
+                throw RuntimeError(TOKEN(), "Only instances have properties.");
+            }
+            TrollInstance* instance = callee->asInstance();
+            receiver = instance->env;
+            *callee = instance->get(TOKEN(), frame->proto->propertyCaches[ip->c]);
+            goto call;
+        }
+        call: {
+            Heap::get().maybeCollect();
+            size_t argc = ip->b;
+            if (!callee->isCallable()) {
+                throw RuntimeError(TOKEN(), "Can only call functions and classes.");
+            }
+            Callable* function = callee->asCallable();
+            std::string mismatch = arityMismatch(function, argc);
+            if (!mismatch.empty()) {
+                throw RuntimeError(TOKEN(), mismatch);
+            }
+
+            frame->pc = pc;
+            if (auto* compiled = dynamic_cast<VMFunction*>(function) ; compiled && tail) {
+                // Slide callee and arguments down over the caller's, then
+                // restart the frame on the callee's code
+                FunctionProto* proto = compiled->proto.get();
+                Ref<Environment> env = compiled->isMethod ? std::move(receiver) : compiled->closure;
+                if (frame->base + proto->maxRegisters > stack.data() + stack.size()) {
+                    throw RuntimeError(TOKEN(), "Stack overflow.");
+                }
+                for (size_t i = 0; i <= argc; ++i) {
+                    frame->base[static_cast<ptrdiff_t>(i) - 1] = std::move(callee[i]);
+                }
+                frame->proto = proto;
+                frame->pc = proto->code.data();
+                frame->env = std::move(env);
+                LOAD_FRAME();
+            } else if (compiled) {
+                // Arguments already sit in the callee's first registers
+                pushFrame(compiled->proto.get(), callee + 1,
+                          compiled->isMethod ? std::move(receiver) : compiled->closure, &TOKEN());
+                LOAD_FRAME();
+            } else {
+                std::vector<RuntimeValue> arguments(callee + 1, callee + 1 + argc);
+                try {
+                    *callee = function->call(nullptr, arguments);
+                } catch (NativeError& error) {
+                    throw RuntimeError(TOKEN(), error.what());
+                }
+            }
+            receiver.reset();
+            DISPATCH();
+        }
+        CASE(RETURN) {
+            R[-1] = std::move(R[ip->a]);
+            frame->env.reset();
+            if (--frameCount == baseFrame) return;
+            LOAD_FRAME();
+            DISPATCH();
+        }
+        CASE(RETURNNIL) {
+            R[-1] = RuntimeValue(std::monostate{});
+            frame->env.reset();
+            if (--frameCount == baseFrame) return;
+            LOAD_FRAME();
+            DISPATCH();
+        }
+
+        CASE(CLOSURE) {
+            R[ip->a] = makeRef<VMFunction>(frame->proto->protos[ip->b], frame->env, this);
+            DISPATCH();
+        }
+        CASE(MODEL) {
+            const ModelProto& proto = frame->proto->models[ip->b];
+            auto model = makeRef<VMModel>(proto.declaration, frame->env, proto.constructor, this);
+            for (const auto& method : proto.methods) {
+                auto function = makeRef<VMFunction>(method.second, nullptr, this);
+                function->isMethod = true;
+                model->methods.emplace_back(method.first, RuntimeValue(function));
+            }
+            R[ip->a] = model;
+            DISPATCH();
+        }
+
+        CASE(NEWARRAY) {
+            std::vector<RuntimeValue> elements(R + ip->b, R + ip->b + ip->c);
+            R[ip->a] = arrayLiteral(std::move(elements));
+            DISPATCH();
+        }
+        CASE(GETINDEX) {
+            R[ip->a] = indexGet(TOKEN(), RK(ip->b), RK(ip->c));
+            DISPATCH();
+        }
+        CASE(GETSLICE) {
+            R[ip->a] = sliceGet(TOKEN(), R[ip->b], R[ip->c], R[ip->c + 1]);
+            DISPATCH();
+        }
+        CASE(SETINDEX) {
+            indexSet(TOKEN(), R[ip->a], RK(ip->b), RK(ip->c));
+            DISPATCH();
+        }
+        CASE(GETPROP) {
+            const RuntimeValue& object = R[ip->b];
+            if (object.isInstance()) {
+                TrollInstance* instance = object.asInstance();
+                R[ip->a] = bindMethod(instance->get(TOKEN(), frame->proto->propertyCaches[ip->c]), instance->env.get());
+                DISPATCH();
+            }
+            R[ip->a] = propertyGet(TOKEN(), object);
+            DISPATCH();
+        }
+
+        CASE(PRINT) {
+            std::cout << to_string(R[ip->a]) << "\n";
+            DISPATCH();
+        }
+
+        LOOP_END
+    } catch (...) {
+        // Drop the frames this activation pushed; outer activations keep theirs
+        for (size_t i = baseFrame; i < frameCount; ++i) {
+            frames[i].env.reset();
+        }
+        frameCount = baseFrame;
+        throw;
+    }
+
+#undef LOAD_FRAME
+#undef RK
+#undef TOKEN
+#undef DISPATCH
+#undef CASE
+#undef LOOP_BEGIN
+#undef LOOP_END
+#undef ARITH
+#undef COMPARE_JUMP
+}
@@ -6,30 +6,65 @@
 #include "../include/Parser.h"
 #include "../include/AST.h"
 #include "../include/Interpreter.h"
+#include "../include/Resolver.h"
+#include "../include/Optimizer.h"
+#include "../include/VM.h"
 #include "../include/CodeGenerator.h"
+#include "../include/Heap.h"
+#include "../include/ThreadPool.h"
+#include "../include/Lazy.h"
+#include "../include/TensorAllocator.h"
+#include <cstdlib>
 #include <cstring>
 
 // AST Printer was here, now switching to Interpreter Execution
 
-void run(std::string source, bool compile) {
+enum class Backend {
+    Interpreter, // Tree-walking Interpreter (default)
+    VM,          // Bytecode Compiler + VM (--vm)
+    LLVM         // CodeGenerator to output.ll (-c)
+};
+
+void printMemoryStats() {
+    Heap::get().printStats(std::cerr);
+    TensorAllocator::printStats(std::cerr);
+}
+
+void run(std::string source, Backend backend, bool gcStats) {
     Lexer lexer(source);
     std::vector<Token> tokens = lexer.scanTokens();
 
     Parser parser(tokens);
     std::vector<std::shared_ptr<Stmt>> statements = parser.parse();
 
-    if (compile) {
+    Optimizer optimizer;
+    statements = optimizer.optimize(statements);
+
+    if (backend == Backend::LLVM) {
         CodeGenerator codegen;
         codegen.generateCode(statements);
         codegen.saveModule("output.ll");
         std::cout << "Compiled to output.ll" << std::endl;
+        return;
+    }
+
+    Resolver resolver;
+    resolver.resolve(statements);
+
+    // Stats are printed while the runtime is still alive, so the heap size
+    // is what the script left behind.
+    if (backend == Backend::VM) {
+        VM vm;
+        vm.interpret(statements);
+        if (gcStats) printMemoryStats();
     } else {
         Interpreter interpreter;
         interpreter.interpret(statements);
+        if (gcStats) printMemoryStats();
     }
 }
 
-void runFile(const char* path, bool compile) {
+void runFile(const char* path, Backend backend, bool gcStats) {
     std::ifstream file(path);
     if (!file.is_open()) {
         std::cerr << "Could not open file " << path << std::endl;
@@ -37,28 +72,38 @@ void runFile(const char* path, bool compile) {
     }
     std::stringstream buffer;
     buffer << file.rdbuf();
-    run(buffer.str(), compile);
+    run(buffer.str(), backend, gcStats);
 }
 
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        std::cout << "Usage: trolllang [-c] <script>" << std::endl;
-        return 64;
-    }
-    
-    bool compile = false;
+    Backend backend = Backend::Interpreter;
+    bool gcStats = false;
     const char* file = nullptr;
 
-    if (argc == 3 && strcmp(argv[1], "-c") == 0) {
-        compile = true;
-        file = argv[2];
-    } else if (argc == 2) {
-        file = argv[1];
-    } else {
-         std::cout << "Usage: trolllang [-c] <script>" << std::endl;
-         return 64;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-c") == 0) {
+            backend = Backend::LLVM;
+        } else if (strcmp(argv[i], "--vm") == 0) {
+            backend = Backend::VM;
+        } else if (strcmp(argv[i], "--gc-stats") == 0) {
+            gcStats = true;
+        } else if (strcmp(argv[i], "--lazy") == 0) {
+            setLazyTensors(true);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            ThreadPool::setThreadCount(atoi(argv[++i]));
+        } else if (file == nullptr && argv[i][0] != '-') {
+            file = argv[i];
+        } else {
+            file = nullptr;
+            break;
+        }
     }
-    
-    runFile(file, compile);
+
+    if (file == nullptr) {
+        std::cout << "Usage: trolllang [-c | --vm] [--gc-stats] [--lazy] [--threads N] <script>" << std::endl;
+        return 64;
+    }
+
+    runFile(file, backend, gcStats);
     return 0;
 }